@@ -0,0 +1,136 @@
+#ifndef MBIT_MORE_ACK_TRACKER_H
+#define MBIT_MORE_ACK_TRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Flag of an acknowledgement: a command was lost and the host has to resend from the next one.
+ */
+#define MM_ACK_GAP 0x01
+
+/**
+ * @brief Tracker of sequenced commands from the host to acknowledge them in batches.
+ * Commands are executed only in the order of the sequence numbers (go-back-N).
+ * An acknowledgement carries the last sequence number executed in order, so one
+ * acknowledgement covers all the commands before it. A command ahead of the expected one
+ * means that some were lost, then an acknowledgement with MM_ACK_GAP is sent at once.
+ *
+ * @tparam BATCH Number of executed commands to acknowledge at least
+ */
+template <uint8_t BATCH>
+class MbitMoreAckTracker {
+public:
+  /**
+   * @brief Number of commands executed in order.
+   *
+   */
+  uint32_t accepted = 0;
+
+  /**
+   * @brief Number of commands received again after being executed.
+   *
+   */
+  uint32_t duplicated = 0;
+
+  /**
+   * @brief Number of commands discarded because the ones before them were lost.
+   *
+   */
+  uint32_t outOfOrder = 0;
+
+  /**
+   * @brief Forget the sequence. The next command starts a new sequence.
+   *
+   */
+  void reset() {
+    synced = false;
+    pending = 0;
+    ackNow = false;
+    gap = false;
+    gapReported = false;
+  }
+
+  /**
+   * @brief Check the sequence number of a received command.
+   *
+   * @param sequence sequence number of the command
+   * @return true the command is the next one in order and has to be executed
+   * @return false the command has to be discarded
+   */
+  bool receive(uint8_t sequence) {
+    if (!synced) {
+      synced = true;
+      expected = sequence;
+    }
+    int8_t distance = (int8_t)(uint8_t)(sequence - expected);
+    if (distance == 0) {
+      expected++;
+      accepted++;
+      pending++;
+      gap = false;
+      gapReported = false;
+      return true;
+    }
+    if (distance < 0) {
+      // Resent after its acknowledgement was lost.
+      duplicated++;
+      ackNow = true;
+      return false;
+    }
+    outOfOrder++;
+    gap = true;
+    if (!gapReported) {
+      // Report each gap once, the host goes back to the expected one.
+      gapReported = true;
+      ackNow = true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Whether an acknowledgement has to be sent now.
+   *
+   * @param idle no more command is waiting to be processed
+   * @return true an acknowledgement is due
+   */
+  bool ackDue(bool idle) const {
+    if (!synced)
+      return false;
+    return ackNow || pending >= BATCH || (idle && pending > 0);
+  }
+
+  /**
+   * @brief Sequence number of the last command executed in order.
+   *
+   * @return uint8_t sequence number to acknowledge
+   */
+  uint8_t lastSequence() const { return expected - 1; }
+
+  /**
+   * @brief Flags of the acknowledgement.
+   *
+   * @return uint8_t MM_ACK_GAP when a command was lost
+   */
+  uint8_t flags() const { return gap ? MM_ACK_GAP : 0; }
+
+  /**
+   * @brief Mark the acknowledgement as sent.
+   *
+   */
+  void acked() {
+    pending = 0;
+    ackNow = false;
+    gap = false;
+  }
+
+private:
+  bool synced = false;
+  uint8_t expected = 0;
+  uint8_t pending = 0;
+  bool ackNow = false;
+  bool gap = false;
+  bool gapReported = false;
+};
+
+#endif // MBIT_MORE_ACK_TRACKER_H
@@ -0,0 +1,225 @@
+#ifndef MBIT_MORE_ANALOG_RING_H
+#define MBIT_MORE_ANALOG_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MM_MEDIAN_SORT(a, b) \
+  do {                       \
+    if (v[a] > v[b]) {       \
+      uint16_t t = v[a];     \
+      v[a] = v[b];           \
+      v[b] = t;              \
+    }                        \
+  } while (0)
+
+/**
+ * @brief Median of the values by an insertion sort.
+ *
+ * @param v values, which are sorted
+ * @param size number of the values, at least 1
+ * @return uint16_t median
+ */
+inline uint16_t mbitMoreSortMedian(uint16_t *v, size_t size) {
+  for (size_t i = 1; i < size; i++) {
+    uint16_t key = v[i];
+    int j = (int)i - 1;
+    while (j >= 0 && v[j] > key) {
+      v[j + 1] = v[j];
+      j--;
+    }
+    v[j + 1] = key;
+  }
+  return v[size / 2];
+}
+
+/**
+ * @brief Median of N values.
+ * The common window sizes are specialised with sorting networks which select the median
+ * by a fixed sequence of compare-exchanges, the others use an insertion sort.
+ *
+ * @tparam N Number of values
+ */
+template <size_t N>
+struct MbitMoreMedian {
+  /**
+   * @brief Median of the values.
+   *
+   * @param v values, which are reordered
+   * @return uint16_t median
+   */
+  static uint16_t of(uint16_t *v) { return mbitMoreSortMedian(v, N); }
+};
+
+template <>
+struct MbitMoreMedian<3> {
+  static uint16_t of(uint16_t *v) {
+    MM_MEDIAN_SORT(0, 1);
+    MM_MEDIAN_SORT(1, 2);
+    MM_MEDIAN_SORT(0, 1);
+    return v[1];
+  }
+};
+
+template <>
+struct MbitMoreMedian<5> {
+  static uint16_t of(uint16_t *v) {
+    MM_MEDIAN_SORT(0, 1);
+    MM_MEDIAN_SORT(3, 4);
+    MM_MEDIAN_SORT(0, 3);
+    MM_MEDIAN_SORT(1, 4);
+    MM_MEDIAN_SORT(1, 2);
+    MM_MEDIAN_SORT(2, 3);
+    MM_MEDIAN_SORT(1, 2);
+    return v[2];
+  }
+};
+
+template <>
+struct MbitMoreMedian<7> {
+  static uint16_t of(uint16_t *v) {
+    MM_MEDIAN_SORT(0, 5);
+    MM_MEDIAN_SORT(0, 3);
+    MM_MEDIAN_SORT(1, 6);
+    MM_MEDIAN_SORT(2, 4);
+    MM_MEDIAN_SORT(0, 1);
+    MM_MEDIAN_SORT(3, 5);
+    MM_MEDIAN_SORT(2, 6);
+    MM_MEDIAN_SORT(2, 3);
+    MM_MEDIAN_SORT(3, 6);
+    MM_MEDIAN_SORT(4, 5);
+    MM_MEDIAN_SORT(1, 4);
+    MM_MEDIAN_SORT(1, 3);
+    MM_MEDIAN_SORT(3, 4);
+    return v[3];
+  }
+};
+
+template <>
+struct MbitMoreMedian<9> {
+  static uint16_t of(uint16_t *v) {
+    MM_MEDIAN_SORT(1, 2);
+    MM_MEDIAN_SORT(4, 5);
+    MM_MEDIAN_SORT(7, 8);
+    MM_MEDIAN_SORT(0, 1);
+    MM_MEDIAN_SORT(3, 4);
+    MM_MEDIAN_SORT(6, 7);
+    MM_MEDIAN_SORT(1, 2);
+    MM_MEDIAN_SORT(4, 5);
+    MM_MEDIAN_SORT(7, 8);
+    MM_MEDIAN_SORT(0, 3);
+    MM_MEDIAN_SORT(5, 8);
+    MM_MEDIAN_SORT(4, 7);
+    MM_MEDIAN_SORT(3, 6);
+    MM_MEDIAN_SORT(1, 4);
+    MM_MEDIAN_SORT(2, 5);
+    MM_MEDIAN_SORT(4, 7);
+    MM_MEDIAN_SORT(4, 2);
+    MM_MEDIAN_SORT(6, 4);
+    MM_MEDIAN_SORT(4, 2);
+    return v[4];
+  }
+};
+
+#undef MM_MEDIAN_SORT
+
+/**
+ * @brief Latest samples of an analog input in a window.
+ * Samples are pushed in background and a read filters them without converting.
+ *
+ * @tparam N Max number of samples to keep
+ */
+template <size_t N>
+class MbitMoreAnalogRing {
+public:
+  /**
+   * @brief Set the number of samples to keep and remove all samples.
+   *
+   * @param size size of the window [1..N], N when it is out of the range
+   */
+  void setWindow(size_t size) {
+    window = (size == 0 || size > N) ? N : size;
+    clear();
+  }
+
+  /**
+   * @brief Number of samples to keep.
+   *
+   * @return size_t size of the window
+   */
+  size_t windowSize() const { return window; }
+
+  /**
+   * @brief Add a sample, overwriting the oldest one when the window is full.
+   *
+   * @param sample converted value
+   */
+  void push(uint16_t sample) {
+    if (count == window)
+      total -= samples[next];
+    samples[next] = sample;
+    total += sample;
+    next = (next + 1 < window) ? next + 1 : 0;
+    if (count < window)
+      count++;
+  }
+
+  /**
+   * @brief Number of samples kept.
+   *
+   * @return size_t number of samples
+   */
+  size_t size() const { return count; }
+
+  /**
+   * @brief Remove all samples.
+   *
+   */
+  void clear() {
+    count = 0;
+    next = 0;
+    total = 0;
+  }
+
+  /**
+   * @brief Sum of the samples kept.
+   *
+   * @return uint32_t sum
+   */
+  uint32_t sum() const { return total; }
+
+  /**
+   * @brief Median of the samples kept (non-destructive).
+   *
+   * @return uint16_t median, 0 when there is no sample
+   */
+  uint16_t median() const {
+    uint16_t temp[N < 9 ? 9 : N]; // large enough for the networks
+    for (size_t i = 0; i < count; i++) {
+      temp[i] = samples[i];
+    }
+    switch (count) {
+    case 0:
+      return 0;
+    case 3:
+      return MbitMoreMedian<3>::of(temp);
+    case 5:
+      return MbitMoreMedian<5>::of(temp);
+    case 7:
+      return MbitMoreMedian<7>::of(temp);
+    case 9:
+      return MbitMoreMedian<9>::of(temp);
+    default:
+      return mbitMoreSortMedian(temp, count);
+    }
+  }
+
+private:
+  uint16_t samples[N] = {0};
+  size_t window = N;
+  size_t next = 0;
+  size_t count = 0;
+  uint32_t total = 0;
+};
+
+#endif // MBIT_MORE_ANALOG_RING_H
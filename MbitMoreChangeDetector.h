@@ -0,0 +1,133 @@
+#ifndef MBIT_MORE_CHANGE_DETECTOR_H
+#define MBIT_MORE_CHANGE_DETECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Interval to notify a packet without changes by default [ms].
+ */
+#define MM_CHANGE_KEEP_ALIVE_DEFAULT 1000
+
+/**
+ * @brief Kind of a field in a packet, which decides the size and how it is compared.
+ *
+ */
+enum MbitMoreFieldKind
+{
+  FIELD_BITS32 = 0, // 32 bits of levels, any change of them
+  FIELD_U8 = 1,     // uint8_t, change beyond the deadband
+  FIELD_S16 = 2,    // int16_t little-endian, change beyond the deadband
+};
+
+/**
+ * @brief Detector of changes in the packets of a channel to notify.
+ * A packet is compared with the last one notified, field by field, so that noise within the deadband
+ * does not cause notifications. A packet is notified after the keep-alive interval even without changes,
+ * so that the host can know the link is alive.
+ *
+ * @tparam N Size of the packet in bytes
+ */
+template <size_t N>
+class MbitMoreChangeDetector {
+public:
+  /**
+   * @brief Notify only changes, otherwise every packet is notified.
+   *
+   */
+  bool enabled = true;
+
+  /**
+   * @brief Change of a field which is not counted as a change.
+   *
+   */
+  uint16_t deadband = 0;
+
+  /**
+   * @brief Interval to notify a packet without changes [ms].
+   *
+   */
+  uint16_t keepAlive = MM_CHANGE_KEEP_ALIVE_DEFAULT;
+
+  /**
+   * @brief Number of packets notified.
+   *
+   */
+  uint32_t notified = 0;
+
+  /**
+   * @brief Number of packets suppressed because of no changes.
+   *
+   */
+  uint32_t suppressed = 0;
+
+  /**
+   * @brief Constructor.
+   *
+   * @param fields kinds of the fields from the head of the packet
+   * @param count number of the fields
+   */
+  MbitMoreChangeDetector(const uint8_t *fields, size_t count) : fields(fields), fieldCount(count) {}
+
+  /**
+   * @brief Forget the last packet. The next one is notified.
+   *
+   */
+  void reset() { sent = false; }
+
+  /**
+   * @brief Decide whether to notify the packet and remember it when it is notified.
+   *
+   * @param packet freshly sampled packet
+   * @param now current time [ms]
+   * @return true the packet has to be notified
+   */
+  bool shouldNotify(const uint8_t *packet, unsigned long now) {
+    if (enabled && sent && (unsigned long)(now - lastTime) < keepAlive && !changed(packet)) {
+      suppressed++;
+      return false;
+    }
+    memcpy(last, packet, N);
+    lastTime = now;
+    sent = true;
+    notified++;
+    return true;
+  }
+
+private:
+  const uint8_t *fields;
+  size_t fieldCount;
+  uint8_t last[N] = {0};
+  unsigned long lastTime = 0;
+  bool sent = false;
+
+  static int read16(const uint8_t *data) { return (int16_t)(data[0] | (data[1] << 8)); }
+
+  bool changed(const uint8_t *packet) const {
+    size_t offset = 0;
+    for (size_t i = 0; i < fieldCount; i++) {
+      int diff = 0;
+      switch (fields[i]) {
+      case MbitMoreFieldKind::FIELD_BITS32:
+        if (memcmp(&packet[offset], &last[offset], 4) != 0)
+          return true;
+        offset += 4;
+        continue;
+      case MbitMoreFieldKind::FIELD_U8:
+        diff = (int)packet[offset] - last[offset];
+        offset += 1;
+        break;
+      default:
+        diff = read16(&packet[offset]) - read16(&last[offset]);
+        offset += 2;
+        break;
+      }
+      if (diff > deadband || -diff > deadband)
+        return true;
+    }
+    return false;
+  }
+};
+
+#endif // MBIT_MORE_CHANGE_DETECTOR_H
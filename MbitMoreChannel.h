@@ -0,0 +1,232 @@
+#ifndef MBIT_MORE_CHANNEL_H
+#define MBIT_MORE_CHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MM_CH_BUFFER_SIZE_COMMAND 20
+#define MM_CH_BUFFER_SIZE_NOTIFY 20
+#define MM_CH_BUFFER_SIZE_STATE 7
+#define MM_CH_BUFFER_SIZE_MOTION 18
+#define MM_CH_BUFFER_SIZE_ANALOG_IN 2
+#define MM_CH_BUFFER_SIZE_SERIAL_STATS 20
+#define MM_CH_BUFFER_SIZE_TX_QUEUE_STATS 10
+#define MM_CH_BUFFER_SIZE_SERIAL_BAUD 5
+#define MM_CH_BUFFER_SIZE_SERIAL_FRAMING 1
+#define MM_CH_BUFFER_SIZE_SAMPLER_STATS 28
+#define MM_CH_BUFFER_SIZE_ACCEL_STREAM 244
+
+/**
+ * @brief Properties of a channel.
+ *
+ */
+#define MM_CH_PROP_READ 0x01      // readable
+#define MM_CH_PROP_WRITE 0x02     // writable with and without response
+#define MM_CH_PROP_NOTIFY 0x04    // notifiable
+#define MM_CH_PROP_READ_AUTH 0x08 // sampled on each read from BLE
+#define MM_CH_PROP_SAMPLED 0x10   // holds sensor values which can be polled and batched
+#define MM_CH_PROP_SERIAL 0x20    // only on the serial link, without a characteristic or a buffer
+#define MM_CH_PROP_SENSOR (MM_CH_PROP_READ | MM_CH_PROP_NOTIFY | MM_CH_PROP_SAMPLED)
+#define MM_CH_PROP_ANALOG_IN (MM_CH_PROP_READ | MM_CH_PROP_READ_AUTH | MM_CH_PROP_SAMPLED)
+
+/**
+ * @brief Process which fills or consumes the buffer of a channel.
+ *
+ */
+enum MbitMoreChannelHandler
+{
+  CH_HANDLER_NONE = 0,
+  CH_HANDLER_COMMAND = 1,         // written commands
+  CH_HANDLER_STATE = 2,           // updateState()
+  CH_HANDLER_MOTION = 3,          // updateMotion()
+  CH_HANDLER_ANALOG_IN = 4,       // updateAnalogIn() of the pin in the argument
+  CH_HANDLER_SERIAL_STATS = 5,    // periods of the serial subscriptions
+  CH_HANDLER_TX_QUEUE_STATS = 6,  // serial TX queue
+  CH_HANDLER_SAMPLER_STATS = 7,   // sampling of each sensor
+};
+
+/**
+ * @brief Channels which only v2 has. v1 goes without them to keep the GATT table small.
+ * X(name, id, buffer, size, properties, handler, argument)
+ */
+#if MICROBIT_CODAL
+#define MBIT_MORE_V2_CHANNELS(X)                                                                                       \
+  X(DATA, 0x0130, dataChBuffer, MM_CH_BUFFER_SIZE_NOTIFY, MM_CH_PROP_READ | MM_CH_PROP_NOTIFY, CH_HANDLER_NONE, 0) \
+  X(ACCEL_STREAM, 0x0131, accelStreamChBuffer, MM_CH_BUFFER_SIZE_ACCEL_STREAM, MM_CH_PROP_NOTIFY, CH_HANDLER_NONE, 0)
+#else // MICROBIT_CODAL
+#define MBIT_MORE_V2_CHANNELS(X)
+#endif // MICROBIT_CODAL
+
+/**
+ * @brief Channels which have a characteristic on BLE and a buffer in the service.
+ * X(name, id, buffer, size, properties, handler, argument)
+ * Each group of 16 IDs must be numbered from 0 without gaps and the groups must be in order.
+ */
+#define MBIT_MORE_BLE_CHANNELS(X)                                                                                              \
+  X(COMMAND, 0x0100, commandChBuffer, MM_CH_BUFFER_SIZE_COMMAND, MM_CH_PROP_READ | MM_CH_PROP_WRITE, CH_HANDLER_COMMAND, 0)     \
+  X(STATE, 0x0101, stateChBuffer, MM_CH_BUFFER_SIZE_STATE, MM_CH_PROP_SENSOR, CH_HANDLER_STATE, 0)                             \
+  X(MOTION, 0x0102, motionChBuffer, MM_CH_BUFFER_SIZE_MOTION, MM_CH_PROP_SENSOR, CH_HANDLER_MOTION, 0)                         \
+  X(PIN_EVENT, 0x0110, pinEventChBuffer, MM_CH_BUFFER_SIZE_NOTIFY, MM_CH_PROP_READ | MM_CH_PROP_NOTIFY, CH_HANDLER_NONE, 0)     \
+  X(ACTION_EVENT, 0x0111, actionEventChBuffer, MM_CH_BUFFER_SIZE_NOTIFY, MM_CH_PROP_READ | MM_CH_PROP_NOTIFY, CH_HANDLER_NONE, 0) \
+  X(ANALOG_IN_P0, 0x0120, analogInP0ChBuffer, MM_CH_BUFFER_SIZE_ANALOG_IN, MM_CH_PROP_ANALOG_IN, CH_HANDLER_ANALOG_IN, 0)      \
+  X(ANALOG_IN_P1, 0x0121, analogInP1ChBuffer, MM_CH_BUFFER_SIZE_ANALOG_IN, MM_CH_PROP_ANALOG_IN, CH_HANDLER_ANALOG_IN, 1)      \
+  X(ANALOG_IN_P2, 0x0122, analogInP2ChBuffer, MM_CH_BUFFER_SIZE_ANALOG_IN, MM_CH_PROP_ANALOG_IN, CH_HANDLER_ANALOG_IN, 2)      \
+  MBIT_MORE_V2_CHANNELS(X)
+
+/**
+ * @brief Channels which exist only on the serial link. They follow the BLE channels in the table.
+ * X(name, id, size, properties, handler, argument)
+ */
+#define MBIT_MORE_SERIAL_CHANNELS(X)                                                                                         \
+  X(SERIAL_STATS, 0x0140, MM_CH_BUFFER_SIZE_SERIAL_STATS, MM_CH_PROP_READ, CH_HANDLER_SERIAL_STATS, 0)                      \
+  X(TX_QUEUE_STATS, 0x0141, MM_CH_BUFFER_SIZE_TX_QUEUE_STATS, MM_CH_PROP_READ, CH_HANDLER_TX_QUEUE_STATS, 0)                \
+  X(SERIAL_BAUD, 0x0142, MM_CH_BUFFER_SIZE_SERIAL_BAUD, MM_CH_PROP_NOTIFY, CH_HANDLER_NONE, 0)                              \
+  X(SERIAL_FRAMING, 0x0143, MM_CH_BUFFER_SIZE_SERIAL_FRAMING, MM_CH_PROP_NOTIFY, CH_HANDLER_NONE, 0)                        \
+  X(SAMPLER_STATS, 0x0144, MM_CH_BUFFER_SIZE_SAMPLER_STATS, MM_CH_PROP_READ, CH_HANDLER_SAMPLER_STATS, 0)
+
+#define MM_CH_ID_ENTRY(name, id, ...) MM_CH_ID_##name = id,
+#define MM_CH_INDEX_ENTRY(name, ...) MM_CH_IDX_##name,
+#define MM_CH_COUNT_ENTRY(...) +1
+#define MM_CH_BUFFER_ENTRY(name, id, buffer, size, ...) uint8_t buffer[size] = {0};
+#define MM_CH_BLE_DESCRIPTOR(name, id, buffer, size, properties, handler, arg) \
+  {id, size, properties, handler, arg, offsetof(MbitMoreChannelBuffers, buffer)},
+#define MM_CH_SERIAL_DESCRIPTOR(name, id, size, properties, handler, arg) \
+  {id, size, (properties) | MM_CH_PROP_SERIAL, handler, arg, 0},
+
+/**
+ * @brief ID of each channel, which is the short UUID of the characteristic.
+ *
+ */
+enum MbitMoreChannelId
+{
+  MBIT_MORE_BLE_CHANNELS(MM_CH_ID_ENTRY)
+  MBIT_MORE_SERIAL_CHANNELS(MM_CH_ID_ENTRY)
+};
+
+/**
+ * @brief Index of each channel in the table, the same as the index of the characteristic.
+ *
+ */
+enum MbitMoreChannelIndex
+{
+  MBIT_MORE_BLE_CHANNELS(MM_CH_INDEX_ENTRY)
+  MBIT_MORE_SERIAL_CHANNELS(MM_CH_INDEX_ENTRY)
+  MM_CH_COUNT
+};
+
+/**
+ * @brief Number of channels which have a characteristic on BLE.
+ *
+ */
+#define MM_CH_BLE_COUNT (0 MBIT_MORE_BLE_CHANNELS(MM_CH_COUNT_ENTRY))
+
+/**
+ * @brief Descriptor of a channel.
+ *
+ */
+typedef struct {
+  uint16_t id;        /** short UUID of the characteristic and channel of serial frames */
+  uint8_t size;       /** length of the value */
+  uint8_t properties; /** MM_CH_PROP_* */
+  uint8_t handler;    /** MbitMoreChannelHandler */
+  uint8_t arg;        /** argument for the handler */
+  uint16_t offset;    /** offset of the buffer in MbitMoreChannelBuffers */
+} MbitMoreChannel;
+
+/**
+ * @brief Buffers of the BLE channels, inherited by the BLE service.
+ *
+ */
+struct MbitMoreChannelBuffers {
+  MBIT_MORE_BLE_CHANNELS(MM_CH_BUFFER_ENTRY)
+
+  /**
+   * @brief Buffer of the channel.
+   *
+   * @param channel channel which is not MM_CH_PROP_SERIAL
+   * @return uint8_t* buffer of the channel
+   */
+  uint8_t *channelBuffer(const MbitMoreChannel &channel) {
+    return reinterpret_cast<uint8_t *>(this) + channel.offset;
+  }
+};
+
+/**
+ * @brief Table of all channels in order of their IDs.
+ *
+ */
+static constexpr MbitMoreChannel mbitMoreChannels[MM_CH_COUNT] = {
+    MBIT_MORE_BLE_CHANNELS(MM_CH_BLE_DESCRIPTOR)
+    MBIT_MORE_SERIAL_CHANNELS(MM_CH_SERIAL_DESCRIPTOR)
+};
+
+constexpr unsigned channelGroup(uint16_t id) { return (id >> 4) & 0x0F; }
+
+/**
+ * @brief Index of the first channel in the group or in the following groups.
+ *
+ * @param group group of the ID, bits 4-7
+ * @param index index to start searching
+ * @return index of the first channel, MM_CH_COUNT when there is none
+ */
+constexpr int channelGroupStart(unsigned group, int index = 0) {
+  return (index >= MM_CH_COUNT || channelGroup(mbitMoreChannels[index].id) >= group)
+             ? index
+             : channelGroupStart(group, index + 1);
+}
+
+/**
+ * @brief Whether each channel is at the index which findChannel() calculates from the ID.
+ *
+ */
+constexpr bool channelsIndexable(int index = 0) {
+  return index >= MM_CH_COUNT ||
+         (((mbitMoreChannels[index].id & 0xFF00) == 0x0100) &&
+          (channelGroupStart(channelGroup(mbitMoreChannels[index].id)) + (mbitMoreChannels[index].id & 0x0F) == index) &&
+          channelsIndexable(index + 1));
+}
+
+static_assert(channelsIndexable(), "channels must be in order and numbered from 0 in each group");
+
+/**
+ * @brief Largest size of the serial-only channels, whose values are made on reading.
+ *
+ */
+constexpr size_t serialChannelSizeMax(int index = MM_CH_BLE_COUNT) {
+  return (index >= MM_CH_COUNT)
+             ? 0
+             : ((mbitMoreChannels[index].size > serialChannelSizeMax(index + 1))
+                    ? mbitMoreChannels[index].size
+                    : serialChannelSizeMax(index + 1));
+}
+
+/**
+ * @brief Index of the first channel in each group of 16 IDs, and MM_CH_COUNT at the end.
+ *
+ */
+static constexpr uint8_t mbitMoreChannelGroups[17] = {
+    channelGroupStart(0), channelGroupStart(1), channelGroupStart(2), channelGroupStart(3),
+    channelGroupStart(4), channelGroupStart(5), channelGroupStart(6), channelGroupStart(7),
+    channelGroupStart(8), channelGroupStart(9), channelGroupStart(10), channelGroupStart(11),
+    channelGroupStart(12), channelGroupStart(13), channelGroupStart(14), channelGroupStart(15),
+    MM_CH_COUNT};
+
+/**
+ * @brief Find the channel of the ID without searching.
+ *
+ * @param id ID of the channel
+ * @return const MbitMoreChannel* descriptor of the channel, NULL when it is not in the table
+ */
+inline const MbitMoreChannel *findChannel(uint16_t id) {
+  if ((id & 0xFF00) != 0x0100) {
+    return NULL;
+  }
+  unsigned group = channelGroup(id);
+  unsigned index = mbitMoreChannelGroups[group] + (id & 0x0F);
+  if (index >= mbitMoreChannelGroups[group + 1]) {
+    return NULL;
+  }
+  return &mbitMoreChannels[index];
+}
+
+#endif // MBIT_MORE_CHANNEL_H
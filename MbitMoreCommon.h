@@ -10,6 +10,8 @@
 #define MBIT_MORE_USE_SERIAL 0 // 1 for use USB serial
 #endif // MICROBIT_CODAL
 
+#include "MbitMoreChannel.h"
+
 #define MBIT_MORE_DATA_RECEIVED 8000
 
 // Kept in sync with the version in package.json by scripts/sync-version.js.
@@ -27,12 +29,6 @@ enum MbitMoreDataContentType
   MM_DATA_TEXT = 2,
 };
 
-#define MM_CH_BUFFER_SIZE_COMMAND 20
-#define MM_CH_BUFFER_SIZE_NOTIFY 20
-#define MM_CH_BUFFER_SIZE_STATE 7
-#define MM_CH_BUFFER_SIZE_MOTION 18
-#define MM_CH_BUFFER_SIZE_ANALOG_IN 2
-
 enum MbitMoreCommand // 3 bits (0x00..0x07)
 {
   CMD_CONFIG = 0x00,
@@ -57,6 +53,12 @@ enum MbitMoreDisplayCommand
   TEXT = 0x01,
   PIXELS_0 = 0x02,
   PIXELS_1 = 0x03,
+  PIXELS_PACKED_4 = 0x04,
+  PIXELS_PACKED_1 = 0x05,
+  FRAME_STORE = 0x06,
+  FRAME_PLAY = 0x07,
+  FRAME_STOP = 0x08,
+  TEXT_APPEND = 0x09,
 };
 
 /**
@@ -81,7 +83,10 @@ enum MbitMoreDataFormat
   PIN_EVENT = 0x11,
   ACTION_EVENT = 0x12,
   DATA_NUMBER = 0x13,
-  DATA_TEXT = 0x14
+  DATA_TEXT = 0x14,
+  PIN_EVENT_BATCH = 0x15,
+  ACTION_EVENT_BATCH = 0x16,
+  TONE_QUEUE = 0x17
 };
 
 enum MbitMoreActionEvent
@@ -138,7 +143,42 @@ enum MbitMorePinEvent
 enum MbitMoreConfig
 {
   MIC = 0x01, // microphone
-  TOUCH = 0x02
+  TOUCH = 0x02,
+  SERIAL_BAUD = 0x03, // baud rate of the serial link
+  SERIAL_FRAMING = 0x04, // framing of the serial link
+  NOTIFY_ON_CHANGE = 0x05, // notifications of STATE and MOTION only on changes
+  SAMPLER = 0x06, // period of sampling a sensor
+  FILTER = 0x07, // filter chain of an analog input or the light level
+  ACCEL_STREAM = 0x08, // streaming every sample of the accelerometer (v2 only)
+  ACTION_EVENT_MASK = 0x09, // masks of the button and gesture events to send
+};
+
+/**
+ * @brief Enum for sensors which have a filter chain.
+ * 
+ */
+enum MbitMoreFilterTarget
+{
+  FILTER_ANALOG_IN_P0 = 0,
+  FILTER_ANALOG_IN_P1 = 1,
+  FILTER_ANALOG_IN_P2 = 2,
+  FILTER_LIGHT = 3,
+};
+
+/**
+ * @brief Enum for sensors which are sampled in their own period.
+ * 
+ */
+enum MbitMoreSensor
+{
+  SENSOR_DIGITAL = 0, // GPIO, touch pins and buttons
+  SENSOR_LIGHT = 1,
+  SENSOR_TEMPERATURE = 2,
+  SENSOR_SOUND = 3,
+  SENSOR_ACCELEROMETER = 4,
+  SENSOR_COMPASS = 5,
+  SENSOR_ANALOG_IN = 6, // analog input of P0, P1 and P2 which were read recently
+  SENSOR_COUNT
 };
 
 /**
@@ -149,6 +189,7 @@ enum MbitMoreAudioCommand
 {
   STOP_TONE = 0x00,
   PLAY_TONE = 0x01,
+  QUEUE_TONES = 0x02,
 };
 
 #endif // MBIT_MORE_COMMON_H
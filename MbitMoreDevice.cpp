@@ -60,30 +60,6 @@ int average(const uint8_t *data, int dataSize) {
   return sum / dataSize;
 }
 
-/**
- * @brief Compute median value for the uint16_t array (non-destructive insertion sort).
- *
- * @param data Array to compute median.
- * @param dataSize Length of the array.
- * @return Median value.
- */
-uint16_t median(const uint16_t *data, size_t dataSize) {
-  uint16_t temp[ANALOG_IN_SAMPLES_SIZE];
-  for (size_t i = 0; i < dataSize; i++) {
-    temp[i] = data[i];
-  }
-  for (size_t i = 1; i < dataSize; i++) {
-    uint16_t key = temp[i];
-    int j = (int)i - 1;
-    while (j >= 0 && temp[j] > key) {
-      temp[j + 1] = temp[j];
-      j--;
-    }
-    temp[j + 1] = key;
-  }
-  return temp[dataSize / 2];
-}
-
 /**
  * @brief Copy ManagedString to char array with max size.
  * 
@@ -96,12 +72,122 @@ void copyManagedString(char *dst, const ManagedString &mstr, size_t maxLength) {
   memcpy(dst, mstr.toCharArray(), (len < maxLength ? len : maxLength));
 }
 
+/**
+ * @brief Period of sampling each sensor on connection [ms].
+ * Temperature changes slowly, accelerometer follows the default rate of the driver.
+ *
+ */
+static const uint16_t defaultSamplePeriods[MbitMoreSensor::SENSOR_COUNT] = {
+    10,   // SENSOR_DIGITAL
+    20,   // SENSOR_LIGHT
+    1000, // SENSOR_TEMPERATURE
+    20,   // SENSOR_SOUND
+    20,   // SENSOR_ACCELEROMETER
+    20,   // SENSOR_COMPASS
+    10,   // SENSOR_ANALOG_IN
+};
+
+static_assert(MbitMoreSensor::SENSOR_COUNT * 4 == MM_CH_BUFFER_SIZE_SAMPLER_STATS,
+              "count and average time of each sensor");
+static_assert(MM_ACTION_BUTTON == MbitMoreActionEvent::BUTTON && MM_ACTION_GESTURE == MbitMoreActionEvent::GESTURE,
+              "actions in the event queue");
+
+/**
+ * @brief Rows of the glyph of a character in the system font.
+ *
+ * @param c Character.
+ * @return const uint8_t* Rows of the glyph, or NULL when the font has no glyph.
+ */
+const uint8_t *mbitMoreSystemGlyph(char c) {
+#if MICROBIT_CODAL
+  BitmapFont font = BitmapFont::getSystemFont();
+  const int asciiStart = BITMAP_FONT_ASCII_START;
+#else // NOT MICROBIT_CODAL
+  MicroBitFont font = MicroBitFont::getSystemFont();
+  const int asciiStart = MICROBIT_FONT_ASCII_START;
+#endif // NOT MICROBIT_CODAL
+  if (c < asciiStart || c > font.asciiEnd) {
+    return NULL;
+  }
+  return font.characters + (c - asciiStart) * MM_DISPLAY_SIZE;
+}
+
+/**
+ * @brief Start a process to sample the sensors.
+ *
+ */
+void startMbitMoreSampling() {
+  MbitMoreDevice::getInstance().keepSampling();
+}
+
+/**
+ * @brief Start a process to send the queued events.
+ *
+ */
+void startMbitMoreEventTransmitting() {
+  MbitMoreDevice::getInstance().keepTransmittingEvents();
+}
+
+/**
+ * @brief Start a process to play the stored frames and the scrolled text.
+ *
+ */
+void startMbitMoreDisplayPlayer() {
+  MbitMoreDevice::getInstance().keepPlayingDisplay();
+}
+
+/**
+ * @brief Start a process to play the queued tones.
+ *
+ */
+void startMbitMoreTonePlayer() {
+  MbitMoreDevice::getInstance().keepPlayingTones();
+}
+
+/**
+ * @brief Fields of STATE: digital levels, light level, temperature and sound level.
+ *
+ */
+static const uint8_t stateFields[] = {
+    MbitMoreFieldKind::FIELD_BITS32,
+    MbitMoreFieldKind::FIELD_U8,
+    MbitMoreFieldKind::FIELD_U8,
+    MbitMoreFieldKind::FIELD_U8};
+
+/**
+ * @brief Fields of MOTION: pitch, roll, acceleration, heading and magnetic force.
+ *
+ */
+static const uint8_t motionFields[] = {
+    MbitMoreFieldKind::FIELD_S16, MbitMoreFieldKind::FIELD_S16,
+    MbitMoreFieldKind::FIELD_S16, MbitMoreFieldKind::FIELD_S16, MbitMoreFieldKind::FIELD_S16,
+    MbitMoreFieldKind::FIELD_S16,
+    MbitMoreFieldKind::FIELD_S16, MbitMoreFieldKind::FIELD_S16, MbitMoreFieldKind::FIELD_S16};
+
+/**
+ * @brief Filter of Analog In on connection: median which rejects spikes.
+ *
+ */
+static const uint8_t analogInDefaultFilter[] = {
+    MbitMoreFilterKind::FILTER_MEDIAN, ANALOG_IN_SAMPLES_SIZE};
+
+/**
+ * @brief Filter of Light Level on connection: running average.
+ *
+ */
+static const uint8_t lightLevelDefaultFilter[] = {
+    MbitMoreFilterKind::FILTER_BOXCAR, LIGHT_LEVEL_SAMPLES_SIZE};
+
 /**
  * Constructor.
  * Create a representation of the device for Microbit More service.
  * @param _uBit The instance of a MicroBit runtime.
  */
-MbitMoreDevice::MbitMoreDevice(MicroBit &_uBit) : uBit(_uBit) {
+MbitMoreDevice::MbitMoreDevice(MicroBit &_uBit)
+    : uBit(_uBit),
+      stateChange(stateFields, sizeof(stateFields)),
+      motionChange(motionFields, sizeof(motionFields)) {
+
   // Reset compass
 #if MICROBIT_CODAL
   // On microbit-v2, re-calibration destruct compass heading.
@@ -119,6 +205,8 @@ MbitMoreDevice::MbitMoreDevice(MicroBit &_uBit) : uBit(_uBit) {
   // to detect 8G gesture event
   uBit.accelerometer.setRange(8);
 
+  initializePinPort();
+
   displayVersion();
 
   uBit.messageBus.listen(
@@ -187,7 +275,68 @@ void MbitMoreDevice::initializeConfig() {
   for (size_t i = 0; i < (sizeof(initialPullUp) / sizeof(initialPullUp[0])); i++) {
     setPullMode(initialPullUp[i], MbitMorePullMode::Up);
     uBit.io.pin[initialPullUp[i]].getDigitalValue(); // set the pin to input-mode
+    updatePinMode(initialPullUp[i]);
+  }
+  stateChange.reset();
+  motionChange.reset();
+  actionEvents.reset();
+  frameStore.stop();
+  if (toneSequencer.isActive()) {
+    clearTones();
+  }
+  for (size_t i = 0; i < 3; i++) {
+    analogInFilter[i].configure(analogInDefaultFilter, sizeof(analogInDefaultFilter));
+  }
+  lightLevelFilter.configure(lightLevelDefaultFilter, sizeof(lightLevelDefaultFilter));
+}
+
+/**
+ * @brief Make the table to read the GPIO pins from the ports and get the modes of them.
+ *
+ */
+void MbitMoreDevice::initializePinPort() {
+#if MBIT_MORE_USE_PIN_PORT
+  int portPin[sizeof(gpioPin) / sizeof(gpioPin[0])];
+  for (size_t i = 0; i < sizeof(gpioPin) / sizeof(gpioPin[0]); i++) {
+    portPin[i] = (int)uBit.io.pin[gpioPin[i]].name;
+  }
+  pinPort.configure(gpioPin, portPin);
+#endif // MBIT_MORE_USE_PIN_PORT
+  for (size_t i = 0; i < sizeof(gpioPin) / sizeof(gpioPin[0]); i++) {
+    updatePinMode(gpioPin[i]);
+  }
+}
+
+/**
+ * @brief Track whether the pin is a digital input after its mode was changed.
+ *
+ * @param pinIndex index in edge pins
+ */
+void MbitMoreDevice::updatePinMode(int pinIndex) {
+  if (!isGpio(pinIndex)) {
+    return;
   }
+  pinPort.setInput(pinIndex, uBit.io.pin[pinIndex].isDigital() && uBit.io.pin[pinIndex].isInput());
+}
+
+/**
+ * @brief Read levels of the GPIO pins which are digital inputs.
+ * The IN registers are read once when the pins are in the ports, otherwise each pin is read through the HAL.
+ *
+ * @return uint32_t levels in the bits of the edge pin index
+ */
+uint32_t MbitMoreDevice::readPinLevels() {
+#if MBIT_MORE_USE_PIN_PORT
+  if (pinPort.isReady()) {
+#if MICROBIT_CODAL
+    uint32_t in[MM_PIN_PORT_COUNT] = {NRF_P0->IN, NRF_P1->IN};
+#else // NOT MICROBIT_CODAL
+    uint32_t in[MM_PIN_PORT_COUNT] = {NRF_GPIO->IN, 0};
+#endif // NOT MICROBIT_CODAL
+    return pinPort.levels(in);
+  }
+#endif // MBIT_MORE_USE_PIN_PORT
+  return mbitMoreReadPinLevels(uBit.io.pin, gpioPin, sizeof(gpioPin) / sizeof(gpioPin[0]));
 }
 
 /**
@@ -210,10 +359,12 @@ void MbitMoreDevice::updateVersionData() {
  * @param _e event which has connection data
  */
 void MbitMoreDevice::onBLEConnected(MicroBitEvent _e) {
+  startSampling();
 #if MICROBIT_CODAL
   fiber_sleep(100); // to change pull-mode in micro:bit v2
 #endif // MICROBIT_CODAL
   initializeConfig();
+  startTransmittingEvents(); // after the queues and the masks are reset
   uBit.display.stopAnimation(); // To stop display friendly name.
   uBit.display.print("M");
 }
@@ -229,7 +380,9 @@ void MbitMoreDevice::onBLEDisconnected(MicroBitEvent _e) {
 
 void MbitMoreDevice::onSerialConnected() {
   uBit.ble->stopAdvertising();
+  startSampling();
   initializeConfig();
+  startTransmittingEvents(); // after the queues and the masks are reset
   uBit.display.stopAnimation(); // To stop display friendly name.
   uBit.display.print("M");
   serialConnected = true;
@@ -245,10 +398,17 @@ void MbitMoreDevice::onCommandReceived(uint8_t *data, size_t length) {
   const int command = (data[0] >> 5);
   if (command == MbitMoreCommand::CMD_DISPLAY) {
     const int displayCommand = data[0] & 0b11111;
+    if (displayCommand <= MbitMoreDisplayCommand::PIXELS_PACKED_1) {
+      // The host draws the LED.
+      frameStore.stop();
+      textScroller.stop();
+    }
     if (displayCommand == MbitMoreDisplayCommand::TEXT) {
-      char text[length - 1] = {0};
-      memcpy(text, &(data[2]), length - 2);
-      displayText(text, (data[1] * 10));
+      if (length > 2) {
+        displayText((const char *)&data[2], length - 2, (data[1] * 10));
+      }
+    } else if (displayCommand == MbitMoreDisplayCommand::TEXT_APPEND) {
+      appendText((const char *)&data[1], length - 1);
     } else if (displayCommand == MbitMoreDisplayCommand::PIXELS_0) {
       setPixelsShadowLine(0, &data[1]);
       setPixelsShadowLine(1, &data[6]);
@@ -257,6 +417,26 @@ void MbitMoreDevice::onCommandReceived(uint8_t *data, size_t length) {
       setPixelsShadowLine(3, &data[1]);
       setPixelsShadowLine(4, &data[6]);
       displayShadowPixels();
+    } else if (displayCommand == MbitMoreDisplayCommand::PIXELS_PACKED_4) {
+      if (displayFrame.setPacked4(&data[1], length - 1)) {
+        displayShadowPixels();
+      }
+    } else if (displayCommand == MbitMoreDisplayCommand::PIXELS_PACKED_1) {
+      if (displayFrame.setPacked1(&data[1], length - 1)) {
+        displayShadowPixels();
+      }
+    } else if (displayCommand == MbitMoreDisplayCommand::FRAME_STORE) {
+      // index, duration [ms] as uint16_t LE and a frame of 4-bit brightness
+      if (length >= 4) {
+        frameStore.store(data[1], (uint16_t)(data[2] | (data[3] << 8)), &data[4], length - 4);
+      }
+    } else if (displayCommand == MbitMoreDisplayCommand::FRAME_PLAY) {
+      // first index, number of the frames and loop
+      if (length >= 4) {
+        playFrames(data[1], data[2], data[3] != 0);
+      }
+    } else if (displayCommand == MbitMoreDisplayCommand::FRAME_STOP) {
+      frameStore.stop();
     }
   } else if (command == MbitMoreCommand::CMD_PIN) {
     const int pinCommand = data[0] & 0b11111;
@@ -298,14 +478,20 @@ void MbitMoreDevice::onCommandReceived(uint8_t *data, size_t length) {
       listenPinEventOn(pinIndex, (int)data[2]);
     }
     touchMode[pinIndex] = false;
+    updatePinMode(pinIndex);
   } else if (command == MbitMoreCommand::CMD_AUDIO) {
     int audioCommand = data[0] & 0b11111;
     if (audioCommand == MbitMoreAudioCommand::PLAY_TONE) {
       uint32_t period;
       memcpy(&period, &(data[1]), 4);
+      if (toneSequencer.isActive()) {
+        clearTones(); // The host plays the tone.
+      }
       playTone(period, data[5]);
     } else if (audioCommand == MbitMoreAudioCommand::STOP_TONE) {
-      stopTone();
+      clearTones();
+    } else if (audioCommand == MbitMoreAudioCommand::QUEUE_TONES) {
+      queueTones(&data[1], length - 1);
     }
 #if MICROBIT_CODAL
   } else if (command == MbitMoreCommand::CMD_DATA) {
@@ -323,6 +509,31 @@ void MbitMoreDevice::onCommandReceived(uint8_t *data, size_t length) {
     if (config == MbitMoreConfig::MIC) {
 #if MICROBIT_CODAL
       micInUse = ((data[1] == 1) ? true : false);
+#endif // MICROBIT_CODAL
+#if MBIT_MORE_USE_SERIAL
+    } else if (config == MbitMoreConfig::SERIAL_BAUD) {
+      // rate is read as uint32_t little-endian.
+      uint32_t rate;
+      memcpy(&rate, &(data[1]), 4);
+      if (serialConnected) {
+        serialService->requestBaud(rate);
+      }
+    } else if (config == MbitMoreConfig::SERIAL_FRAMING) {
+      if (serialConnected) {
+        serialService->requestFraming(data[1]);
+      }
+#endif // MBIT_MORE_USE_SERIAL
+    } else if (config == MbitMoreConfig::NOTIFY_ON_CHANGE) {
+      configureNotifyOnChange(&data[1], length - 1);
+    } else if (config == MbitMoreConfig::SAMPLER) {
+      configureSampler(&data[1], length - 1);
+    } else if (config == MbitMoreConfig::FILTER) {
+      configureFilter(&data[1], length - 1);
+    } else if (config == MbitMoreConfig::ACTION_EVENT_MASK) {
+      configureActionEvents(&data[1], length - 1);
+#if MICROBIT_CODAL
+    } else if (config == MbitMoreConfig::ACCEL_STREAM) {
+      configureAccelStream(&data[1], length - 1);
 #endif // MICROBIT_CODAL
     } else if (config == MbitMoreConfig::TOUCH) {
       int pinIndex = data[1];
@@ -342,6 +553,7 @@ void MbitMoreDevice::onCommandReceived(uint8_t *data, size_t length) {
         uBit.io.pin[pinIndex].isTouched();
 #endif // NOT MICROBIT_CODAL
         touchMode[pinIndex] = true;
+        updatePinMode(pinIndex);
       } else {
         uBit.messageBus.ignore(
             componentID,
@@ -360,137 +572,490 @@ void MbitMoreDevice::onCommandReceived(uint8_t *data, size_t length) {
  * @param pattern Array of brightness(0..255) according columns.
  */
 void MbitMoreDevice::setPixelsShadowLine(int line, uint8_t *pattern) {
-  for (size_t col = 0; col < 5; col++) {
-    shadowPixcels[line][col] = pattern[col];
-  }
+  displayFrame.setRow(line, pattern);
 }
 
 /**
  * @brief Display the shadow pixels on the LED.
+ * The frame is written in one pass without yielding. Only the pixels which differ from the image on the LED
+ * are written, so that a frame is shown also after user code has drawn on the LED.
  *
  */
 void MbitMoreDevice::displayShadowPixels() {
+  if (!displayFrame.isDirty(uBit.display.image)) {
+    return;
+  }
   uBit.display.stopAnimation();
-  for (size_t y = 0; y < 5; y++) {
-    for (size_t x = 0; x < 5; x++) {
-      uBit.display.image.setPixelValue(x, y, shadowPixcels[y][x]);
+  displayFrame.present(uBit.display.image);
+}
+
+/**
+ * @brief Start playing the stored frames on the LED.
+ *
+ * @param first Index of the first frame.
+ * @param count Number of the frames.
+ * @param loop True to repeat the frames.
+ */
+void MbitMoreDevice::playFrames(int first, int count, bool loop) {
+  if (!frameStore.play(first, count, loop, (uint32_t)uBit.systemTime()))
+    return;
+  textScroller.stop();
+  wakeDisplayPlayer();
+}
+
+/**
+ * @brief Start the player of the LED, or wake it when it is waiting.
+ *
+ */
+void MbitMoreDevice::wakeDisplayPlayer() {
+  if (!playerRunning) {
+    playerRunning = true;
+    create_fiber(startMbitMoreDisplayPlayer);
+    return;
+  }
+  MicroBitEvent(MBIT_MORE_ID_DISPLAY_PLAYER, MBIT_MORE_EVT_DISPLAY_PLAY);
+}
+
+/**
+ * @brief Keep showing the stored frames and the scrolled text on their time. It never returns.
+ * Only one of them plays at a time. The player sleeps until the next step, up to MBIT_MORE_DISPLAY_PLAYER_TICK.
+ *
+ */
+void MbitMoreDevice::keepPlayingDisplay() {
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  while (true) {
+    if (!frameStore.isPlaying() && !textScroller.isPlaying()) {
+      fiber_wait_for_event(MBIT_MORE_ID_DISPLAY_PLAYER, MBIT_MORE_EVT_DISPLAY_PLAY);
+      continue;
+    }
+    uint32_t now = (uint32_t)uBit.systemTime();
+    if (frameStore.update(now, pixels) || textScroller.update(now, pixels)) {
+      displayFrame.setPixels(pixels);
+      displayShadowPixels();
+    }
+    uint32_t wait = frameStore.isPlaying() ? frameStore.waitTime(now) : textScroller.waitTime(now);
+    if (wait > 0) {
+      fiber_sleep((wait < MBIT_MORE_DISPLAY_PLAYER_TICK) ? wait : MBIT_MORE_DISPLAY_PLAYER_TICK);
     }
   }
 }
 
 /**
  * @brief Display text on LED.
+ * The text is scrolled from the columns of the glyphs in a fixed buffer, without allocation.
  *
- * @param text Contents to display with null termination.
+ * @param text Contents to display, which ends at the length or a null character.
+ * @param length Maximum length of the text.
  * @param delay The time to delay between characters, in milliseconds.
  */
-void MbitMoreDevice::displayText(char *text, int delay) {
-  ManagedString mstr(text);
-  if (mstr.length() < 1) {
+void MbitMoreDevice::displayText(const char *text, size_t length, int delay) {
+  if (length < 1 || text[0] == '\0') {
     return;
   }
-  uBit.display.stopAnimation();
   if (delay <= 0) {
-    uBit.display.printCharAsync(mstr.charAt(0), delay);
+    uint8_t pixels[MM_DISPLAY_PIXELS];
+    mbitMoreGlyphPixels(mbitMoreSystemGlyph(text[0]), pixels);
+    displayFrame.setPixels(pixels);
+    displayShadowPixels();
     return;
   }
-  uBit.display.scrollAsync(mstr, delay);
+  textStepTime = (uint16_t)delay;
+  textScroller.start(textStepTime, (uint32_t)uBit.systemTime());
+  textScroller.append(text, length);
+  wakeDisplayPlayer();
 }
 
 /**
- * @brief Update GPIO and sensors state.
+ * @brief Append text to the scrolling text, or start scrolling it when the scroll has ended.
+ * Characters which do not fit in the buffer are dropped.
  *
- * @param data Buffer for BLE characteristics.
+ * @param text Contents to append, which ends at the length or a null character.
+ * @param length Maximum length of the text.
  */
-void MbitMoreDevice::updateState(uint8_t *data) {
-  uint32_t digitalLevels = 0;
-  for (size_t i = 0; i < sizeof(gpioPin) / sizeof(gpioPin[0]); i++) {
-    if (uBit.io.pin[gpioPin[i]].isDigital()) {
-      if (uBit.io.pin[gpioPin[i]].isInput()) {
-        digitalLevels =
-            digitalLevels |
-            (uBit.io.pin[gpioPin[i]].getDigitalValue() << gpioPin[i]);
-      }
-    }
+void MbitMoreDevice::appendText(const char *text, size_t length) {
+  if (length < 1 || text[0] == '\0') {
+    return;
   }
-  if (touchMode[0]) {
-    digitalLevels = digitalLevels | (uBit.io.pin[0].isTouched() << MbitMoreButtonStateIndex::P0);
+  if (!textScroller.isPlaying()) {
+    frameStore.stop();
+    textScroller.start(textStepTime, (uint32_t)uBit.systemTime());
   }
-  if (touchMode[1]) {
-    digitalLevels = digitalLevels | (uBit.io.pin[1].isTouched() << MbitMoreButtonStateIndex::P1);
+  textScroller.append(text, length);
+  wakeDisplayPlayer();
+}
+
+/**
+ * @brief Update GPIO and sensors state from the snapshot.
+ *
+ * @param data Buffer for BLE characteristics.
+ */
+void MbitMoreDevice::updateState(uint8_t *data) {
+  write32LE(data, snapshot.digitalLevels);
+  data[4] = snapshot.lightLevel;
+  data[5] = snapshot.temperature;
+  data[6] = snapshot.soundLevel;
+}
+
+/**
+ * @brief Update data of motion from the snapshot.
+ *
+ * @param data Buffer for BLE characteristics.
+ */
+void MbitMoreDevice::updateMotion(uint8_t *data) {
+  // Pitch and roll (radians / 1000) are sent as int16_t little-endian [0..3].
+  write16LE(&data[0], snapshot.pitch);
+  write16LE(&data[2], snapshot.roll);
+  // Acceleration X, Y, Z [milli-g] are sent as int16_t little-endian [4..9].
+  write16LE(&data[4], snapshot.acceleration[0]);
+  write16LE(&data[6], snapshot.acceleration[1]);
+  write16LE(&data[8], snapshot.acceleration[2]);
+  // Compass Heading is sent as uint16_t little-endian [10..11]
+  write16LE(&data[10], snapshot.heading);
+  // Magnetic force X, Y, Z (micro-teslas) are sent as int16_t little-endian [12..17].
+  write16LE(&data[12], snapshot.magneticForce[0]);
+  write16LE(&data[14], snapshot.magneticForce[1]);
+  write16LE(&data[16], snapshot.magneticForce[2]);
+}
+
+/**
+ * @brief Start sampling the sensors in their own period, if not yet.
+ *
+ */
+void MbitMoreDevice::startSampling() {
+  if (sampling)
+    return;
+  sampling = true;
+  unsigned long now = uBit.systemTime();
+  for (int i = 0; i < MbitMoreSensor::SENSOR_COUNT; i++) {
+    sampler.setPeriod(i, defaultSamplePeriods[i], now);
   }
-  if (touchMode[2]) {
-    digitalLevels = digitalLevels | (uBit.io.pin[2].isTouched() << MbitMoreButtonStateIndex::P2);
+  // Fill the snapshot before it is sent.
+  sampleDueSensors();
+  create_fiber(startMbitMoreSampling);
+}
+
+/**
+ * @brief Sample the sensors whose deadline has come.
+ *
+ */
+void MbitMoreDevice::sampleDueSensors() {
+  unsigned long now = uBit.systemTime();
+  for (int i = 0; i < MbitMoreSensor::SENSOR_COUNT; i++) {
+    if (!sampler.isDue(i, now))
+      continue;
+    uint64_t start = system_timer_current_time_us();
+    sampleSensor(i);
+    sampler.sampled(i, now, (uint32_t)(system_timer_current_time_us() - start));
   }
-  digitalLevels = digitalLevels | (uBit.buttonA.isPressed() << MbitMoreButtonStateIndex::A);
-  digitalLevels = digitalLevels | (uBit.buttonB.isPressed() << MbitMoreButtonStateIndex::B);
+}
+
+/**
+ * @brief Keep sampling the sensors. It never returns.
+ *
+ */
+void MbitMoreDevice::keepSampling() {
+  while (true) {
+    sampleDueSensors();
 #if MICROBIT_CODAL
-  digitalLevels = digitalLevels | (uBit.logo.isPressed() << MbitMoreButtonStateIndex::LOGO);
+    if (accelStreaming) {
+      flushAccelStream();
+    }
 #endif // MICROBIT_CODAL
-  write32LE(data, digitalLevels);
-  data[4] = sampleLightLevel();
-  data[5] = (uint8_t)(uBit.thermometer.getTemperature() + 128);
+    unsigned long wait = sampler.sleepTime(uBit.systemTime(), MBIT_MORE_SAMPLER_IDLE);
+    fiber_sleep((wait > 0) ? wait : 1);
+  }
+}
+
+/**
+ * @brief Sample the sensor into the snapshot.
+ *
+ * @param sensor Sensor to sample.
+ */
+void MbitMoreDevice::sampleSensor(int sensor) {
+  switch (sensor) {
+  case MbitMoreSensor::SENSOR_DIGITAL: {
+    uint32_t digitalLevels = readPinLevels();
+    if (touchMode[0]) {
+      digitalLevels = digitalLevels | (uBit.io.pin[0].isTouched() << MbitMoreButtonStateIndex::P0);
+    }
+    if (touchMode[1]) {
+      digitalLevels = digitalLevels | (uBit.io.pin[1].isTouched() << MbitMoreButtonStateIndex::P1);
+    }
+    if (touchMode[2]) {
+      digitalLevels = digitalLevels | (uBit.io.pin[2].isTouched() << MbitMoreButtonStateIndex::P2);
+    }
+    digitalLevels = digitalLevels | (uBit.buttonA.isPressed() << MbitMoreButtonStateIndex::A);
+    digitalLevels = digitalLevels | (uBit.buttonB.isPressed() << MbitMoreButtonStateIndex::B);
 #if MICROBIT_CODAL
-  if (micInUse) {
-    data[6] = getMicLevel();
+    digitalLevels = digitalLevels | (uBit.logo.isPressed() << MbitMoreButtonStateIndex::LOGO);
+#endif // MICROBIT_CODAL
+    snapshot.digitalLevels = digitalLevels;
+    break;
   }
+  case MbitMoreSensor::SENSOR_LIGHT:
+    snapshot.lightLevel = sampleLightLevel();
+    break;
+  case MbitMoreSensor::SENSOR_TEMPERATURE:
+    snapshot.temperature = (uint8_t)(uBit.thermometer.getTemperature() + 128);
+    break;
+  case MbitMoreSensor::SENSOR_SOUND:
+#if MICROBIT_CODAL
+    if (micInUse) {
+      snapshot.soundLevel = getMicLevel();
+    }
 #endif // MICROBIT_CODAL
+    break;
+  case MbitMoreSensor::SENSOR_ACCELEROMETER: {
+    int x = uBit.accelerometer.getX();
+    int y = uBit.accelerometer.getY();
+    int z = uBit.accelerometer.getZ();
+    orientation.update(x, y, z);
+    snapshot.pitch = orientation.pitch();
+    snapshot.roll = orientation.roll();
+    snapshot.acceleration[0] = (int16_t)-x; // Face side is positive in Z-axis.
+    snapshot.acceleration[1] = (int16_t)y;
+    snapshot.acceleration[2] = (int16_t)-z; // Face side is positive in Z-axis.
+    break;
+  }
+  case MbitMoreSensor::SENSOR_COMPASS: {
+    int x = uBit.compass.getX();
+    int y = uBit.compass.getY();
+    int z = uBit.compass.getZ();
+    // Compensated for the tilt of the last accelerometer sample, which is right also when upside down.
+    snapshot.heading = (int16_t)orientation.heading(x, y, z);
+    snapshot.magneticForce[0] = (int16_t)(x / 1000);
+    snapshot.magneticForce[1] = (int16_t)(y / 1000);
+    snapshot.magneticForce[2] = (int16_t)(z / 1000);
+    break;
+  }
+  case MbitMoreSensor::SENSOR_ANALOG_IN: {
+    unsigned long now = uBit.systemTime();
+    for (size_t i = 0; i < 3; i++) {
+      if (!analogInFilter[i].hasValue() || (now - analogInReadTime[i]) >= MBIT_MORE_ANALOG_IN_ACTIVE ||
+          !isAnalogInSampledInBackground(i))
+        continue;
+      sampleAnalogIn(i, 1);
+    }
+    break;
+  }
+  }
 }
 
 /**
- * @brief Update data of motion.
+ * @brief Configure the period of sampling a sensor.
  *
- * @param data Buffer for BLE characteristics.
+ * @param data Sensor and the period [ms] in uint16_t little-endian, 0 to stop.
+ * @param length Length of the data.
  */
-void MbitMoreDevice::updateMotion(uint8_t *data) {
-  // Accelerometer
-  // Pitch (radians / 1000) is sent as int16_t little-endian [0..1].
-  write16LE(&data[0], (int16_t)(uBit.accelerometer.getPitchRadians() * 1000));
-  // Roll (radians / 1000) is sent as int16_t little-endian [2..3].
-  write16LE(&data[2], (int16_t)(uBit.accelerometer.getRollRadians() * 1000));
-
-  // Acceleration X [milli-g] is sent as int16_t little-endian [4..5].
-  write16LE(&data[4], (int16_t)-uBit.accelerometer.getX()); // Face side is positive in Z-axis.
-  // Acceleration Y [milli-g] is sent as int16_t little-endian [6..7].
-  write16LE(&data[6], (int16_t)uBit.accelerometer.getY());
-  // Acceleration Z [milli-g] is sent as int16_t little-endian [8..9].
-  write16LE(&data[8], (int16_t)-uBit.accelerometer.getZ()); // Face side is positive in Z-axis.
-
-  // Magnetometer
-  // Compass Heading is sent as uint16_t little-endian [10..11]
-  write16LE(&data[10], (int16_t)normalizeCompassHeading(uBit.compass.heading()));
+void MbitMoreDevice::configureSampler(const uint8_t *data, size_t length) {
+  if (length < 3 || data[0] >= MbitMoreSensor::SENSOR_COUNT)
+    return;
+  uint16_t period = data[1] | (data[2] << 8);
+  sampler.setPeriod(data[0], period, uBit.systemTime());
+  if (MbitMoreSensor::SENSOR_ACCELEROMETER == data[0] && period != 0) {
+    // Let the driver update as often as it is sampled.
+    uBit.accelerometer.setPeriod(sampler.period(data[0]));
+  }
+}
 
-  // Magnetic force X (micro-teslas) is sent as int16_t little-endian[12..13].
-  write16LE(&data[12], (int16_t)(uBit.compass.getX() / 1000));
-  // Magnetic force Y (micro-teslas) is sent as int16_t little-endian[14..15].
-  write16LE(&data[14], (int16_t)(uBit.compass.getY() / 1000));
-  // Magnetic force Z (micro-teslas) is sent as int16_t little-endian[16..17].
-  write16LE(&data[16], (int16_t)(uBit.compass.getZ() / 1000));
+/**
+ * @brief Update statistics of sampling.
+ * Number of samples and average time [us] of each sensor in uint16_t little-endian.
+ *
+ * @param data Buffer for the statistics.
+ */
+void MbitMoreDevice::updateSamplerStats(uint8_t *data) {
+  for (int i = 0; i < MbitMoreSensor::SENSOR_COUNT; i++) {
+    write16LE(&data[i * 4], (int16_t)(sampler.count(i) & 0xFFFF));
+    write16LE(&data[i * 4 + 2], (int16_t)sampler.averageTime(i));
+  }
 }
 
 /**
  * @brief Get data of analog input of the pin.
+ * It is the median of the samples taken in background while the pin is read.
  *
  * @param data Buffer for BLE characteristics.
  * @param pinIndex Index of the pin [0, 1, 2].
  */
 void MbitMoreDevice::updateAnalogIn(uint8_t *data, size_t pinIndex) {
-  if (uBit.io.pin[pinIndex].isInput()) {
+  if (!uBit.io.pin[pinIndex].isInput()) {
+    analogInFilter[pinIndex].reset();
+    return;
+  }
+  unsigned long now = uBit.systemTime();
+  if (!analogInFilter[pinIndex].hasValue() ||
+      (now - analogInReadTime[pinIndex]) >= MBIT_MORE_ANALOG_IN_ACTIVE ||
+      sampler.period(MbitMoreSensor::SENSOR_ANALOG_IN) == 0 ||
+      !isAnalogInSampledInBackground(pinIndex)) {
+    // Samples are not taken in background, convert them now.
+    analogInFilter[pinIndex].reset();
+    sampleAnalogIn(pinIndex, ANALOG_IN_SAMPLES_SIZE);
+  }
+  analogInReadTime[pinIndex] = now;
+  // analog value (0 to 1023) is sent as uint16_t little-endian.
+  write16LE(&data[0], (int16_t)analogInFilter[pinIndex].value());
+}
+
+/**
+ * @brief Convert analog input of the pin into its samples.
+ *
+ * @param pinIndex Index of the pin [0, 1, 2].
+ * @param count Number of conversions.
+ */
+void MbitMoreDevice::sampleAnalogIn(size_t pinIndex, size_t count) {
+  if (!uBit.io.pin[pinIndex].isInput()) {
+    analogInFilter[pinIndex].reset();
+    return;
+  }
 #if MICROBIT_CODAL
-    uBit.io.pin[pinIndex].setPull(PullMode::None);
+  uBit.io.pin[pinIndex].setPull(PullMode::None);
 #else // NOT MICROBIT_CODAL
-    uBit.io.pin[pinIndex].setPull(PinMode::PullNone);
+  uBit.io.pin[pinIndex].setPull(PinMode::PullNone);
 #endif // NOT MICROBIT_CODAL
+  for (size_t i = 0; i < count; i++) {
+    analogInFilter[pinIndex].push((uint16_t)uBit.io.pin[pinIndex].getAnalogValue());
+  }
+  setPullMode(pinIndex, pullMode[pinIndex]);
+  updatePinMode(pinIndex);
+}
 
-    // filter
-    for (size_t i = 0; i < ANALOG_IN_SAMPLES_SIZE; i++) {
-      analogInSamples[pinIndex][i] = (uint16_t)uBit.io.pin[pinIndex].getAnalogValue();
-    }
-    uint16_t value = median(analogInSamples[pinIndex], ANALOG_IN_SAMPLES_SIZE);
+/**
+ * @brief Whether Analog In of the pin can be sampled in background.
+ * A conversion releases the pull of the pin, which may make spurious digital levels and pin events.
+ * A pin which is pulled or listened for events is converted only when it is read, as it was before the sampler.
+ *
+ * @param pinIndex Index of the pin [0, 1, 2].
+ * @return true the pin can be sampled in background
+ */
+bool MbitMoreDevice::isAnalogInSampledInBackground(size_t pinIndex) {
+  return MbitMorePullMode::None == pullMode[pinIndex] && !analogInPinEvent[pinIndex];
+}
+
+/**
+ * @brief Update the value of the channel by its handler.
+ *
+ * @param channel Channel in the table.
+ * @param data Buffer for the channel.
+ */
+void MbitMoreDevice::updateChannel(const MbitMoreChannel &channel, uint8_t *data) {
+  switch (channel.handler) {
+  case MbitMoreChannelHandler::CH_HANDLER_STATE:
+    updateState(data);
+    break;
+  case MbitMoreChannelHandler::CH_HANDLER_MOTION:
+    updateMotion(data);
+    break;
+  case MbitMoreChannelHandler::CH_HANDLER_ANALOG_IN:
+    updateAnalogIn(data, channel.arg);
+    break;
+  case MbitMoreChannelHandler::CH_HANDLER_SAMPLER_STATS:
+    updateSamplerStats(data);
+    break;
+  default:
+    break;
+  }
+}
 
-    // analog value (0 to 1023) is sent as uint16_t little-endian.
-    write16LE(&data[0], (int16_t)value);
-    setPullMode(pinIndex, pullMode[pinIndex]);
+/**
+ * @brief Whether to notify the freshly sampled value of the channel.
+ * STATE and MOTION are notified when a field changed beyond the deadband or
+ * the keep-alive interval has passed. The others are notified always.
+ *
+ * @param channel Channel in the table.
+ * @param data Sampled value of the channel.
+ * @return true the value has to be notified
+ */
+bool MbitMoreDevice::shouldNotifyChannel(const MbitMoreChannel &channel, const uint8_t *data) {
+  switch (channel.handler) {
+  case MbitMoreChannelHandler::CH_HANDLER_STATE:
+    return stateChange.shouldNotify(data, uBit.systemTime());
+  case MbitMoreChannelHandler::CH_HANDLER_MOTION:
+    return motionChange.shouldNotify(data, uBit.systemTime());
+  default:
+    return true;
+  }
+}
+
+/**
+ * @brief Configure notifications on changes.
+ *
+ * @param data Flags of channels to notify only changes, deadband of STATE, deadband of MOTION
+ * in uint16_t little-endian and keep-alive interval [ms] in uint16_t little-endian.
+ * @param length Length of the data.
+ */
+void MbitMoreDevice::configureNotifyOnChange(const uint8_t *data, size_t length) {
+  if (length < 1)
+    return;
+  stateChange.enabled = (data[0] & 0x01);
+  motionChange.enabled = (data[0] & 0x02);
+  if (length >= 2) {
+    stateChange.deadband = data[1];
+  }
+  if (length >= 4) {
+    motionChange.deadband = data[2] | (data[3] << 8);
+  }
+  if (length >= 6) {
+    uint16_t keepAlive = data[4] | (data[5] << 8);
+    if (keepAlive == 0)
+      keepAlive = MM_CHANGE_KEEP_ALIVE_DEFAULT;
+    stateChange.keepAlive = keepAlive;
+    motionChange.keepAlive = keepAlive;
+  }
+  stateChange.reset();
+  motionChange.reset();
+}
+
+/**
+ * @brief Configure the filter of a sensor.
+ *
+ * @param data Target of the filter and pairs of the kind and the parameter of each stage.
+ * @param length Length of the data.
+ */
+void MbitMoreDevice::configureFilter(const uint8_t *data, size_t length) {
+  if (length < 1)
+    return;
+  if (MbitMoreFilterTarget::FILTER_LIGHT == data[0]) {
+    lightLevelFilter.configure(&data[1], length - 1);
+  } else if (data[0] <= MbitMoreFilterTarget::FILTER_ANALOG_IN_P2) {
+    analogInFilter[data[0]].configure(&data[1], length - 1);
+  }
+}
+
+/**
+ * @brief Send the level of the tone queue, if it has changed.
+ * It is sent on the action event channel in the format of TONE_QUEUE, and dropped when the channel is not listened to.
+ *
+ * @return true the report was sent, dropped or not needed, false the link has no room
+ */
+bool MbitMoreDevice::flushToneReport() {
+  if (!toneReportPending)
+    return true;
+  uint8_t *data = moreService->actionEventChBuffer;
+  memset(data, 0, MM_CH_BUFFER_SIZE_NOTIFY);
+  toneSequencer.report(data);
+  data[MBIT_MORE_DATA_FORMAT_INDEX] = MbitMoreDataFormat::TONE_QUEUE;
+  if (MM_NOTIFY_FULL == notifyEventPacket(MM_CH_ID_ACTION_EVENT, data, MM_CH_BUFFER_SIZE_NOTIFY)) {
+    return false;
+  }
+  // Sent, or dropped because nobody listens. The next change of the queue makes a new report.
+  toneReportPending = false;
+  return true;
+}
+
+/**
+ * @brief Configure the masks of the action events to send.
+ * Bit (ID - 1) of a mask passes the event ID. All events pass by default.
+ *
+ * @param data mask of the button events and mask of the gesture events in uint16_t little-endian
+ * @param length length of the data
+ */
+void MbitMoreDevice::configureActionEvents(const uint8_t *data, size_t length) {
+  if (length >= 1) {
+    actionEvents.buttonMask = data[0];
+  }
+  if (length >= 3) {
+    actionEvents.gestureMask = (uint16_t)(data[1] | (data[2] << 8));
   }
 }
 
@@ -500,14 +1065,7 @@ void MbitMoreDevice::updateAnalogIn(uint8_t *data, size_t pinIndex) {
  * @return int Filtered light level.
  */
 int MbitMoreDevice::sampleLightLevel() {
-  lightLevelSamplesLast++;
-  if (lightLevelSamplesLast >= LIGHT_LEVEL_SAMPLES_SIZE) {
-    lightLevelSamplesLast = 0;
-  }
-  uint8_t newSample = (uint8_t)uBit.display.readLightLevel();
-  lightLevelSum = lightLevelSum - lightLevelSamples[lightLevelSamplesLast] + newSample;
-  lightLevelSamples[lightLevelSamplesLast] = newSample;
-  return lightLevelSum / LIGHT_LEVEL_SAMPLES_SIZE;
+  return lightLevelFilter.push((uint8_t)uBit.display.readLightLevel());
 }
 
 /**
@@ -544,6 +1102,73 @@ void MbitMoreDevice::stopTone() {
   speakerPin.setAnalogValue(0);
 }
 
+/**
+ * @brief Queue the notes to play after the queued ones.
+ * Notes which do not fit in the queue are dropped, which the host can see in the report of the queue.
+ *
+ * @param data Notes of period [us] in uint16_t, volume and duration [ms] in uint16_t little-endian.
+ * @param length Length of the data.
+ */
+void MbitMoreDevice::queueTones(const uint8_t *data, size_t length) {
+  toneSequencer.push(data, length);
+  reportToneQueue();
+  if (!tonePlayerRunning) {
+    tonePlayerRunning = true;
+    create_fiber(startMbitMoreTonePlayer);
+    return;
+  }
+  MicroBitEvent(MBIT_MORE_ID_TONE_PLAYER, MBIT_MORE_EVT_TONE_WAKE);
+}
+
+/**
+ * @brief Remove the queued notes and stop playing tone.
+ *
+ */
+void MbitMoreDevice::clearTones() {
+  toneSequencer.clear();
+  stopTone();
+  reportToneQueue();
+}
+
+/**
+ * @brief Keep playing the queued notes on their time. It never returns.
+ * On v2 the player is woken by the system timer at the microsecond of the next note.
+ * On v1 it sleeps in the ticks of the scheduler.
+ *
+ */
+void MbitMoreDevice::keepPlayingTones() {
+  MbitMoreTone tone;
+  while (true) {
+    if (!toneSequencer.isActive()) {
+      fiber_wait_for_event(MBIT_MORE_ID_TONE_PLAYER, MBIT_MORE_EVT_TONE_WAKE);
+      continue;
+    }
+    uint64_t now = system_timer_current_time_us();
+    if (toneSequencer.update(now, &tone)) {
+      playTone(tone.period, tone.volume);
+      reportToneQueue();
+    }
+    uint64_t wait = toneSequencer.waitTime(now);
+    if (wait == 0)
+      continue;
+#if MICROBIT_CODAL
+    system_timer_event_after_us(wait, MBIT_MORE_ID_TONE_PLAYER, MBIT_MORE_EVT_TONE_WAKE);
+    fiber_wait_for_event(MBIT_MORE_ID_TONE_PLAYER, MBIT_MORE_EVT_TONE_WAKE);
+#else // NOT MICROBIT_CODAL
+    fiber_sleep((unsigned long)((wait + 999) / 1000));
+#endif // NOT MICROBIT_CODAL
+  }
+}
+
+/**
+ * @brief Request to send the level of the tone queue.
+ *
+ */
+void MbitMoreDevice::reportToneQueue() {
+  toneReportPending = true;
+  MicroBitEvent(MBIT_MORE_ID_EVENT_QUEUE, MBIT_MORE_EVT_QUEUED);
+}
+
 #if MICROBIT_CODAL
 /**
  * @brief Return index for the label
@@ -635,18 +1260,11 @@ ManagedString MbitMoreDevice::dataContentAsText(int labelID) {
  * @param dataContent 
  */
 void MbitMoreDevice::sendNumberWithLabel(const ManagedString &dataLabel, float dataContent) {
-  uint8_t *data = moreService->dataChBuffer;
-  memset(data, 0, MM_CH_BUFFER_SIZE_NOTIFY);
+  uint8_t data[MM_CH_BUFFER_SIZE_NOTIFY] = {0};
   copyManagedString((char *)(&data[0]), dataLabel, MBIT_MORE_DATA_LABEL_SIZE);
   memcpy(&data[MBIT_MORE_DATA_LABEL_SIZE], &dataContent, 4);
   data[MBIT_MORE_DATA_FORMAT_INDEX] = MbitMoreDataFormat::DATA_NUMBER;
-#if MBIT_MORE_USE_SERIAL
-  if (serialConnected) {
-    serialService->notifyOnSerial(0x0130, data, MM_CH_BUFFER_SIZE_NOTIFY);
-    return;
-  }
-#endif // MBIT_MORE_USE_SERIAL
-  moreService->notifyData();
+  notifyDataPacket(data);
 }
 
 /**
@@ -656,8 +1274,7 @@ void MbitMoreDevice::sendNumberWithLabel(const ManagedString &dataLabel, float d
  * @param dataContent 
  */
 void MbitMoreDevice::sendTextWithLabel(const ManagedString &dataLabel, const ManagedString &dataContent) {
-  uint8_t *data = moreService->dataChBuffer;
-  memset(data, 0, MM_CH_BUFFER_SIZE_NOTIFY);
+  uint8_t data[MM_CH_BUFFER_SIZE_NOTIFY] = {0};
   copyManagedString(
       (char *)(&data[0]),
       dataLabel,
@@ -667,15 +1284,116 @@ void MbitMoreDevice::sendTextWithLabel(const ManagedString &dataLabel, const Man
       dataContent,
       MBIT_MORE_DATA_CONTENT_SIZE);
   data[MBIT_MORE_DATA_FORMAT_INDEX] = MbitMoreDataFormat::DATA_TEXT;
+  notifyDataPacket(data);
+}
+
+/**
+ * @brief Notify a packet of data to the host.
+ * It sleeps while the serial link has no room, because it runs on a fiber of the user program
+ * and the message should not be lost. The packet is kept on the stack of the caller,
+ * so that another fiber can not overwrite it while this sleeps.
+ *
+ * @param data Packet of MM_CH_BUFFER_SIZE_NOTIFY.
+ */
+void MbitMoreDevice::notifyDataPacket(uint8_t *data) {
 #if MBIT_MORE_USE_SERIAL
   if (serialConnected) {
-    serialService->notifyOnSerial(0x0130, data, MM_CH_BUFFER_SIZE_NOTIFY);
+    serialService->notifyOnSerial(MM_CH_ID_DATA, data, MM_CH_BUFFER_SIZE_NOTIFY, true);
     return;
   }
 #endif // MBIT_MORE_USE_SERIAL
+  memcpy(moreService->dataChBuffer, data, MM_CH_BUFFER_SIZE_NOTIFY);
   moreService->notifyData();
 }
 
+/**
+ * @brief Configure streaming of the accelerometer.
+ *
+ * @param data Period of the accelerometer [ms], 0 to stop, and max length of a packet.
+ * @param length Length of the data.
+ */
+void MbitMoreDevice::configureAccelStream(const uint8_t *data, size_t length) {
+  if (length < 1)
+    return;
+  if (data[0] == 0) {
+    stopAccelStream();
+    return;
+  }
+  accelStreamPacketSize = MM_CH_BUFFER_SIZE_NOTIFY;
+  if (length >= 2 && accelStream.capacity(data[1]) > 0) {
+    accelStreamPacketSize = (data[1] < MM_CH_BUFFER_SIZE_ACCEL_STREAM) ? data[1] : MM_CH_BUFFER_SIZE_ACCEL_STREAM;
+  }
+  accelStream.reset();
+  // The driver takes the nearest rate it supports, and the sampler polls it as often.
+  uBit.accelerometer.setPeriod(data[0]);
+  sampler.setPeriod(MbitMoreSensor::SENSOR_ACCELEROMETER, data[0], uBit.systemTime());
+  if (!accelStreaming) {
+    uBit.messageBus.listen(
+        MICROBIT_ID_ACCELEROMETER,
+        MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE,
+        this,
+        &MbitMoreDevice::onAccelerometerUpdated,
+        MESSAGE_BUS_LISTENER_IMMEDIATE);
+    accelStreaming = true;
+  }
+}
+
+/**
+ * @brief Stop streaming of the accelerometer and restore its period.
+ *
+ */
+void MbitMoreDevice::stopAccelStream() {
+  if (!accelStreaming)
+    return;
+  uBit.messageBus.ignore(
+      MICROBIT_ID_ACCELEROMETER,
+      MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE,
+      this,
+      &MbitMoreDevice::onAccelerometerUpdated);
+  accelStreaming = false;
+  uint16_t period = defaultSamplePeriods[MbitMoreSensor::SENSOR_ACCELEROMETER];
+  uBit.accelerometer.setPeriod(period);
+  sampler.setPeriod(MbitMoreSensor::SENSOR_ACCELEROMETER, period, uBit.systemTime());
+}
+
+/**
+ * @brief Invoked when the accelerometer has a new sample.
+ *
+ * @param evt event of the update
+ */
+void MbitMoreDevice::onAccelerometerUpdated(MicroBitEvent evt) {
+  Sample3D sample = uBit.accelerometer.getSample();
+  // Face side is positive in Z-axis as MOTION.
+  accelStream.push(uBit.systemTime(), (int16_t)-sample.x, (int16_t)sample.y, (int16_t)-sample.z);
+}
+
+/**
+ * @brief Send the samples of the accelerometer in packets while the link accepts them.
+ * A packet which is not full waits for more samples up to MBIT_MORE_ACCEL_STREAM_LATENCY.
+ *
+ */
+void MbitMoreDevice::flushAccelStream() {
+  unsigned long now = uBit.systemTime();
+  size_t packetSize = accelStreamPacketSize;
+#if MBIT_MORE_USE_SERIAL
+  if (serialConnected && packetSize > MM_SERIAL_RESPONSE_PAYLOAD_MAX) {
+    packetSize = MM_SERIAL_RESPONSE_PAYLOAD_MAX;
+  }
+#endif // MBIT_MORE_USE_SERIAL
+  while (accelStream.size() > 0) {
+    if (accelStream.size() < accelStream.capacity(packetSize) &&
+        (now - accelStream.oldestTime()) < MBIT_MORE_ACCEL_STREAM_LATENCY) {
+      return;
+    }
+    uint8_t *packet = moreService->accelStreamChBuffer;
+    size_t packetLength = accelStream.pack(packet, packetSize);
+    if (MM_NOTIFY_FULL == notifyEventPacket(MM_CH_ID_ACCEL_STREAM, packet, packetLength)) {
+      return;
+    }
+    accelStream.sent();
+  }
+}
+
 #endif // MICROBIT_CODAL
 
 /**
@@ -690,6 +1408,10 @@ void MbitMoreDevice::listenPinEventOn(int pinIndex, int eventType) {
   if (!isGpio(pinIndex)) {
     return;
   }
+  if (pinIndex < 3) {
+    analogInPinEvent[pinIndex] =
+        (eventType == MbitMorePinEventType::ON_EDGE || eventType == MbitMorePinEventType::ON_PULSE);
+  }
   // conventional scheme to convert from pin index to componentID in v1 and v2.
   int componentID = pinIndex + 100;
   uBit.messageBus.ignore(
@@ -760,27 +1482,120 @@ void MbitMoreDevice::listenPinEventOn(int pinIndex, int eventType) {
 
 /**
  * Callback. Invoked when a pin event sent.
+ * The event is queued and sent by the transmitter, so that a burst of events is not overwritten.
  */
 void MbitMoreDevice::onPinEvent(MicroBitEvent evt) {
-  uint8_t *data = moreService->pinEventChBuffer;
-
-  // pinIndex is sent as uint8_t.
+  MbitMorePinEventRecord pinEvent;
   // conventional scheme to convert from componentID to pin index in v1 and v2.
-  data[0] = evt.source - 100;
-  // event ID is sent as uint8_t.
-  data[1] = (uint8_t)evt.value;
-
-  // event timestamp is sent as uint32_t little-endian
+  pinEvent.pin = evt.source - 100;
+  pinEvent.event = (uint8_t)evt.value;
   // downcast from uint64_t value.
-  write32LE(&(data[2]), (uint32_t)evt.timestamp);
-  data[MBIT_MORE_DATA_FORMAT_INDEX] = MbitMoreDataFormat::PIN_EVENT;
+  pinEvent.timestamp = (uint32_t)evt.timestamp;
+  bool wasEmpty = (pinEvents.size() == 0);
+  if (pinEvents.push(pinEvent) && wasEmpty) {
+    MicroBitEvent(MBIT_MORE_ID_EVENT_QUEUE, MBIT_MORE_EVT_QUEUED);
+  }
+}
+
+/**
+ * @brief Start sending the queued events, if not yet.
+ *
+ */
+void MbitMoreDevice::startTransmittingEvents() {
+  if (transmittingEvents)
+    return;
+  transmittingEvents = true;
+  create_fiber(startMbitMoreEventTransmitting);
+}
+
+/**
+ * @brief Keep sending the queued events when they come. It never returns.
+ *
+ */
+void MbitMoreDevice::keepTransmittingEvents() {
+  while (true) {
+    if (actionEvents.size() == 0 && pinEvents.size() == 0 && !toneReportPending) {
+      fiber_wait_for_event(MBIT_MORE_ID_EVENT_QUEUE, MBIT_MORE_EVT_QUEUED);
+      continue;
+    }
+    bool sent = flushActionEvents();
+    sent = flushToneReport() && sent;
+    sent = flushPinEvents() && sent;
+    if (!sent) {
+      fiber_sleep(MBIT_MORE_EVENT_RETRY);
+    }
+  }
+}
+
+/**
+ * @brief Notify a packet of events on the link which is connected.
+ * A packet which nobody listens to is reported as such, so that the caller discards it instead of retrying.
+ *
+ * @param ch Channel of the packet: PIN_EVENT, ACTION_EVENT or ACCEL_STREAM.
+ * @param packet Buffer of the channel which has the packet.
+ * @param length Length of the packet.
+ * @return MbitMoreNotifyResult whether the packet was sent, is not listened to or has no room
+ */
+MbitMoreNotifyResult MbitMoreDevice::notifyEventPacket(uint16_t ch, uint8_t *packet, size_t length) {
+  bool sent = true;
 #if MBIT_MORE_USE_SERIAL
   if (serialConnected) {
-    serialService->notifyOnSerial(0x0110, data, MM_CH_BUFFER_SIZE_NOTIFY);
-    return;
+    if (!serialService->isSubscribed(ch)) {
+      return MM_NOTIFY_UNSUBSCRIBED;
+    }
+    sent = serialService->notifyOnSerial(ch, packet, length);
+    return sent ? MM_NOTIFY_SENT : MM_NOTIFY_FULL;
   }
 #endif // MBIT_MORE_USE_SERIAL
-  moreService->notifyPinEvent();
+  switch (ch) {
+  case MM_CH_ID_PIN_EVENT:
+    sent = moreService->notifyPinEvent();
+    break;
+  case MM_CH_ID_ACTION_EVENT:
+    sent = moreService->notifyActionEvent();
+    break;
+#if MICROBIT_CODAL
+  case MM_CH_ID_ACCEL_STREAM:
+    sent = moreService->notifyAccelStream(length);
+    break;
+#endif // MICROBIT_CODAL
+  default:
+    break;
+  }
+  return sent ? MM_NOTIFY_SENT : MM_NOTIFY_FULL;
+}
+
+/**
+ * @brief Send the queued pin events in packets while the link accepts them.
+ * A packet of one event is PIN_EVENT as before, more events are packed into PIN_EVENT_BATCH.
+ * A packet is the value of the 20-byte characteristic, with the data format at its last byte
+ * where hosts look on both links. A larger MTU or serial payload does not make the value longer,
+ * so a packet holds up to 2 events, as the action events do.
+ *
+ * @return true all events were sent or discarded, false the link has no room
+ */
+bool MbitMoreDevice::flushPinEvents() {
+  uint8_t *data = moreService->pinEventChBuffer;
+  return mbitMoreFlushEvents(pinEvents, data, MBIT_MORE_DATA_FORMAT_INDEX, [this, data](size_t count) {
+    data[MBIT_MORE_DATA_FORMAT_INDEX] =
+        (count == 1) ? MbitMoreDataFormat::PIN_EVENT : MbitMoreDataFormat::PIN_EVENT_BATCH;
+    return notifyEventPacket(MM_CH_ID_PIN_EVENT, data, MM_CH_BUFFER_SIZE_NOTIFY);
+  });
+}
+
+/**
+ * @brief Send the queued action events in packets while the link accepts them.
+ * A packet of one event is ACTION_EVENT as before, more events are packed into ACTION_EVENT_BATCH.
+ *
+ * @return true all events were sent or discarded, false the link has no room
+ */
+bool MbitMoreDevice::flushActionEvents() {
+  uint8_t *data = moreService->actionEventChBuffer;
+  return mbitMoreFlushEvents(actionEvents, data, MBIT_MORE_DATA_FORMAT_INDEX, [this, data](size_t count) {
+    data[MBIT_MORE_DATA_FORMAT_INDEX] =
+        (count == 1) ? MbitMoreDataFormat::ACTION_EVENT : MbitMoreDataFormat::ACTION_EVENT_BATCH;
+    return notifyEventPacket(MM_CH_ID_ACTION_EVENT, data, MM_CH_BUFFER_SIZE_NOTIFY);
+  });
 }
 
 /**
@@ -789,25 +1604,11 @@ void MbitMoreDevice::onPinEvent(MicroBitEvent evt) {
  * @param evt event which has button states
  */
 void MbitMoreDevice::onButtonChanged(MicroBitEvent evt) {
-  uint8_t *data = moreService->actionEventChBuffer;
-  data[0] = MbitMoreActionEvent::BUTTON;
-  // source is a component ID that generated the event as uint16_t little-endian.
+  // source is a component ID that generated the event.
   // MICROBIT_ID_BUTTON_A, MICROBIT_ID_IO_P0, MICROBIT_ID_LOGO, etc.
-  write16LE(&(data[1]), (int16_t)evt.source);
-  // Event ID send as uint16_t little-endian.
-  // MICROBIT_BUTTON_EVT_DOWN, MICROBIT_BUTTON_EVT_CLICK, etc.
-  data[3] = (uint8_t)evt.value;
-  // Timestamp of the event send as uint32_t little-endian.
-  // downcast from uint64_t value.
-  write32LE(&(data[4]), (uint32_t)evt.timestamp);
-  data[MBIT_MORE_DATA_FORMAT_INDEX] = MbitMoreDataFormat::ACTION_EVENT;
-#if MBIT_MORE_USE_SERIAL
-  if (serialConnected) {
-    serialService->notifyOnSerial(0x0111, data, MM_CH_BUFFER_SIZE_NOTIFY);
-    return;
-  }
-#endif // MBIT_MORE_USE_SERIAL
-  moreService->notifyActionEvent();
+  // Event ID is MICROBIT_BUTTON_EVT_DOWN, MICROBIT_BUTTON_EVT_CLICK, etc.
+  // Timestamp of the event is downcast from uint64_t value.
+  queueActionEvent(MbitMoreActionEvent::BUTTON, evt);
 }
 
 /**
@@ -816,39 +1617,21 @@ void MbitMoreDevice::onButtonChanged(MicroBitEvent evt) {
  * @param evt event which has gesture states.
  */
 void MbitMoreDevice::onGestureChanged(MicroBitEvent evt) {
-  uint8_t *data = moreService->actionEventChBuffer;
-  data[0] = MbitMoreActionEvent::GESTURE;
-  // Event ID send as uint8_t.
-  // MICROBIT_ACCELEROMETER_EVT_TILT_UP, MICROBIT_ACCELEROMETER_EVT_FACE_UP, etc.
-  data[1] = (uint8_t)evt.value;
-  // Timestamp of the event send as uint32_t little-endian.
-  // downcast from uint64_t value.
-  write32LE(&(data[2]), (uint32_t)evt.timestamp);
-  data[MBIT_MORE_DATA_FORMAT_INDEX] = MbitMoreDataFormat::ACTION_EVENT;
-#if MBIT_MORE_USE_SERIAL
-  if (serialConnected) {
-    serialService->notifyOnSerial(0x0111, data, MM_CH_BUFFER_SIZE_NOTIFY);
-    return;
-  }
-#endif // MBIT_MORE_USE_SERIAL
-  moreService->notifyActionEvent();
+  // Event ID is MICROBIT_ACCELEROMETER_EVT_TILT_UP, MICROBIT_ACCELEROMETER_EVT_FACE_UP, etc.
+  queueActionEvent(MbitMoreActionEvent::GESTURE, evt);
 }
 
 /**
- * @brief Normalize angle when upside down.
- * 
- * @param heading value of the compass heading
- * @return normalizes angle relative to north [degree]
- */
-int MbitMoreDevice::normalizeCompassHeading(int heading) {
-  if (uBit.accelerometer.getZ() > 0) {
-    if (heading <= 180) {
-      heading = 180 - heading;
-    } else {
-      heading = 360 - (heading - 180);
-    }
+ * @brief Queue the action event to be sent by the transmitter, if it passes the masks.
+ *
+ * @param action BUTTON or GESTURE
+ * @param evt event of the action
+ */
+void MbitMoreDevice::queueActionEvent(MbitMoreActionEvent action, MicroBitEvent evt) {
+  bool wasEmpty = (actionEvents.size() == 0);
+  if (actionEvents.push(action, evt.source, (uint8_t)evt.value, (uint32_t)evt.timestamp) && wasEmpty) {
+    MicroBitEvent(MBIT_MORE_ID_EVENT_QUEUE, MBIT_MORE_EVT_QUEUED);
   }
-  return heading;
 }
 
 /**
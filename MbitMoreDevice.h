@@ -6,7 +6,18 @@
 #include "MicroBit.h"
 #include "MicroBitConfig.h"
 
+#include "MbitMoreChangeDetector.h"
 #include "MbitMoreCommon.h"
+#include "MbitMoreDisplayFrame.h"
+#include "MbitMoreEventQueue.h"
+#include "MbitMoreFilter.h"
+#include "MbitMoreFrameStore.h"
+#include "MbitMoreOrientation.h"
+#include "MbitMorePinPort.h"
+#include "MbitMoreSampleScheduler.h"
+#include "MbitMoreSampleStream.h"
+#include "MbitMoreTextScroller.h"
+#include "MbitMoreToneSequencer.h"
 
 #if MBIT_MORE_USE_SERIAL
 #include "MbitMoreSerial.h"
@@ -25,16 +36,40 @@ using MbitMoreService = MbitMoreServiceDAL;
 #if MICROBIT_CODAL
 #define LIGHT_LEVEL_SAMPLES_SIZE 11
 #define ANALOG_IN_SAMPLES_SIZE 5
+#define MBIT_MORE_FILTER_WINDOW 11
+#define MBIT_MORE_FILTER_STAGES 3
+#define MBIT_MORE_PIN_EVENT_QUEUE 64
+#define MBIT_MORE_ACTION_EVENT_QUEUE 32
+#define MBIT_MORE_FRAME_STORE 32
+#define MBIT_MORE_TEXT_LENGTH 128
+#define MBIT_MORE_TONE_QUEUE 32
 #else // NOT MICROBIT_CODAL
 #define LIGHT_LEVEL_SAMPLES_SIZE 5
 #define ANALOG_IN_SAMPLES_SIZE 5
+#define MBIT_MORE_FILTER_WINDOW 5
+#define MBIT_MORE_FILTER_STAGES 2
+#define MBIT_MORE_PIN_EVENT_QUEUE 16
+#define MBIT_MORE_ACTION_EVENT_QUEUE 8
+#define MBIT_MORE_FRAME_STORE 8
+#define MBIT_MORE_TEXT_LENGTH 32
+#define MBIT_MORE_TONE_QUEUE 16
 #endif // NOT MICROBIT_CODAL
 
+#define MBIT_MORE_USE_PIN_PORT 1 // 1 for reading levels of the pins from the GPIO ports, 0 for the HAL
+
+/**
+ * @brief Filter of a sensor which the host can configure.
+ */
+typedef MbitMoreFilterChain<MBIT_MORE_FILTER_WINDOW, MBIT_MORE_FILTER_STAGES> MbitMoreSensorFilter;
+
 #if MICROBIT_CODAL
 #define MBIT_MORE_WAITING_DATA_LABELS_LENGTH 16
 #define MBIT_MORE_WAITING_DATA_LABEL_NOT_FOUND 0xff
 #define MBIT_MORE_DATA_LABEL_SIZE 8
 #define MBIT_MORE_DATA_CONTENT_SIZE 11
+#define MBIT_MORE_ACCEL_STREAM_SAMPLES 128
+// Time to wait for a packet of the accelerometer stream to be full [ms]
+#define MBIT_MORE_ACCEL_STREAM_LATENCY 50
 #endif // MICROBIT_CODAL
 
 /**
@@ -71,6 +106,54 @@ enum MbitMoreProtocol
   MBIT_MORE_V2 = 2,
 };
 
+// Time to sleep when no sensor is sampled [ms]
+#define MBIT_MORE_SAMPLER_IDLE 100
+
+// Time to keep sampling an analog input in background after it was read [ms]
+#define MBIT_MORE_ANALOG_IN_ACTIVE 2000
+
+// Event to wake the transmitter when an event is queued
+#define MBIT_MORE_ID_EVENT_QUEUE 9500
+#define MBIT_MORE_EVT_QUEUED 1
+
+// Time to wait for the link to have room for the queued events [ms]
+#define MBIT_MORE_EVENT_RETRY 5
+
+// Event to wake the player of the stored frames and the scrolled text when playback is started
+#define MBIT_MORE_ID_DISPLAY_PLAYER 9501
+#define MBIT_MORE_EVT_DISPLAY_PLAY 1
+
+// Longest time to sleep while the LED is playing, so that a new playback is not kept waiting [ms]
+#define MBIT_MORE_DISPLAY_PLAYER_TICK 20
+
+// Event to wake the player of the queued tones when a note is queued or due
+#define MBIT_MORE_ID_TONE_PLAYER 9502
+#define MBIT_MORE_EVT_TONE_WAKE 1
+
+/**
+ * @brief Last values of the sensors, in the units to be sent.
+ * 
+ */
+typedef struct {
+  uint32_t digitalLevels;      /** levels of GPIO, touch pins and buttons */
+  uint8_t lightLevel;          /** filtered light level */
+  uint8_t temperature;         /** temperature + 128 [degree Celsius] */
+  uint8_t soundLevel;          /** sound level */
+  int16_t pitch;               /** pitch [radians / 1000] */
+  int16_t roll;                /** roll [radians / 1000] */
+  int16_t acceleration[3];     /** acceleration X, Y, Z [milli-g] */
+  int16_t heading;             /** compass heading [degree] */
+  int16_t magneticForce[3];    /** magnetic force X, Y, Z [micro-teslas] */
+} MbitMoreSensorSnapshot;
+
+/**
+ * @brief Rows of the glyph of a character in the system font.
+ *
+ * @param c Character.
+ * @return const uint8_t* Rows of the glyph, or NULL when the font has no glyph.
+ */
+const uint8_t *mbitMoreSystemGlyph(char c);
+
 /**
  * Class definition for main logics of Micribit More Service except bluetooth connectivity.
  *
@@ -156,22 +239,86 @@ public:
   bool touchMode[3] = {false};
 
   /**
-   * @brief Shadow screen to display on the LED.
+   * @brief Levels of the GPIO pins from the port registers, with the pins which are digital inputs.
+   *
+   */
+  MbitMorePinPort<sizeof(gpioPin) / sizeof(gpioPin[0])> pinPort;
+
+  /**
+   * @brief Pin events from the message bus, waiting to be sent.
+   *
+   */
+  MbitMorePinEventQueue<MBIT_MORE_PIN_EVENT_QUEUE> pinEvents;
+
+  /**
+   * @brief Button and gesture events from the message bus, waiting to be sent.
+   *
+   */
+  MbitMoreActionEventQueue<MBIT_MORE_ACTION_EVENT_QUEUE> actionEvents;
+
+  /**
+   * @brief The transmitter of the queued events is running.
    *
    */
-  uint8_t shadowPixcels[5][5] = {{0}};
+  bool transmittingEvents = false;
 
   /**
-   * Samples of Light Level.
+   * @brief Shadow screen to display on the LED, which is the back buffer of the frames.
+   *
+   */
+  MbitMoreDisplayFrame displayFrame;
+
+  /**
+   * @brief Frames which were uploaded to play on the LED.
+   *
+   */
+  MbitMoreFrameStore<MBIT_MORE_FRAME_STORE> frameStore;
+
+  /**
+   * @brief Text which is scrolling on the LED.
+   *
+   */
+  MbitMoreTextScroller<MBIT_MORE_TEXT_LENGTH> textScroller{mbitMoreSystemGlyph};
+
+  /**
+   * @brief Time to shift the text by a column, which is used when text is appended after the scroll ended [ms].
+   *
    */
-  uint8_t lightLevelSamples[LIGHT_LEVEL_SAMPLES_SIZE] = {0};
-  int lightLevelSum = 0;
+  uint16_t textStepTime = 120;
 
   /**
-   * @brief Last index of the Light Level Samples.
+   * @brief The player of the stored frames and the scrolled text is running.
    *
    */
-  size_t lightLevelSamplesLast = 0;
+  bool playerRunning = false;
+
+  /**
+   * @brief Notes which were queued by the host to play.
+   *
+   */
+  MbitMoreToneSequencer<MBIT_MORE_TONE_QUEUE> toneSequencer;
+
+  /**
+   * @brief The player of the queued tones is running.
+   *
+   */
+  bool tonePlayerRunning = false;
+
+  /**
+   * @brief The level of the tone queue has changed and should be reported.
+   *
+   */
+  bool toneReportPending = false;
+
+  /**
+   * Filter of Light Level.
+   */
+  MbitMoreSensorFilter lightLevelFilter;
+
+  /**
+   * Pitch, roll and tilt of the last sample of the accelerometer for the heading.
+   */
+  MbitMoreOrientation orientation;
 
 #if MICROBIT_CODAL
   /**
@@ -192,9 +339,19 @@ public:
 #endif // MICROBIT_CODAL
 
   /**
-   * Samples of Analog In.
+   * Filters of Analog In, which samples are pushed in background.
    */
-  uint16_t analogInSamples[3][ANALOG_IN_SAMPLES_SIZE] = {{0}};
+  MbitMoreSensorFilter analogInFilter[3];
+
+  /**
+   * Time when Analog In was read last [ms].
+   */
+  unsigned long analogInReadTime[3] = {0};
+
+  /**
+   * Whether pin events are listened on Analog In.
+   */
+  bool analogInPinEvent[3] = {false};
 
 #if MICROBIT_CODAL
   /**
@@ -208,6 +365,24 @@ public:
    * 
    */
   float soundLevel = 0.0;
+
+  /**
+   * @brief Samples of the accelerometer to stream.
+   *
+   */
+  MbitMoreSampleStream<MBIT_MORE_ACCEL_STREAM_SAMPLES> accelStream;
+
+  /**
+   * @brief Every sample of the accelerometer is streamed.
+   *
+   */
+  bool accelStreaming = false;
+
+  /**
+   * @brief Max length of a packet of the accelerometer stream.
+   *
+   */
+  size_t accelStreamPacketSize = MM_CH_BUFFER_SIZE_NOTIFY;
 #endif // MICROBIT_CODAL
 
   /**
@@ -215,6 +390,36 @@ public:
    */
   int mbitMoreProtocol;
 
+  /**
+   * @brief Last values of the sensors.
+   *
+   */
+  MbitMoreSensorSnapshot snapshot = {};
+
+  /**
+   * @brief Schedule of sampling the sensors.
+   *
+   */
+  MbitMoreSampleScheduler<MbitMoreSensor::SENSOR_COUNT> sampler;
+
+  /**
+   * @brief The sampling fiber has started.
+   *
+   */
+  bool sampling = false;
+
+  /**
+   * @brief Detector of changes in STATE to notify.
+   *
+   */
+  MbitMoreChangeDetector<MM_CH_BUFFER_SIZE_STATE> stateChange;
+
+  /**
+   * @brief Detector of changes in MOTION to notify.
+   *
+   */
+  MbitMoreChangeDetector<MM_CH_BUFFER_SIZE_MOTION> motionChange;
+
   /**
    * Current mode of all pins.
    */
@@ -226,6 +431,26 @@ public:
    */
   void initializeConfig();
 
+  /**
+   * @brief Make the table to read the GPIO pins from the ports and get the modes of them.
+   *
+   */
+  void initializePinPort();
+
+  /**
+   * @brief Track whether the pin is a digital input after its mode was changed.
+   *
+   * @param pinIndex index in edge pins
+   */
+  void updatePinMode(int pinIndex);
+
+  /**
+   * @brief Read levels of the GPIO pins which are digital inputs.
+   *
+   * @return uint32_t levels in the bits of the edge pin index
+   */
+  uint32_t readPinLevels();
+
   /**
    * @brief Update version data on the charactaristic.
    * 
@@ -277,20 +502,29 @@ public:
   /**
    * @brief Display text on LED.
    *
-   * @param text Contents to display with null termination.
+   * @param text Contents to display, which ends at the length or a null character.
+   * @param length Maximum length of the text.
    * @param delay The time to delay between characters, in milliseconds.
    */
-  void displayText(char *text, int delay);
+  void displayText(const char *text, size_t length, int delay);
 
   /**
-   * @brief Update GPIO and sensors state.
+   * @brief Append text to the scrolling text, or start scrolling it when the scroll has ended.
+   *
+   * @param text Contents to append, which ends at the length or a null character.
+   * @param length Maximum length of the text.
+   */
+  void appendText(const char *text, size_t length);
+
+  /**
+   * @brief Update GPIO and sensors state from the snapshot.
    *
    * @param data Buffer for BLE characteristics.
    */
   void updateState(uint8_t *data);
 
   /**
-   * @brief Update data of motion.
+   * @brief Update data of motion from the snapshot.
    *
    * @param data Buffer for BLE characteristics.
    */
@@ -298,12 +532,187 @@ public:
 
   /**
    * @brief Get data of analog input of the pin.
+   * It is the median of the samples taken in background while the pin is read.
    *
    * @param data Buffer for BLE characteristics.
    * @param pinIndex Index of the pin [0, 1, 2].
    */
   void updateAnalogIn(uint8_t *data, size_t pinIndex);
 
+  /**
+   * @brief Convert analog input of the pin into its samples.
+   *
+   * @param pinIndex Index of the pin [0, 1, 2].
+   * @param count Number of conversions.
+   */
+  void sampleAnalogIn(size_t pinIndex, size_t count);
+
+  /**
+   * @brief Whether Analog In of the pin can be sampled in background.
+   * A conversion releases the pull of the pin, so a pin which is pulled or listened for events
+   * is converted only when it is read.
+   *
+   * @param pinIndex Index of the pin [0, 1, 2].
+   * @return true the pin can be sampled in background
+   */
+  bool isAnalogInSampledInBackground(size_t pinIndex);
+
+  /**
+   * @brief Update the value of the channel by its handler.
+   *
+   * @param channel Channel in the table.
+   * @param data Buffer for the channel.
+   */
+  void updateChannel(const MbitMoreChannel &channel, uint8_t *data);
+
+  /**
+   * @brief Start sampling the sensors in their own period, if not yet.
+   *
+   */
+  void startSampling();
+
+  /**
+   * @brief Sample the sensors whose deadline has come.
+   *
+   */
+  void sampleDueSensors();
+
+  /**
+   * @brief Keep sampling the sensors. It never returns.
+   *
+   */
+  void keepSampling();
+
+  /**
+   * @brief Start playing the stored frames on the LED.
+   *
+   * @param first Index of the first frame.
+   * @param count Number of the frames.
+   * @param loop True to repeat the frames.
+   */
+  void playFrames(int first, int count, bool loop);
+
+  /**
+   * @brief Start the player of the LED, or wake it when it is waiting.
+   *
+   */
+  void wakeDisplayPlayer();
+
+  /**
+   * @brief Keep showing the stored frames and the scrolled text on their time. It never returns.
+   *
+   */
+  void keepPlayingDisplay();
+
+  /**
+   * @brief Start sending the queued events, if not yet.
+   *
+   */
+  void startTransmittingEvents();
+
+  /**
+   * @brief Keep sending the queued events when they come. It never returns.
+   *
+   */
+  void keepTransmittingEvents();
+
+  /**
+   * @brief Notify a packet of events on the link which is connected.
+   *
+   * @param ch Channel of the packet: PIN_EVENT, ACTION_EVENT or ACCEL_STREAM.
+   * @param packet Buffer of the channel which has the packet.
+   * @param length Length of the packet.
+   * @return MbitMoreNotifyResult whether the packet was sent, is not listened to or has no room
+   */
+  MbitMoreNotifyResult notifyEventPacket(uint16_t ch, uint8_t *packet, size_t length);
+
+  /**
+   * @brief Send the queued pin events in packets while the link accepts them.
+   *
+   * @return true all events were sent or discarded, false the link has no room
+   */
+  bool flushPinEvents();
+
+  /**
+   * @brief Send the queued action events in packets while the link accepts them.
+   *
+   * @return true all events were sent or discarded, false the link has no room
+   */
+  bool flushActionEvents();
+
+  /**
+   * @brief Send the level of the tone queue, if it has changed.
+   *
+   * @return true the report was sent, dropped or not needed, false the link has no room
+   */
+  bool flushToneReport();
+
+  /**
+   * @brief Notify a packet of data to the host, sleeping while the serial link has no room.
+   *
+   * @param data Packet of MM_CH_BUFFER_SIZE_NOTIFY.
+   */
+  void notifyDataPacket(uint8_t *data);
+
+  /**
+   * @brief Configure the masks of the action events to send.
+   *
+   * @param data mask of the button events and mask of the gesture events in uint16_t little-endian
+   * @param length length of the data
+   */
+  void configureActionEvents(const uint8_t *data, size_t length);
+
+  /**
+   * @brief Sample the sensor into the snapshot.
+   *
+   * @param sensor Sensor to sample.
+   */
+  void sampleSensor(int sensor);
+
+  /**
+   * @brief Configure the period of sampling a sensor.
+   *
+   * @param data Sensor and the period [ms] in uint16_t little-endian, 0 to stop.
+   * @param length Length of the data.
+   */
+  void configureSampler(const uint8_t *data, size_t length);
+
+  /**
+   * @brief Update statistics of sampling.
+   * Number of samples and average time [us] of each sensor in uint16_t little-endian.
+   *
+   * @param data Buffer for the statistics.
+   */
+  void updateSamplerStats(uint8_t *data);
+
+  /**
+   * @brief Whether to notify the freshly sampled value of the channel.
+   * STATE and MOTION are notified when a field changed beyond the deadband or
+   * the keep-alive interval has passed. The others are notified always.
+   *
+   * @param channel Channel in the table.
+   * @param data Sampled value of the channel.
+   * @return true the value has to be notified
+   */
+  bool shouldNotifyChannel(const MbitMoreChannel &channel, const uint8_t *data);
+
+  /**
+   * @brief Configure notifications on changes.
+   *
+   * @param data Flags of channels to notify only changes, deadband of STATE, deadband of MOTION
+   * in uint16_t little-endian and keep-alive interval [ms] in uint16_t little-endian.
+   * @param length Length of the data.
+   */
+  void configureNotifyOnChange(const uint8_t *data, size_t length);
+
+  /**
+   * @brief Configure the filter of a sensor.
+   *
+   * @param data Target of the filter and pairs of the kind and the parameter of each stage.
+   * @param length Length of the data.
+   */
+  void configureFilter(const uint8_t *data, size_t length);
+
   /**
    * @brief Sample current light level and return filtered value.
    *
@@ -325,6 +734,32 @@ public:
    */
   void stopTone();
 
+  /**
+   * @brief Queue the notes to play after the queued ones.
+   *
+   * @param data Notes of period [us] in uint16_t, volume and duration [ms] in uint16_t little-endian.
+   * @param length Length of the data.
+   */
+  void queueTones(const uint8_t *data, size_t length);
+
+  /**
+   * @brief Remove the queued notes and stop playing tone.
+   *
+   */
+  void clearTones();
+
+  /**
+   * @brief Keep playing the queued notes on their time. It never returns.
+   *
+   */
+  void keepPlayingTones();
+
+  /**
+   * @brief Request to send the level of the tone queue.
+   *
+   */
+  void reportToneQueue();
+
 #if MICROBIT_CODAL
   /**
    * @brief Return index for the label
@@ -384,6 +819,34 @@ public:
    */
   void sendTextWithLabel(const ManagedString &dataLabel, const ManagedString &dataContent);
 
+  /**
+   * @brief Configure streaming of the accelerometer.
+   *
+   * @param data Period of the accelerometer [ms], 0 to stop, and max length of a packet.
+   * @param length Length of the data.
+   */
+  void configureAccelStream(const uint8_t *data, size_t length);
+
+  /**
+   * @brief Stop streaming of the accelerometer and restore its period.
+   *
+   */
+  void stopAccelStream();
+
+  /**
+   * @brief Invoked when the accelerometer has a new sample.
+   *
+   * @param evt event of the update
+   */
+  void onAccelerometerUpdated(MicroBitEvent evt);
+
+  /**
+   * @brief Send the samples of the accelerometer in packets while the link accepts them.
+   * A packet which is not full waits for more samples up to MBIT_MORE_ACCEL_STREAM_LATENCY.
+   *
+   */
+  void flushAccelStream();
+
 #endif // MICROBIT_CODAL
 
   /**
@@ -463,12 +926,12 @@ private:
   void onGestureChanged(MicroBitEvent evt);
 
   /**
-   * @brief Normalize angle when upside down.
-   * 
-   * @param heading value of the compass heading
-   * @return normalizes angle relative to north [degree]
+   * @brief Queue the action event to be sent by the transmitter, if it passes the masks.
+   *
+   * @param action BUTTON or GESTURE
+   * @param evt event of the action
    */
-  int normalizeCompassHeading(int heading);
+  void queueActionEvent(MbitMoreActionEvent action, MicroBitEvent evt);
 
   /**
    * @brief Whether the pin is a GPIO of not.
@@ -0,0 +1,154 @@
+#ifndef MBIT_MORE_DISPLAY_FRAME_H
+#define MBIT_MORE_DISPLAY_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Number of the rows and the columns of the LED.
+ */
+#define MM_DISPLAY_SIZE 5
+
+/**
+ * @brief Number of the pixels of the LED.
+ */
+#define MM_DISPLAY_PIXELS (MM_DISPLAY_SIZE * MM_DISPLAY_SIZE)
+
+/**
+ * @brief Size of a frame of 4-bit brightness: two pixels in a byte.
+ */
+#define MM_DISPLAY_PACKED_4_SIZE ((MM_DISPLAY_PIXELS + 1) / 2)
+
+/**
+ * @brief Size of a frame of 1-bit pixels: eight pixels in a byte.
+ */
+#define MM_DISPLAY_PACKED_1_SIZE ((MM_DISPLAY_PIXELS + 7) / 8)
+
+/**
+ * @brief Unpack a frame of 4-bit brightness.
+ * The pixels are in row-major order and the even pixel is in the low nibble.
+ * A level of 0..15 is scaled to the brightness of 0..255.
+ *
+ * @param packed MM_DISPLAY_PACKED_4_SIZE bytes of the frame
+ * @param pixels MM_DISPLAY_PIXELS of brightness
+ */
+inline void mbitMoreUnpackFrame4(const uint8_t *packed, uint8_t *pixels) {
+  for (size_t i = 0; i < MM_DISPLAY_PIXELS; i++) {
+    uint8_t level = (packed[i / 2] >> ((i % 2) * 4)) & 0x0F;
+    pixels[i] = (uint8_t)(level * 17);
+  }
+}
+
+/**
+ * @brief Unpack a frame of 1-bit pixels.
+ * The pixels are in row-major order from the LSB of the first byte.
+ *
+ * @param packed MM_DISPLAY_PACKED_1_SIZE bytes of the frame
+ * @param brightness brightness of the pixels which are on
+ * @param pixels MM_DISPLAY_PIXELS of brightness
+ */
+inline void mbitMoreUnpackFrame1(const uint8_t *packed, uint8_t brightness, uint8_t *pixels) {
+  for (size_t i = 0; i < MM_DISPLAY_PIXELS; i++) {
+    pixels[i] = ((packed[i / 8] >> (i % 8)) & 1) ? brightness : 0;
+  }
+}
+
+/**
+ * @brief Double buffer of the LED.
+ * Commands write a frame into the back buffer. The frame is shown only when it is complete,
+ * by writing it on the image of the LED in one pass, so that a half of a frame is never on the LED.
+ * The image is the front buffer. Only the pixels which differ from the image are written,
+ * so that pixels drawn by other than this, such as user code, are overwritten when needed.
+ */
+class MbitMoreDisplayFrame {
+public:
+  /**
+   * @brief Set the pattern on a row of the back buffer.
+   *
+   * @param row index of the row
+   * @param pattern brightness(0..255) of the columns
+   */
+  void setRow(size_t row, const uint8_t *pattern) {
+    if (row >= MM_DISPLAY_SIZE)
+      return;
+    memcpy(&back[row * MM_DISPLAY_SIZE], pattern, MM_DISPLAY_SIZE);
+  }
+
+  /**
+   * @brief Set the brightness of all the pixels on the back buffer.
+   *
+   * @param pixels MM_DISPLAY_PIXELS of brightness in row-major order
+   */
+  void setPixels(const uint8_t *pixels) { memcpy(back, pixels, MM_DISPLAY_PIXELS); }
+
+  /**
+   * @brief Set a frame of 4-bit brightness on the back buffer.
+   *
+   * @param packed data of the frame
+   * @param length length of the data
+   * @return true the frame was set, false the data is too short
+   */
+  bool setPacked4(const uint8_t *packed, size_t length) {
+    if (length < MM_DISPLAY_PACKED_4_SIZE)
+      return false;
+    mbitMoreUnpackFrame4(packed, back);
+    return true;
+  }
+
+  /**
+   * @brief Set a frame of 1-bit pixels on the back buffer.
+   * The byte after the frame is the brightness of the pixels which are on, or full brightness without it.
+   *
+   * @param packed data of the frame
+   * @param length length of the data
+   * @return true the frame was set, false the data is too short
+   */
+  bool setPacked1(const uint8_t *packed, size_t length) {
+    if (length < MM_DISPLAY_PACKED_1_SIZE)
+      return false;
+    uint8_t brightness = (length > MM_DISPLAY_PACKED_1_SIZE) ? packed[MM_DISPLAY_PACKED_1_SIZE] : 255;
+    mbitMoreUnpackFrame1(packed, brightness, back);
+    return true;
+  }
+
+  /**
+   * @brief Whether the back buffer is different from the pixels on the LED.
+   *
+   * @tparam Image class of the image which has getPixelValue(x, y)
+   * @param image image on the LED
+   * @return true the frame should be presented
+   */
+  template <typename Image>
+  bool isDirty(Image &image) const {
+    for (size_t i = 0; i < MM_DISPLAY_PIXELS; i++) {
+      if (image.getPixelValue(i % MM_DISPLAY_SIZE, i / MM_DISPLAY_SIZE) != back[i])
+        return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Write the pixels of the back buffer which differ from the image.
+   *
+   * @tparam Image class of the image which has getPixelValue(x, y) and setPixelValue(x, y, value)
+   * @param image image on the LED
+   * @return size_t number of the pixels which were written
+   */
+  template <typename Image>
+  size_t present(Image &image) {
+    size_t writes = 0;
+    for (size_t i = 0; i < MM_DISPLAY_PIXELS; i++) {
+      if (image.getPixelValue(i % MM_DISPLAY_SIZE, i / MM_DISPLAY_SIZE) == back[i])
+        continue;
+      image.setPixelValue(i % MM_DISPLAY_SIZE, i / MM_DISPLAY_SIZE, back[i]);
+      writes++;
+    }
+    return writes;
+  }
+
+private:
+  uint8_t back[MM_DISPLAY_PIXELS] = {0};
+};
+
+#endif // MBIT_MORE_DISPLAY_FRAME_H
@@ -0,0 +1,433 @@
+#ifndef MBIT_MORE_EVENT_QUEUE_H
+#define MBIT_MORE_EVENT_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Length of the header of a packet of pin events: number of events and dropped events in uint16_t little-endian.
+ */
+#define MM_PIN_EVENT_BATCH_HEADER_SIZE 3
+
+/**
+ * @brief Length of a pin event in a packet: pin index, event ID and timestamp in uint32_t little-endian.
+ */
+#define MM_PIN_EVENT_SIZE 6
+
+/**
+ * @brief Length of the header of a packet of action events: number of events and dropped events in uint16_t little-endian.
+ */
+#define MM_ACTION_EVENT_BATCH_HEADER_SIZE 3
+
+/**
+ * @brief Length of an action event in a packet:
+ * action, source component ID, event ID, sequence number of the source and timestamp in uint32_t little-endian.
+ */
+#define MM_ACTION_EVENT_SIZE 8
+
+/**
+ * @brief Action of a button, as BUTTON of MbitMoreActionEvent.
+ */
+#define MM_ACTION_BUTTON 0x01
+
+/**
+ * @brief Action of a gesture, as GESTURE of MbitMoreActionEvent.
+ */
+#define MM_ACTION_GESTURE 0x02
+
+/**
+ * @brief Number of sources which have their own sequence numbers: buttons A and B, touch of P0-P2, logo and gesture.
+ */
+#define MM_ACTION_SOURCE_COUNT 8
+
+/**
+ * @brief Keep the compiler from moving memory accesses across it.
+ */
+#define MM_COMPILER_BARRIER() __asm__ volatile("" ::: "memory")
+
+/**
+ * @brief Queue of events from a single producer to a single consumer, without locks.
+ * The producer only writes the tail and the consumer only writes the head, so that an event handler
+ * can push while the transmitter takes events out. An event which does not fit is counted as dropped.
+ *
+ * @tparam T Type of the events
+ * @tparam N Number of events, a power of 2
+ */
+template <typename T, size_t N>
+class MbitMoreEventQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0 && N <= 0x8000, "N must be a power of 2");
+
+public:
+  /**
+   * @brief Number of events dropped because the queue was full.
+   *
+   */
+  volatile uint32_t dropped = 0;
+
+  /**
+   * @brief Append an event. Called by the producer.
+   *
+   * @param event event to append
+   * @return true the event is queued, false it is dropped
+   */
+  bool push(const T &event) {
+    uint16_t t = tail;
+    if ((uint16_t)(t - head) == N) {
+      dropped = dropped + 1;
+      return false;
+    }
+    events[t & (N - 1)] = event;
+    MM_COMPILER_BARRIER();
+    tail = t + 1;
+    return true;
+  }
+
+  /**
+   * @brief Number of events in the queue.
+   *
+   * @return size_t number of events
+   */
+  size_t size() const { return (uint16_t)(tail - head); }
+
+  /**
+   * @brief Event from the oldest one without removing it. Called by the consumer.
+   *
+   * @param offset offset from the oldest event [0..size())
+   * @return const T& the event
+   */
+  const T &peek(size_t offset) const { return events[(uint16_t)(head + offset) & (N - 1)]; }
+
+  /**
+   * @brief Remove the oldest events. Called by the consumer.
+   *
+   * @param count number of events to remove
+   */
+  void drop(size_t count) {
+    size_t n = size();
+    MM_COMPILER_BARRIER();
+    head = head + (uint16_t)((count < n) ? count : n);
+  }
+
+  /**
+   * @brief Remove all events. Called by the consumer.
+   *
+   */
+  void clear() { drop(size()); }
+
+private:
+  T events[N];
+  volatile uint16_t head = 0;
+  volatile uint16_t tail = 0;
+};
+
+/**
+ * @brief Event of a pin from the message bus.
+ *
+ */
+typedef struct {
+  uint8_t pin;        /** index of the edge pin */
+  uint8_t event;      /** event ID */
+  uint32_t timestamp; /** timestamp of the event, or the width of a pulse */
+} MbitMorePinEventRecord;
+
+/**
+ * @brief Queue of pin events which are sent several in a packet.
+ * A packet of one event has the layout of the PIN_EVENT data: pin index, event ID and timestamp.
+ * A packet of more events starts with the number of events and the dropped events in uint16_t little-endian,
+ * followed by the events in the same layout.
+ *
+ * @tparam N Number of events, a power of 2
+ */
+template <size_t N>
+class MbitMorePinEventQueue : public MbitMoreEventQueue<MbitMorePinEventRecord, N> {
+public:
+  /**
+   * @brief Number of events which fit in a packet of the length.
+   *
+   * @param packetSize max length of a packet
+   * @return size_t number of events
+   */
+  static size_t capacity(size_t packetSize) {
+    if (packetSize < MM_PIN_EVENT_SIZE)
+      return 0;
+    if (packetSize < MM_PIN_EVENT_BATCH_HEADER_SIZE + 2 * MM_PIN_EVENT_SIZE)
+      return 1;
+    return (packetSize - MM_PIN_EVENT_BATCH_HEADER_SIZE) / MM_PIN_EVENT_SIZE;
+  }
+
+  /**
+   * @brief Build a packet of the oldest events without removing them. Call sent() when it has been sent.
+   *
+   * @param packet buffer of the packet
+   * @param packetSize max length of the packet
+   * @return size_t number of events in the packet, 0 when there is no event
+   */
+  size_t pack(uint8_t *packet, size_t packetSize) {
+    size_t n = capacity(packetSize);
+    if (n > this->size())
+      n = this->size();
+    if (n > 0xFF)
+      n = 0xFF;
+    pending = n;
+    if (n == 1) {
+      write(packet, this->peek(0));
+    } else if (n > 1) {
+      uint32_t lost = this->dropped;
+      if (lost > 0xFFFF)
+        lost = 0xFFFF;
+      packet[0] = (uint8_t)n;
+      packet[1] = lost & 0xFF;
+      packet[2] = (lost >> 8) & 0xFF;
+      for (size_t i = 0; i < n; i++) {
+        write(&packet[MM_PIN_EVENT_BATCH_HEADER_SIZE + i * MM_PIN_EVENT_SIZE], this->peek(i));
+      }
+    }
+    return n;
+  }
+
+  /**
+   * @brief Remove the events in the last packet which has been sent.
+   *
+   */
+  void sent() {
+    this->drop(pending);
+    pending = 0;
+  }
+
+private:
+  static void write(uint8_t *data, const MbitMorePinEventRecord &event) {
+    data[0] = event.pin;
+    data[1] = event.event;
+    data[2] = event.timestamp & 0xFF;
+    data[3] = (event.timestamp >> 8) & 0xFF;
+    data[4] = (event.timestamp >> 16) & 0xFF;
+    data[5] = (event.timestamp >> 24) & 0xFF;
+  }
+
+  size_t pending = 0;
+};
+
+/**
+ * @brief Event of a button or a gesture from the message bus.
+ *
+ */
+typedef struct {
+  uint8_t action;     /** BUTTON or GESTURE of MbitMoreActionEvent */
+  uint8_t event;      /** event ID */
+  uint16_t source;    /** component ID which generated the event */
+  uint8_t sequence;   /** sequence number in the events of the source */
+  uint32_t timestamp; /** timestamp of the event */
+} MbitMoreActionEventRecord;
+
+/**
+ * @brief Queue of action events which are numbered for each source and sent several in a packet.
+ * Events can be filtered by masks of the event IDs, so that a host which does not use gestures is not sent them.
+ * A packet of one event has the layout of the ACTION_EVENT data of the action,
+ * and the sequence number at the byte before the data format.
+ * A packet of more events starts with the number of events and the dropped events in uint16_t little-endian,
+ * followed by action, source, event ID, sequence number and timestamp in uint32_t little-endian of each event.
+ * The source is a component ID of the micro:bit runtime, which is less than 256.
+ * Handlers of the events run in fibers, which are cooperative, so that a push is not interrupted by another handler.
+ *
+ * @tparam N Number of events, a power of 2
+ */
+template <size_t N>
+class MbitMoreActionEventQueue : public MbitMoreEventQueue<MbitMoreActionEventRecord, N> {
+public:
+  /**
+   * @brief Events of buttons to queue, bit (ID - 1) for an event ID.
+   *
+   */
+  uint8_t buttonMask = 0xFF;
+
+  /**
+   * @brief Events of gestures to queue, bit (ID - 1) for an event ID.
+   *
+   */
+  uint16_t gestureMask = 0xFFFF;
+
+  /**
+   * @brief Whether the event passes the masks. An event ID out of the masks always passes.
+   *
+   * @param action BUTTON or GESTURE of MbitMoreActionEvent
+   * @param event event ID
+   * @return true the event is queued
+   */
+  bool accepts(uint8_t action, uint8_t event) const {
+    if (event == 0)
+      return true;
+    if (action == MM_ACTION_BUTTON)
+      return (event > 8) || (buttonMask & (1U << (event - 1)));
+    if (action == MM_ACTION_GESTURE)
+      return (event > 16) || (gestureMask & (1U << (event - 1)));
+    return true;
+  }
+
+  /**
+   * @brief Number and append the event if it passes the masks.
+   *
+   * @param action BUTTON or GESTURE of MbitMoreActionEvent
+   * @param source component ID which generated the event
+   * @param event event ID
+   * @param timestamp timestamp of the event
+   * @return true the event is queued, false it is filtered out or dropped
+   */
+  bool push(uint8_t action, uint16_t source, uint8_t event, uint32_t timestamp) {
+    if (!accepts(action, event))
+      return false;
+    MbitMoreActionEventRecord record;
+    record.action = action;
+    record.event = event;
+    record.source = source;
+    record.sequence = nextSequence(source);
+    record.timestamp = timestamp;
+    return MbitMoreEventQueue<MbitMoreActionEventRecord, N>::push(record);
+  }
+
+  /**
+   * @brief Restart the sequence numbers and pass all events.
+   *
+   */
+  void reset() {
+    this->clear();
+    this->dropped = 0;
+    sourceCount = 0;
+    buttonMask = 0xFF;
+    gestureMask = 0xFFFF;
+  }
+
+  /**
+   * @brief Number of events which fit in a packet of the length.
+   *
+   * @param packetSize max length of a packet
+   * @return size_t number of events
+   */
+  static size_t capacity(size_t packetSize) {
+    if (packetSize < MM_ACTION_EVENT_SIZE)
+      return 0;
+    if (packetSize < MM_ACTION_EVENT_BATCH_HEADER_SIZE + 2 * MM_ACTION_EVENT_SIZE)
+      return 1;
+    return (packetSize - MM_ACTION_EVENT_BATCH_HEADER_SIZE) / MM_ACTION_EVENT_SIZE;
+  }
+
+  /**
+   * @brief Build a packet of the oldest events without removing them. Call sent() when it has been sent.
+   *
+   * @param packet buffer of the packet
+   * @param packetSize max length of the packet
+   * @return size_t number of events in the packet, 0 when there is no event
+   */
+  size_t pack(uint8_t *packet, size_t packetSize) {
+    size_t n = capacity(packetSize);
+    if (n > this->size())
+      n = this->size();
+    if (n > 0xFF)
+      n = 0xFF;
+    pending = n;
+    if (n == 1) {
+      const MbitMoreActionEventRecord &record = this->peek(0);
+      packet[0] = record.action;
+      if (record.action == MM_ACTION_BUTTON) {
+        packet[1] = record.source & 0xFF;
+        packet[2] = (record.source >> 8) & 0xFF;
+        packet[3] = record.event;
+        write32(&packet[4], record.timestamp);
+      } else {
+        packet[1] = record.event;
+        write32(&packet[2], record.timestamp);
+      }
+      packet[packetSize - 1] = record.sequence;
+    } else if (n > 1) {
+      uint32_t lost = this->dropped;
+      if (lost > 0xFFFF)
+        lost = 0xFFFF;
+      packet[0] = (uint8_t)n;
+      packet[1] = lost & 0xFF;
+      packet[2] = (lost >> 8) & 0xFF;
+      for (size_t i = 0; i < n; i++) {
+        const MbitMoreActionEventRecord &record = this->peek(i);
+        uint8_t *data = &packet[MM_ACTION_EVENT_BATCH_HEADER_SIZE + i * MM_ACTION_EVENT_SIZE];
+        data[0] = record.action;
+        data[1] = (uint8_t)record.source;
+        data[2] = record.event;
+        data[3] = record.sequence;
+        write32(&data[4], record.timestamp);
+      }
+    }
+    return n;
+  }
+
+  /**
+   * @brief Remove the events in the last packet which has been sent.
+   *
+   */
+  void sent() {
+    this->drop(pending);
+    pending = 0;
+  }
+
+private:
+  static void write32(uint8_t *data, uint32_t value) {
+    data[0] = value & 0xFF;
+    data[1] = (value >> 8) & 0xFF;
+    data[2] = (value >> 16) & 0xFF;
+    data[3] = (value >> 24) & 0xFF;
+  }
+
+  uint8_t nextSequence(uint16_t source) {
+    size_t i = 0;
+    while (i < sourceCount && sources[i] != source)
+      i++;
+    if (i == sourceCount) {
+      if (sourceCount == MM_ACTION_SOURCE_COUNT)
+        return 0; // more sources than expected are not numbered
+      sources[i] = source;
+      sequences[i] = 0;
+      sourceCount++;
+    }
+    return sequences[i]++;
+  }
+
+  uint16_t sources[MM_ACTION_SOURCE_COUNT];
+  uint8_t sequences[MM_ACTION_SOURCE_COUNT];
+  size_t sourceCount = 0;
+  size_t pending = 0;
+};
+
+/**
+ * @brief Result of handing a packet of events to the link.
+ */
+enum MbitMoreNotifyResult
+{
+  MM_NOTIFY_SENT = 0,         // queued to send, or there is no connection
+  MM_NOTIFY_UNSUBSCRIBED = 1, // the host does not listen to the channel
+  MM_NOTIFY_FULL = 2,         // the link has no room for now
+};
+
+/**
+ * @brief Send the queued events in packets while the link takes them.
+ * Events on a channel which the host does not listen to are discarded, so that they do not come stale
+ * when it subscribes again. Events are kept only while the link has no room, until the queue overflows.
+ *
+ * @tparam Queue MbitMorePinEventQueue or MbitMoreActionEventQueue
+ * @tparam Notify function which sends the packet of the number of events and returns MbitMoreNotifyResult
+ * @param queue queue of the events
+ * @param packet buffer of the packet
+ * @param packetSize max length of the packet
+ * @param notify function to send a packet
+ * @return true the queue is empty, false the link has no room
+ */
+template <typename Queue, typename Notify>
+bool mbitMoreFlushEvents(Queue &queue, uint8_t *packet, size_t packetSize, Notify notify) {
+  while (queue.size() > 0) {
+    memset(packet, 0, packetSize);
+    size_t count = queue.pack(packet, packetSize);
+    if (MM_NOTIFY_FULL == notify(count))
+      return false;
+    queue.sent();
+  }
+  return true;
+}
+
+#endif // MBIT_MORE_EVENT_QUEUE_H
@@ -0,0 +1,174 @@
+#ifndef MBIT_MORE_FILTER_H
+#define MBIT_MORE_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "MbitMoreAnalogRing.h"
+
+/**
+ * @brief Largest shift of an exponential moving average, which is the weight 1/256 of a new sample.
+ */
+#define MM_FILTER_EMA_SHIFT_MAX 8
+
+/**
+ * @brief Kind of a stage in a filter chain.
+ *
+ */
+enum MbitMoreFilterKind
+{
+  FILTER_NONE = 0,     // pass through
+  FILTER_MEDIAN = 1,   // median of the last param samples
+  FILTER_BOXCAR = 2,   // average of the last param samples
+  FILTER_EMA = 3,      // exponential moving average with the weight 1/2^param of a new sample
+  FILTER_DEADBAND = 4, // hold the output until the input moves beyond param
+};
+
+/**
+ * @brief Chain of filters which a sample passes through in order.
+ * Each stage keeps its own window, so that the chain does not allocate.
+ * A sample is filtered when it is pushed, and the last output is read without computing.
+ *
+ * @tparam W Max size of the window of a median or boxcar stage
+ * @tparam S Max number of stages
+ */
+template <size_t W, size_t S>
+class MbitMoreFilterChain {
+public:
+  /**
+   * @brief Configure the stages and forget the samples.
+   * The stages are kept when any of them is invalid.
+   *
+   * @param config pairs of the kind and the parameter of each stage
+   * @param length length of the config, up to 2 * S bytes
+   * @return true the stages are configured
+   */
+  bool configure(const uint8_t *config, size_t length) {
+    if (length % 2 != 0 || length > 2 * S)
+      return false;
+    for (size_t i = 0; i < length; i += 2) {
+      if (!isValid(config[i], config[i + 1]))
+        return false;
+    }
+    stageCount = 0;
+    for (size_t i = 0; i < length; i += 2) {
+      if (MbitMoreFilterKind::FILTER_NONE == config[i])
+        continue;
+      Stage &stage = stages[stageCount++];
+      stage.kind = config[i];
+      stage.param = config[i + 1];
+      stage.window.setWindow(config[i + 1]);
+    }
+    reset();
+    return true;
+  }
+
+  /**
+   * @brief Forget the samples.
+   *
+   */
+  void reset() {
+    for (size_t i = 0; i < stageCount; i++) {
+      stages[i].window.clear();
+      stages[i].primed = false;
+    }
+    filtered = false;
+  }
+
+  /**
+   * @brief Number of the stages.
+   *
+   * @return size_t number of the stages
+   */
+  size_t size() const { return stageCount; }
+
+  /**
+   * @brief Whether a sample has been filtered since the last reset.
+   *
+   * @return true value() is valid
+   */
+  bool hasValue() const { return filtered; }
+
+  /**
+   * @brief Output of the last sample.
+   *
+   * @return uint16_t filtered value
+   */
+  uint16_t value() const { return output; }
+
+  /**
+   * @brief Filter a sample through the stages.
+   *
+   * @param sample new sample
+   * @return uint16_t filtered value
+   */
+  uint16_t push(uint16_t sample) {
+    uint16_t x = sample;
+    for (size_t i = 0; i < stageCount; i++) {
+      x = stages[i].filter(x);
+    }
+    output = x;
+    filtered = true;
+    return x;
+  }
+
+private:
+  struct Stage {
+    uint8_t kind = MbitMoreFilterKind::FILTER_NONE;
+    uint8_t param = 0;
+    bool primed = false;
+    uint32_t state = 0; // EMA in 8 bits of fraction, or the output held by the deadband
+    MbitMoreAnalogRing<W> window;
+
+    uint16_t filter(uint16_t x) {
+      switch (kind) {
+      case MbitMoreFilterKind::FILTER_MEDIAN:
+        window.push(x);
+        return window.median();
+      case MbitMoreFilterKind::FILTER_BOXCAR:
+        window.push(x);
+        return (uint16_t)((window.sum() + window.size() / 2) / window.size());
+      case MbitMoreFilterKind::FILTER_EMA:
+        if (!primed) {
+          state = (uint32_t)x << 8;
+          primed = true;
+        } else {
+          state = state + (((int32_t)((uint32_t)x << 8) - (int32_t)state) >> param);
+        }
+        return (uint16_t)((state + 0x80) >> 8);
+      case MbitMoreFilterKind::FILTER_DEADBAND: {
+        int diff = (int)x - (int)state;
+        if (!primed || diff > param || -diff > param) {
+          state = x;
+          primed = true;
+        }
+        return (uint16_t)state;
+      }
+      default:
+        return x;
+      }
+    }
+  };
+
+  static bool isValid(uint8_t kind, uint8_t param) {
+    switch (kind) {
+    case MbitMoreFilterKind::FILTER_NONE:
+    case MbitMoreFilterKind::FILTER_DEADBAND:
+      return true;
+    case MbitMoreFilterKind::FILTER_MEDIAN:
+    case MbitMoreFilterKind::FILTER_BOXCAR:
+      return param >= 1 && param <= W;
+    case MbitMoreFilterKind::FILTER_EMA:
+      return param >= 1 && param <= MM_FILTER_EMA_SHIFT_MAX;
+    default:
+      return false;
+    }
+  }
+
+  Stage stages[S];
+  size_t stageCount = 0;
+  uint16_t output = 0;
+  bool filtered = false;
+};
+
+#endif // MBIT_MORE_FILTER_H
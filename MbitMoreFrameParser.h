@@ -0,0 +1,280 @@
+#ifndef MBIT_MORE_FRAME_PARSER_H
+#define MBIT_MORE_FRAME_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "MbitMoreRingBuffer.h"
+#include "MbitMoreSerialFrame.h"
+
+/**
+ * @brief Incremental parser of request frames from Scratch.
+ * Received bytes stay in a ring buffer and are never moved. Running sums of the bytes are kept
+ * along with them, so checking a candidate frame costs the same whatever its length is.
+ * When a candidate is broken, parsing restarts from the next SFD with the sums kept as they are.
+ * Each byte is searched for SFD once and each SFD is checked once, so parsing is linear in the stream.
+ * In COBS framing, each byte is searched for the delimiter once and the frame before it is decoded once.
+ *
+ * @tparam N Capacity of the receiving buffer in bytes
+ */
+template <size_t N>
+class MbitMoreFrameParser {
+public:
+  /**
+   * @brief Number of broken frames which caused resynchronization.
+   *
+   */
+  uint32_t resyncCount = 0;
+
+  /**
+   * @brief Number of bytes which were discarded as not a part of a frame.
+   *
+   */
+  uint32_t discardedBytes = 0;
+
+  /**
+   * @brief Append received bytes as many as the space allows.
+   *
+   * @param data bytes to append
+   * @param len length of the bytes
+   * @return size_t length appended
+   */
+  size_t push(const uint8_t *data, size_t len) { return rx.push(data, len); }
+
+  /**
+   * @brief Start of the contiguous free region to write received bytes directly.
+   *
+   * @return uint8_t* pointer to write
+   */
+  uint8_t *writePointer() { return rx.writePointer(); }
+
+  /**
+   * @brief Length of the contiguous free region from writePointer().
+   *
+   * @return size_t writable length
+   */
+  size_t writableSize() const { return rx.writableSize(); }
+
+  /**
+   * @brief Mark bytes written from writePointer() as received.
+   *
+   * @param len length written
+   */
+  void commit(size_t len) { rx.commit(len); }
+
+  /**
+   * @brief Number of received bytes which are not taken out as frames yet.
+   *
+   * @return size_t pending length
+   */
+  size_t pendingSize() const { return rx.size(); }
+
+  /**
+   * @brief Change the framing of the following bytes.
+   *
+   * @param mode framing of the link
+   */
+  void setFraming(MbitMoreSerialFraming mode) {
+    framing = mode;
+    state = HUNT_SFD;
+    summed = 0;
+    headBase = 0;
+    scanned = 0;
+    oversized = false;
+  }
+
+  /**
+   * @brief Take out the next complete request frame.
+   *
+   * @param frame Frame to store the request
+   * @return true a frame was taken out
+   * @return false need more bytes to complete a frame
+   */
+  bool next(MbitMoreSerialFrame &frame) {
+    if (MbitMoreSerialFraming::FRAMING_COBS == framing)
+      return nextCobs(frame);
+    updateSums();
+    while (rx.size() > 0) {
+      switch (state) {
+      case HUNT_SFD: {
+        size_t skip = 0;
+        while (skip < rx.size() && MM_SFD != rx.peek(skip)) {
+          skip++;
+        }
+        if (skip > 0) {
+          discard(skip);
+          continue;
+        }
+        state = READ_HEADER;
+        break;
+      }
+      case READ_HEADER: {
+        if (rx.size() < 2)
+          return false;
+        uint8_t requestType = rx.peek(1);
+        if (requestType > ChRequest::REQ_NOTIFY_START) {
+          resync();
+          continue;
+        }
+        if (rx.size() < 4)
+          return false;
+        if (!requestHasPayload(requestType)) {
+          frameSize = 4;
+          complete(frame);
+          return true;
+        }
+        if (rx.size() < 5)
+          return false;
+        uint8_t length = rx.peek(4);
+        if (length > MM_SERIAL_PAYLOAD_MAX) {
+          resync();
+          continue;
+        }
+        frameSize = 5 + length + 1;
+        state = READ_BODY;
+        break;
+      }
+      case READ_BODY:
+        if (rx.size() < frameSize)
+          return false;
+        if (sumOf(frameSize - 1) != rx.peek(frameSize - 1)) {
+          resync();
+          continue;
+        }
+        complete(frame);
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  /**
+   * @brief State of the parser about the frame at the head of received bytes.
+   *
+   */
+  enum ParserState
+  {
+    HUNT_SFD,    // the head may not be SFD
+    READ_HEADER, // the head is SFD and the header is not checked yet
+    READ_BODY,   // the header is valid and frameSize is known
+  };
+
+  MbitMoreRingBuffer<N> rx;
+  MbitMoreSerialFraming framing = MbitMoreSerialFraming::FRAMING_SFD;
+  ParserState state = HUNT_SFD;
+
+  // Number of bytes from the head which are known not to be the delimiter in COBS framing.
+  size_t scanned = 0;
+
+  // The frame before the next delimiter was too long and has been discarded in part.
+  bool oversized = false;
+
+  // Length of the frame at the head in READ_BODY.
+  size_t frameSize = 0;
+
+  // Running sum of bytes modulo 0xFF, at the same position as the byte in the ring buffer.
+  uint8_t sums[N] = {0};
+
+  // Position of the head of the ring buffer in sums.
+  size_t headIndex = 0;
+
+  // Number of bytes from the head which have their running sum.
+  size_t summed = 0;
+
+  // Running sum just before the head.
+  uint8_t headBase = 0;
+
+  static size_t wrap(size_t index) { return (index >= N) ? index - N : index; }
+
+  /**
+   * @brief Extend running sums to the bytes received after the last call.
+   *
+   */
+  void updateSums() {
+    unsigned int sum = (summed == 0) ? headBase : sums[wrap(headIndex + summed - 1)];
+    for (; summed < rx.size(); summed++) {
+      sum += rx.peek(summed);
+      if (sum >= 0xFF)
+        sum -= 0xFF;
+      sums[wrap(headIndex + summed)] = (uint8_t)sum;
+    }
+  }
+
+  /**
+   * @brief Checksum of the bytes from the head.
+   *
+   * @param len length of the bytes
+   * @return uint8_t sum of the bytes modulo 0xFF
+   */
+  uint8_t sumOf(size_t len) const {
+    int sum = (int)sums[wrap(headIndex + len - 1)] - headBase;
+    return (uint8_t)((sum < 0) ? sum + 0xFF : sum);
+  }
+
+  void drop(size_t len) {
+    headBase = sums[wrap(headIndex + len - 1)];
+    headIndex = wrap(headIndex + len);
+    summed -= len;
+    rx.drop(len);
+  }
+
+  void discard(size_t len) {
+    drop(len);
+    discardedBytes += len;
+    state = HUNT_SFD;
+  }
+
+  void resync() {
+    resyncCount++;
+    discard(1);
+  }
+
+  bool nextCobs(MbitMoreSerialFrame &frame) {
+    while (scanned < rx.size()) {
+      if (MM_COBS_DELIMITER != rx.peek(scanned)) {
+        scanned++;
+        if (scanned > MM_SERIAL_COBS_REQUEST_MAX) {
+          // Too long to be a request, discard it up to the delimiter.
+          rx.drop(scanned);
+          discardedBytes += scanned;
+          if (!oversized)
+            resyncCount++;
+          oversized = true;
+          scanned = 0;
+        }
+        continue;
+      }
+      size_t len = scanned;
+      bool valid = false;
+      if (!oversized && len > 0) {
+        uint8_t encoded[MM_SERIAL_COBS_REQUEST_MAX];
+        rx.copyOut(0, encoded, len);
+        valid = decodeRequestCobs(encoded, len, frame) && frame.type <= ChRequest::REQ_NOTIFY_START;
+      }
+      rx.drop(len + 1);
+      scanned = 0;
+      if (valid)
+        return true;
+      if (len > 0 && !oversized)
+        resyncCount++;
+      discardedBytes += (len > 0) ? len + 1 : 0;
+      oversized = false;
+    }
+    return false;
+  }
+
+  void complete(MbitMoreSerialFrame &frame) {
+    frame.type = rx.peek(1);
+    frame.ch = (rx.peek(2) << 8) | rx.peek(3);
+    frame.length = 0;
+    if (frameSize > 4) {
+      frame.length = rx.peek(4);
+      rx.copyOut(5, frame.data, frame.length);
+    }
+    drop(frameSize);
+    state = HUNT_SFD;
+  }
+};
+
+#endif // MBIT_MORE_FRAME_PARSER_H
@@ -0,0 +1,126 @@
+#ifndef MBIT_MORE_FRAME_STORE_H
+#define MBIT_MORE_FRAME_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "MbitMoreDisplayFrame.h"
+
+/**
+ * @brief Frames of the LED which were uploaded once and played on the device.
+ * A frame is kept packed in 4-bit brightness with its duration.
+ * Playback is scheduled on the absolute time of each frame, so that the delay of waking up does not accumulate.
+ *
+ * @tparam N Number of the frames
+ */
+template <size_t N>
+class MbitMoreFrameStore {
+  static_assert(N <= 255, "Index of the frames is uint8_t");
+
+public:
+  /**
+   * @brief Store a frame.
+   *
+   * @param index index of the frame
+   * @param duration time to show the frame [ms], 0 is taken as 1
+   * @param packed frame of 4-bit brightness
+   * @param length length of the frame
+   * @return true the frame was stored, false the index is out of the store or the frame is too short
+   */
+  bool store(size_t index, uint16_t duration, const uint8_t *packed, size_t length) {
+    if (index >= N || length < MM_DISPLAY_PACKED_4_SIZE)
+      return false;
+    memcpy(frames[index].packed, packed, MM_DISPLAY_PACKED_4_SIZE);
+    frames[index].duration = duration ? duration : 1;
+    return true;
+  }
+
+  /**
+   * @brief Start playing the frames. The first frame is due at the time.
+   *
+   * @param first index of the first frame
+   * @param count number of the frames
+   * @param loop true to repeat from the first frame
+   * @param now current time [ms]
+   * @return true started, false the frames are out of the store
+   */
+  bool play(size_t first, size_t count, bool loop, uint32_t now) {
+    if (count == 0 || first >= N || count > N - first)
+      return false;
+    playFirst = (uint8_t)first;
+    playCount = (uint8_t)count;
+    looping = loop;
+    current = -1;
+    due = now;
+    playing = true;
+    return true;
+  }
+
+  /**
+   * @brief Stop playing. The frame which was shown is kept on the LED.
+   */
+  void stop() { playing = false; }
+
+  /**
+   * @brief Whether the frames are playing.
+   *
+   * @return true playing
+   */
+  bool isPlaying() const { return playing; }
+
+  /**
+   * @brief Advance the playback to the time.
+   * When the last frame was over, it returns to the first frame on loop or stops.
+   *
+   * @param now current time [ms]
+   * @param pixels brightness of the pixels of the frame to show
+   * @return true the frame to show was set on the pixels, false no frame is due
+   */
+  bool update(uint32_t now, uint8_t *pixels) {
+    if (!playing || (int32_t)(now - due) < 0)
+      return false;
+    current++;
+    if (current >= playCount) {
+      if (!looping) {
+        playing = false;
+        return false;
+      }
+      current = 0;
+    }
+    const Frame &frame = frames[playFirst + current];
+    due += frame.duration;
+    if ((int32_t)(now - due) > 0) {
+      due = now + frame.duration; // too late to catch up
+    }
+    mbitMoreUnpackFrame4(frame.packed, pixels);
+    return true;
+  }
+
+  /**
+   * @brief Time to wait for the next frame.
+   *
+   * @param now current time [ms]
+   * @return uint32_t time until the next frame [ms], 0 when it is due
+   */
+  uint32_t waitTime(uint32_t now) const {
+    int32_t wait = (int32_t)(due - now);
+    return wait > 0 ? (uint32_t)wait : 0;
+  }
+
+private:
+  struct Frame {
+    uint8_t packed[MM_DISPLAY_PACKED_4_SIZE];
+    uint16_t duration;
+  };
+
+  Frame frames[N] = {};
+  uint32_t due = 0;
+  int current = -1;
+  uint8_t playFirst = 0;
+  uint8_t playCount = 0;
+  bool looping = false;
+  bool playing = false;
+};
+
+#endif // MBIT_MORE_FRAME_STORE_H
@@ -0,0 +1,187 @@
+#ifndef MBIT_MORE_ORIENTATION_H
+#define MBIT_MORE_ORIENTATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Full turn in the binary angle of the fixed-point functions.
+ */
+#define MM_ANGLE_TURN (1L << 24)
+
+/**
+ * @brief Number of CORDIC iterations, which resolves about 0.01 mrad.
+ */
+#define MM_CORDIC_ITERATIONS 20
+
+/**
+ * @brief atan(2^-i) in the binary angle.
+ */
+static const int32_t mbitMoreCordicAtan[MM_CORDIC_ITERATIONS] = {
+    2097152, 1238021, 654136, 332050, 166669, 83416, 41718, 20860, 10430, 5215,
+    2608, 1304, 652, 326, 163, 81, 41, 20, 10, 5};
+
+/**
+ * @brief Reciprocal of the CORDIC gain in 16 bits of fraction.
+ */
+#define MM_CORDIC_GAIN_INVERSE 39797
+
+/**
+ * @brief Angle of the vector by CORDIC in vectoring mode, using only shifts and additions.
+ *
+ * @param y y of the vector
+ * @param x x of the vector
+ * @param magnitude length of the vector, if it is not NULL
+ * @return int32_t angle in (-MM_ANGLE_TURN / 2, MM_ANGLE_TURN / 2], 0 for the zero vector
+ */
+inline int32_t mbitMoreAtan2(int64_t y, int64_t x, uint32_t *magnitude = NULL) {
+  if (x == 0 && y == 0) {
+    if (magnitude != NULL)
+      *magnitude = 0;
+    return 0;
+  }
+  // Scale the vector into [2^26, 2^27) to keep the precision and leave room for the gain.
+  int shift = 0;
+  int64_t largest = (x < 0 ? -x : x) | (y < 0 ? -y : y);
+  while (largest >= (1LL << 27)) {
+    largest >>= 1;
+    shift++;
+  }
+  while (largest < (1LL << 26)) {
+    largest <<= 1;
+    shift--;
+  }
+  int32_t vx = (int32_t)(shift > 0 ? x >> shift : x * (1LL << -shift));
+  int32_t vy = (int32_t)(shift > 0 ? y >> shift : y * (1LL << -shift));
+  // Rotate into the right half-plane.
+  int32_t angle = 0;
+  if (vx < 0) {
+    angle = (vy >= 0) ? MM_ANGLE_TURN / 2 : -MM_ANGLE_TURN / 2;
+    vx = -vx;
+    vy = -vy;
+  }
+  for (int i = 0; i < MM_CORDIC_ITERATIONS; i++) {
+    int32_t dx = vy >> i;
+    int32_t dy = vx >> i;
+    if (vy > 0) {
+      vx += dx;
+      vy -= dy;
+      angle += mbitMoreCordicAtan[i];
+    } else {
+      vx -= dx;
+      vy += dy;
+      angle -= mbitMoreCordicAtan[i];
+    }
+  }
+  if (magnitude != NULL) {
+    int64_t length = ((int64_t)vx * MM_CORDIC_GAIN_INVERSE) >> 16;
+    *magnitude = (uint32_t)(shift > 0 ? length << shift : length >> -shift);
+  }
+  if (angle <= -MM_ANGLE_TURN / 2)
+    angle += MM_ANGLE_TURN;
+  else if (angle > MM_ANGLE_TURN / 2)
+    angle -= MM_ANGLE_TURN;
+  return angle;
+}
+
+/**
+ * @brief Convert the binary angle to milliradians.
+ *
+ * @param angle binary angle
+ * @return int32_t rounded angle [mrad]
+ */
+inline int32_t mbitMoreAngleToMilliradians(int32_t angle) {
+  // 2 pi * 1000 / MM_ANGLE_TURN in 32 bits of fraction.
+  return (int32_t)(((int64_t)angle * 1608495 + (1LL << 31)) >> 32);
+}
+
+/**
+ * @brief Convert the binary angle to degrees in [0, 360).
+ *
+ * @param angle binary angle
+ * @return int rounded angle [degree]
+ */
+inline int mbitMoreAngleToDegrees(int32_t angle) {
+  int degrees = (int)(((int64_t)angle * 360 + MM_ANGLE_TURN / 2) >> 24);
+  if (degrees < 0)
+    degrees += 360;
+  if (degrees >= 360)
+    degrees -= 360;
+  return degrees;
+}
+
+/**
+ * @brief Orientation of the board in fixed-point, which is computed once for each sample of the accelerometer.
+ * Pitch, roll and the tilt of the heading come from the same sample as the acceleration which is reported,
+ * so that they are consistent with each other.
+ * It is in fixed-point because the nRF51 of v1 has no FPU and emulates float trigonometry in software.
+ * A host with an FPU computes the float version faster, so it is not benchmarked there.
+ * Samples are in the frame of getX(), getY() and getZ(): x to the right, y to the logo and z out of the face.
+ * Pitch and roll are the same as getPitchRadians() and getRollRadians() of CODAL:
+ * roll = atan2(x, -z), pitch = atan2(y, sqrt(x^2 + z^2)) extended to +/- pi when the face is down.
+ * Heading is compensated for the tilt by the gravity, without computing sin or cos of the angles.
+ */
+class MbitMoreOrientation {
+public:
+  /**
+   * @brief Compute pitch and roll from a sample of the accelerometer.
+   *
+   * @param x acceleration on x-axis
+   * @param y acceleration on y-axis
+   * @param z acceleration on z-axis
+   */
+  void update(int32_t x, int32_t y, int32_t z) {
+    ax = x;
+    ay = y;
+    az = z;
+    // Magnitudes keep 8 bits of fraction for the precision of small samples.
+    rollAngle = mbitMoreAtan2((int64_t)x * 256, (int64_t)-z * 256, &horizontal);
+    pitchAngle = mbitMoreAtan2((int64_t)y * 256, horizontal, &gravity);
+    if (z > 0) {
+      int32_t reference = (pitchAngle > 0) ? MM_ANGLE_TURN / 4 : -MM_ANGLE_TURN / 4;
+      pitchAngle = reference + (reference - pitchAngle);
+    }
+  }
+
+  /**
+   * @brief Pitch of the last sample.
+   *
+   * @return int16_t pitch [mrad]
+   */
+  int16_t pitch() const { return (int16_t)mbitMoreAngleToMilliradians(pitchAngle); }
+
+  /**
+   * @brief Roll of the last sample.
+   *
+   * @return int16_t roll [mrad]
+   */
+  int16_t roll() const { return (int16_t)mbitMoreAngleToMilliradians(rollAngle); }
+
+  /**
+   * @brief Heading of the magnetic field, compensated for the tilt of the last sample.
+   *
+   * @param mx magnetic field on x-axis
+   * @param my magnetic field on y-axis
+   * @param mz magnetic field on z-axis
+   * @return int heading from the north to the logo [degree], 0 to 359
+   */
+  int heading(int32_t mx, int32_t my, int32_t mz) const {
+    // Field on the horizontal plane, both components scaled by 256 * |g| * sqrt(x^2 + z^2).
+    // x^2 + z^2 is exact because the north is a difference of two close products when the board is tilted.
+    int64_t r2 = (int64_t)ax * ax + (int64_t)az * az;
+    int64_t north = ((int64_t)my * r2 - (int64_t)ay * ((int64_t)mx * ax + (int64_t)mz * az)) * 256;
+    int64_t left = ((int64_t)mx * az - (int64_t)mz * ax) * (int64_t)gravity;
+    return mbitMoreAngleToDegrees(mbitMoreAtan2(left, north));
+  }
+
+private:
+  int32_t ax = 0;
+  int32_t ay = 0;
+  int32_t az = -1;
+  uint32_t horizontal = 256; // sqrt(x^2 + z^2) * 256
+  uint32_t gravity = 256;    // sqrt(x^2 + y^2 + z^2) * 256
+  int32_t rollAngle = 0;
+  int32_t pitchAngle = 0;
+};
+
+#endif // MBIT_MORE_ORIENTATION_H
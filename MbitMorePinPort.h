@@ -0,0 +1,133 @@
+#ifndef MBIT_MORE_PIN_PORT_H
+#define MBIT_MORE_PIN_PORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Number of 32-bit GPIO ports which can be read.
+ */
+#define MM_PIN_PORT_COUNT 2
+
+/**
+ * @brief Reader of the levels of the edge pins from the GPIO port registers.
+ * Levels are read from the IN registers at once and moved to the bits of the edge pin index
+ * with a table of groups which have the same shift, instead of calling the HAL for each pin.
+ * Which pins are digital inputs is tracked in a bitmask, which is updated when the mode of a pin is changed.
+ *
+ * @tparam N Number of pins
+ */
+template <size_t N>
+class MbitMorePinPort {
+public:
+  /**
+   * @brief Make the table from the pins in the ports.
+   *
+   * @param edgeIndex index of the edge pins, less than 32
+   * @param portPin pin in the ports for each edge pin: port * 32 + bit
+   * @return true the table is ready, false a pin is out of the ports and the HAL should be used
+   */
+  bool configure(const uint8_t *edgeIndex, const int *portPin) {
+    groupCount = 0;
+    pinMask = 0;
+    inputMask = 0;
+    ready = false;
+    for (size_t i = 0; i < N; i++) {
+      if (edgeIndex[i] >= 32 || portPin[i] < 0 || portPin[i] >= MM_PIN_PORT_COUNT * 32)
+        return false;
+      uint8_t port = (uint8_t)(portPin[i] / 32);
+      int8_t shift = (int8_t)(edgeIndex[i] - portPin[i] % 32);
+      size_t g = 0;
+      while (g < groupCount && !(groups[g].port == port && groups[g].shift == shift))
+        g++;
+      if (g == groupCount) {
+        groups[g].port = port;
+        groups[g].shift = shift;
+        groups[g].mask = 0;
+        groupCount++;
+      }
+      groups[g].mask |= 1UL << (portPin[i] % 32);
+      pinMask |= 1UL << edgeIndex[i];
+    }
+    ready = true;
+    return true;
+  }
+
+  /**
+   * @brief Whether the levels can be read from the ports.
+   *
+   * @return true the table is ready
+   */
+  bool isReady() const { return ready; }
+
+  /**
+   * @brief Set whether the pin is a digital input of which the level is read.
+   *
+   * @param edgeIndex index of the edge pin
+   * @param input true when the pin is a digital input
+   */
+  void setInput(uint8_t edgeIndex, bool input) {
+    if (edgeIndex >= 32)
+      return;
+    uint32_t bit = (1UL << edgeIndex) & pinMask;
+    inputMask = input ? (inputMask | bit) : (inputMask & ~bit);
+  }
+
+  /**
+   * @brief Pins which are digital inputs.
+   *
+   * @return uint32_t bits in the edge pin index
+   */
+  uint32_t inputs() const { return inputMask; }
+
+  /**
+   * @brief Levels of the digital inputs from the values of the IN registers.
+   *
+   * @param in values of the IN registers of the ports
+   * @return uint32_t levels in the bits of the edge pin index
+   */
+  uint32_t levels(const uint32_t *in) const {
+    uint32_t result = 0;
+    for (size_t g = 0; g < groupCount; g++) {
+      uint32_t bits = in[groups[g].port] & groups[g].mask;
+      result |= (groups[g].shift >= 0) ? (bits << groups[g].shift) : (bits >> -groups[g].shift);
+    }
+    return result & inputMask;
+  }
+
+private:
+  struct Group {
+    uint8_t port;
+    int8_t shift;
+    uint32_t mask;
+  };
+
+  Group groups[N];
+  size_t groupCount = 0;
+  uint32_t pinMask = 0;
+  uint32_t inputMask = 0;
+  bool ready = false;
+};
+
+/**
+ * @brief Levels of the pins read through the HAL, which is the fallback of MbitMorePinPort.
+ *
+ * @tparam Pin class of the pins, which has isDigital(), isInput() and getDigitalValue()
+ * @param pins pins in the edge pin index
+ * @param edgeIndex index of the edge pins to read
+ * @param count number of the edge pins
+ * @return uint32_t levels of the digital inputs in the bits of the edge pin index
+ */
+template <typename Pin>
+uint32_t mbitMoreReadPinLevels(Pin *pins, const uint8_t *edgeIndex, size_t count) {
+  uint32_t levels = 0;
+  for (size_t i = 0; i < count; i++) {
+    Pin &pin = pins[edgeIndex[i]];
+    if (pin.isDigital() && pin.isInput()) {
+      levels |= (uint32_t)(pin.getDigitalValue() != 0) << edgeIndex[i];
+    }
+  }
+  return levels;
+}
+
+#endif // MBIT_MORE_PIN_PORT_H
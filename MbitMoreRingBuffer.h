@@ -0,0 +1,129 @@
+#ifndef MBIT_MORE_RING_BUFFER_H
+#define MBIT_MORE_RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Fixed size ring buffer of bytes.
+ *
+ * @tparam N Capacity of the buffer in bytes
+ */
+template <size_t N>
+class MbitMoreRingBuffer {
+public:
+  /**
+   * @brief Number of bytes stored in the buffer.
+   *
+   * @return size_t stored length
+   */
+  size_t size() const { return count; }
+
+  /**
+   * @brief Number of bytes which can be pushed into the buffer.
+   *
+   * @return size_t free length
+   */
+  size_t space() const { return N - count; }
+
+  /**
+   * @brief Return the byte at the offset from the oldest one without removing it.
+   *
+   * @param offset offset from the oldest byte [0..size())
+   * @return uint8_t the byte at the offset
+   */
+  uint8_t peek(size_t offset) const { return buffer[wrap(head + offset)]; }
+
+  /**
+   * @brief Copy bytes from the oldest one without removing them.
+   *
+   * @param offset offset from the oldest byte
+   * @param dst destination to copy
+   * @param len length to copy
+   */
+  void copyOut(size_t offset, uint8_t *dst, size_t len) const {
+    size_t start = wrap(head + offset);
+    size_t first = (len < N - start) ? len : N - start;
+    memcpy(dst, &buffer[start], first);
+    memcpy(dst + first, buffer, len - first);
+  }
+
+  /**
+   * @brief Remove the oldest bytes.
+   *
+   * @param len length to remove
+   */
+  void drop(size_t len) {
+    if (len >= count) {
+      clear();
+      return;
+    }
+    head = wrap(head + len);
+    count -= len;
+  }
+
+  /**
+   * @brief Append bytes as many as the space allows.
+   *
+   * @param data bytes to append
+   * @param len length of the bytes
+   * @return size_t length appended
+   */
+  size_t push(const uint8_t *data, size_t len) {
+    size_t pushed = 0;
+    while (pushed < len && space() > 0) {
+      size_t chunk = writableSize();
+      if (chunk > len - pushed)
+        chunk = len - pushed;
+      memcpy(writePointer(), data + pushed, chunk);
+      commit(chunk);
+      pushed += chunk;
+    }
+    return pushed;
+  }
+
+  /**
+   * @brief Start of the contiguous free region to write directly.
+   *
+   * @return uint8_t* pointer to write
+   */
+  uint8_t *writePointer() { return &buffer[wrap(head + count)]; }
+
+  /**
+   * @brief Length of the contiguous free region from writePointer().
+   *
+   * @return size_t writable length
+   */
+  size_t writableSize() const {
+    size_t tail = wrap(head + count);
+    if (count == N)
+      return 0;
+    return (tail >= head) ? N - tail : head - tail;
+  }
+
+  /**
+   * @brief Mark bytes written from writePointer() as stored.
+   *
+   * @param len length written
+   */
+  void commit(size_t len) { count += len; }
+
+  /**
+   * @brief Remove all bytes.
+   *
+   */
+  void clear() {
+    head = 0;
+    count = 0;
+  }
+
+private:
+  static size_t wrap(size_t index) { return (index >= N) ? index - N : index; }
+
+  uint8_t buffer[N] = {0};
+  size_t head = 0;
+  size_t count = 0;
+};
+
+#endif // MBIT_MORE_RING_BUFFER_H
@@ -0,0 +1,125 @@
+#ifndef MBIT_MORE_SAMPLE_SCHEDULER_H
+#define MBIT_MORE_SAMPLE_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Shortest period of sampling a sensor [ms].
+ */
+#define MM_SAMPLE_PERIOD_MIN 5
+
+/**
+ * @brief Schedule of sampling sensors, each with its own period.
+ * Deadlines advance by the period from the previous one, so the sampling does not drift.
+ * Deadlines which have passed while the others were being sampled are skipped instead of catching up.
+ * It keeps the number of samples and the moving average of the time spent for them as instrumentation.
+ *
+ * @tparam N Number of sensors
+ */
+template <size_t N>
+class MbitMoreSampleScheduler {
+public:
+  /**
+   * @brief Set the period of sampling the sensor.
+   *
+   * @param sensor index of the sensor
+   * @param period period [ms], 0 to stop sampling
+   * @param now current time [ms]
+   */
+  void setPeriod(size_t sensor, uint16_t period, unsigned long now) {
+    if (period != 0 && period < MM_SAMPLE_PERIOD_MIN)
+      period = MM_SAMPLE_PERIOD_MIN;
+    slots[sensor].period = period;
+    slots[sensor].due = now;
+  }
+
+  /**
+   * @brief Period of sampling the sensor.
+   *
+   * @param sensor index of the sensor
+   * @return uint16_t period [ms], 0 when it is stopped
+   */
+  uint16_t period(size_t sensor) const { return slots[sensor].period; }
+
+  /**
+   * @brief Whether the sensor has to be sampled now.
+   *
+   * @param sensor index of the sensor
+   * @param now current time [ms]
+   * @return true the deadline has come
+   */
+  bool isDue(size_t sensor, unsigned long now) const {
+    return slots[sensor].period != 0 && (long)(now - slots[sensor].due) >= 0;
+  }
+
+  /**
+   * @brief Record a sample of the sensor and advance its deadline.
+   *
+   * @param sensor index of the sensor
+   * @param now time when the sampling started [ms]
+   * @param elapsedUs time spent for the sample [us]
+   */
+  void sampled(size_t sensor, unsigned long now, uint32_t elapsedUs) {
+    Slot &slot = slots[sensor];
+    if (elapsedUs > 0xFFFF)
+      elapsedUs = 0xFFFF;
+    slot.averageUs = (slot.count == 0) ? elapsedUs : (slot.averageUs * 7 + elapsedUs) / 8;
+    slot.count++;
+    if (slot.period == 0)
+      return;
+    slot.due += slot.period;
+    while ((long)(now - slot.due) >= 0) {
+      slot.due += slot.period;
+    }
+  }
+
+  /**
+   * @brief Time until the nearest deadline.
+   *
+   * @param now current time [ms]
+   * @param idle time to return when no sensor is sampled [ms]
+   * @return unsigned long time to sleep [ms], 0 when a sensor is due
+   */
+  unsigned long sleepTime(unsigned long now, unsigned long idle) const {
+    unsigned long wait = idle;
+    for (size_t i = 0; i < N; i++) {
+      if (slots[i].period == 0)
+        continue;
+      long remaining = (long)(slots[i].due - now);
+      if (remaining <= 0)
+        return 0;
+      if ((unsigned long)remaining < wait)
+        wait = remaining;
+    }
+    return wait;
+  }
+
+  /**
+   * @brief Number of samples of the sensor.
+   *
+   * @param sensor index of the sensor
+   * @return uint32_t number of samples
+   */
+  uint32_t count(size_t sensor) const { return slots[sensor].count; }
+
+  /**
+   * @brief Moving average of the time spent for a sample of the sensor.
+   *
+   * @param sensor index of the sensor
+   * @return uint16_t average time [us]
+   */
+  uint16_t averageTime(size_t sensor) const { return slots[sensor].averageUs; }
+
+private:
+  struct Slot {
+    uint16_t period = 0;
+    uint16_t averageUs = 0;
+    unsigned long due = 0;
+    uint32_t count = 0;
+  };
+
+  Slot slots[N];
+};
+
+#endif // MBIT_MORE_SAMPLE_SCHEDULER_H
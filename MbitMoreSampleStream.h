@@ -0,0 +1,169 @@
+#ifndef MBIT_MORE_SAMPLE_STREAM_H
+#define MBIT_MORE_SAMPLE_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Length of the header of a stream packet:
+ * sequence number, number of samples, overflows in uint16_t little-endian
+ * and time of the first sample [ms] in uint16_t little-endian.
+ */
+#define MM_STREAM_HEADER_SIZE 6
+
+/**
+ * @brief Length of a sample in a stream packet:
+ * time since the previous sample [ms] and x, y, z in int16_t little-endian.
+ */
+#define MM_STREAM_SAMPLE_SIZE 7
+
+/**
+ * @brief Stream of 3-axis samples with their time, which are sent in packets of several samples.
+ * Samples are captured into a ring and stay there until a packet of them has been sent,
+ * so that a busy link delays them instead of losing them. A sample which does not fit is counted as an overflow.
+ *
+ * @tparam N Number of samples to buffer
+ */
+template <size_t N>
+class MbitMoreSampleStream {
+public:
+  /**
+   * @brief Number of samples captured since the last reset.
+   *
+   */
+  uint32_t captured = 0;
+
+  /**
+   * @brief Number of samples lost because the ring was full.
+   *
+   */
+  uint32_t overflows = 0;
+
+  /**
+   * @brief Remove all samples and reset the counters.
+   *
+   */
+  void reset() {
+    head = 0;
+    count = 0;
+    pending = 0;
+    sequence = 0;
+    captured = 0;
+    overflows = 0;
+  }
+
+  /**
+   * @brief Capture a sample.
+   *
+   * @param time time of the sample [ms]
+   * @param x value on x-axis
+   * @param y value on y-axis
+   * @param z value on z-axis
+   * @return true the sample is buffered, false it overflowed
+   */
+  bool push(uint32_t time, int16_t x, int16_t y, int16_t z) {
+    if (count == N) {
+      overflows++;
+      return false;
+    }
+    Sample &sample = samples[wrap(head + count)];
+    sample.time = time;
+    sample.axes[0] = x;
+    sample.axes[1] = y;
+    sample.axes[2] = z;
+    count++;
+    captured++;
+    return true;
+  }
+
+  /**
+   * @brief Number of samples buffered.
+   *
+   * @return size_t number of samples
+   */
+  size_t size() const { return count; }
+
+  /**
+   * @brief Time of the oldest sample.
+   *
+   * @return uint32_t time [ms], valid when size() > 0
+   */
+  uint32_t oldestTime() const { return samples[head].time; }
+
+  /**
+   * @brief Number of samples which fit in a packet of the length.
+   *
+   * @param packetSize max length of a packet
+   * @return size_t number of samples
+   */
+  static size_t capacity(size_t packetSize) {
+    return (packetSize < MM_STREAM_HEADER_SIZE + MM_STREAM_SAMPLE_SIZE)
+               ? 0
+               : (packetSize - MM_STREAM_HEADER_SIZE) / MM_STREAM_SAMPLE_SIZE;
+  }
+
+  /**
+   * @brief Build a packet of the oldest samples without removing them. Call sent() when it has been sent.
+   *
+   * @param packet buffer of the packet
+   * @param packetSize max length of the packet
+   * @return size_t length of the packet, 0 when there is no sample
+   */
+  size_t pack(uint8_t *packet, size_t packetSize) {
+    size_t n = capacity(packetSize);
+    if (n > count)
+      n = count;
+    if (n > 0xFF)
+      n = 0xFF;
+    pending = n;
+    if (n == 0)
+      return 0;
+    uint16_t lost = (overflows > 0xFFFF) ? 0xFFFF : (uint16_t)overflows;
+    uint32_t previous = samples[head].time;
+    packet[0] = sequence;
+    packet[1] = (uint8_t)n;
+    packet[2] = lost & 0xFF;
+    packet[3] = lost >> 8;
+    packet[4] = previous & 0xFF;
+    packet[5] = (previous >> 8) & 0xFF;
+    uint8_t *p = &packet[MM_STREAM_HEADER_SIZE];
+    for (size_t i = 0; i < n; i++) {
+      const Sample &sample = samples[wrap(head + i)];
+      uint32_t delta = sample.time - previous;
+      previous = sample.time;
+      *p++ = (delta > 0xFF) ? 0xFF : (uint8_t)delta;
+      for (size_t axis = 0; axis < 3; axis++) {
+        *p++ = (uint16_t)sample.axes[axis] & 0xFF;
+        *p++ = (uint16_t)sample.axes[axis] >> 8;
+      }
+    }
+    return MM_STREAM_HEADER_SIZE + n * MM_STREAM_SAMPLE_SIZE;
+  }
+
+  /**
+   * @brief Remove the samples in the last packet which has been sent.
+   *
+   */
+  void sent() {
+    head = wrap(head + pending);
+    count -= pending;
+    pending = 0;
+    sequence++;
+  }
+
+private:
+  struct Sample {
+    uint32_t time;
+    int16_t axes[3];
+  };
+
+  static size_t wrap(size_t index) { return (index >= N) ? index - N : index; }
+
+  Sample samples[N];
+  size_t head = 0;
+  size_t count = 0;
+  size_t pending = 0;
+  uint8_t sequence = 0;
+};
+
+#endif // MBIT_MORE_SAMPLE_STREAM_H
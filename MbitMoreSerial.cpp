@@ -5,6 +5,22 @@
 
 static MbitMoreSerial *serial; // Hold it as a static pointer to be called by create_fiber().
 
+/**
+ * @brief Subscriptions on connection, same as what the legacy protocol sends.
+ * STATE and MOTION are sent in turn as read responses. The due is the offset from the connection.
+ */
+static const MbitMoreSerialSubscription defaultSubscriptions[MM_SERIAL_SUBSCRIPTION_COUNT] = {
+    {MM_CH_ID_STATE, true, true, ChResponse::RES_READ, MM_SERIAL_NOTIFY_PERIOD_DEFAULT, 0},
+    {MM_CH_ID_MOTION, true, true, ChResponse::RES_READ, MM_SERIAL_NOTIFY_PERIOD_DEFAULT, MM_SERIAL_NOTIFY_PERIOD_DEFAULT / 2},
+    {MM_CH_ID_ANALOG_IN_P0, true, false, ChResponse::RES_NOTIFY, MM_SERIAL_NOTIFY_PERIOD_DEFAULT, 0},
+    {MM_CH_ID_ANALOG_IN_P1, true, false, ChResponse::RES_NOTIFY, MM_SERIAL_NOTIFY_PERIOD_DEFAULT, 0},
+    {MM_CH_ID_ANALOG_IN_P2, true, false, ChResponse::RES_NOTIFY, MM_SERIAL_NOTIFY_PERIOD_DEFAULT, 0},
+    {MM_CH_ID_PIN_EVENT, false, true, ChResponse::RES_NOTIFY, 0, 0},
+    {MM_CH_ID_ACTION_EVENT, false, true, ChResponse::RES_NOTIFY, 0, 0},
+    {MM_CH_ID_DATA, false, true, ChResponse::RES_NOTIFY, 0, 0},
+    {MM_CH_ID_ACCEL_STREAM, false, false, ChResponse::RES_NOTIFY, 0, 0},
+};
+
 /**
  * @brief Start a process to receive data.
  * 
@@ -22,252 +38,551 @@ void startMbitMoreSerialUpdating() {
 }
 
 /**
- * @brief Read one byte from RX. Current fiber sleeps until when received a data.
+ * @brief Start a process to send queued frames.
  * 
- * @return uint8_t Data read from RX
  */
-uint8_t readSync() {
-  fiber_sleep(1); // Need to prevent from freezing
-  return uBit.serial.read(SYNC_SLEEP);
+void startMbitMoreSerialTransmitting() {
+  serial->startSerialTransmitting();
+}
+
+/**
+ * @brief Start a process to fall back the baud rate.
+ * 
+ */
+void startMbitMoreSerialBaudWatchdog() {
+  serial->startBaudWatchdog();
 }
 
 /**
- * @brief Calculate checksum of the data. Sum of the buffer and return the remainder which deviced by 0xFF. 
+ * @brief Baud rates which can be requested by the host.
+ * 
+ */
+static const uint32_t supportedBauds[] = {115200, 230400, 460800, 1000000};
+
+/**
+ * @brief Sleep until the TX buffer gets empty.
+ * The wake up is registered before checking the buffer with IRQ disabled,
+ * so that the event fired by the last byte can not be missed.
  * 
- * @param buff Buffer to be calculate
- * @param len Length of buffer
- * @return uint8_t Number of checksum
  */
-uint8_t chksum8(const uint8_t *buff, size_t len) {
-  unsigned int sum;
-  for (sum = 0; len != 0; len--) {
-    sum += *(buff++);
+static void waitTxEmpty() {
+  target_disable_irq();
+  if (uBit.serial.txBufferedSize() == 0) {
+    target_enable_irq();
+    return;
   }
-  return (uint8_t)(sum % 0xFF);
+  fiber_wake_on_event(DEVICE_ID_NOTIFY, CODAL_SERIAL_EVT_TX_EMPTY);
+  target_enable_irq();
+  schedule();
 }
 
 MbitMoreSerial::MbitMoreSerial(MbitMoreDevice &_mbitMore) : mbitMore(_mbitMore) {
   uBit.log.setSerialMirroring(false); // stop log using serial
   serial = this;
-  // Baud rate
-  // int rate = 57600;
-  int rate = 115200; // Default for micro:bit
-#if MICROBIT_CODAL
-  uBit.serial.setBaud(rate);
-#else
-  uBit.serial.baud((int)rate);
-#endif
+  setBaud(MM_SERIAL_BAUD_DEFAULT);
+  resetSubscriptions();
+  create_fiber(startMbitMoreSerialTransmitting);
   create_fiber(startMbitMoreSerialReceiving);
 }
 
 void MbitMoreSerial::readResponseOnSerial(uint16_t ch, uint8_t *dataBuffer, size_t len) {
-  size_t frameSize = 6 + len;
-  uint8_t frame[frameSize] = {0};
-  frame[0] = MM_SFD;
-  frame[1] = ChResponse::RES_READ;
-  frame[2] = ch >> 8;
-  frame[3] = ch & 0x00FF;
-  frame[4] = len;
-  memcpy(&frame[5], dataBuffer, len);
-  frame[frameSize - 1] = chksum8(frame, frameSize - 1);
-  while ((MM_TX_BUFFER_SIZE - uBit.serial.txBufferedSize()) < (int)frameSize) {
-    fiber_sleep(1);
-  }
-  uBit.serial.send(frame, frameSize, ASYNC);
+  queueFrame(MbitMoreTxPriority::TX_HIGH, ChResponse::RES_READ, ch, dataBuffer, len, true);
 }
 
 void MbitMoreSerial::writeResponseOnSerial(uint16_t ch, bool response) {
-  uint8_t frame[7] = {0};
-  frame[0] = MM_SFD;
-  frame[1] = ChResponse::RES_WRITE;
-  frame[2] = ch >> 8;
-  frame[3] = ch & 0x00FF;
-  frame[4] = 1;
-  frame[5] = 1;
-  frame[6] = chksum8(frame, 6);
-  while ((MM_TX_BUFFER_SIZE - uBit.serial.txBufferedSize()) < 7) {
-    fiber_sleep(1);
-  }
-  uBit.serial.send(frame, 7, SYNC_SLEEP);
-}
-
-void MbitMoreSerial::notifyOnSerial(uint16_t ch, uint8_t *dataBuffer, size_t len) {
-  size_t frameSize = 6 + len;
-  uint8_t frame[frameSize] = {0};
-  frame[0] = MM_SFD;
-  frame[1] = ChResponse::RES_NOTIFY;
-  frame[2] = ch >> 8;
-  frame[3] = ch & 0x00FF;
-  frame[4] = len;
-  memcpy(&frame[5], dataBuffer, len);
-  frame[frameSize - 1] = chksum8(frame, frameSize - 1);
-  while ((MM_TX_BUFFER_SIZE - uBit.serial.txBufferedSize()) < (int)frameSize) {
-    fiber_sleep(1);
-  }
-  uBit.serial.send(frame, frameSize, ASYNC);
+  uint8_t result = 1;
+  queueFrame(MbitMoreTxPriority::TX_HIGH, ChResponse::RES_WRITE, ch, &result, 1, true);
 }
 
-void MbitMoreSerial::startSerialUpdating() {
-  MbitMoreService *moreService = mbitMore.moreService;
-  uint16_t stateCh = 0x0101;
-  uint16_t motionCh = 0x0102;
-  while (true) {
-    if (uBit.serial.txBufferedSize() < 100) {
-      mbitMore.updateState(moreService->stateChBuffer);
-      readResponseOnSerial(stateCh, moreService->stateChBuffer, MM_CH_BUFFER_SIZE_STATE);
-      fiber_sleep(20);
-      mbitMore.updateMotion(moreService->motionChBuffer);
-      readResponseOnSerial(motionCh, moreService->motionChBuffer, MM_CH_BUFFER_SIZE_MOTION);
-      fiber_sleep(20);
+bool MbitMoreSerial::notifyOnSerial(uint16_t ch, uint8_t *dataBuffer, size_t len, bool wait) {
+  if (!isSubscribed(ch)) {
+    return false;
+  }
+  return queueFrame(MbitMoreTxPriority::TX_HIGH, ChResponse::RES_NOTIFY, ch, dataBuffer, len, wait);
+}
+
+MbitMoreTxFrame *MbitMoreSerial::acquireFrame(MbitMoreTxPriority priority, uint16_t ch, bool wait) {
+  while (wait && txQueue.full(priority)) {
+    // Sleep until the transmitting fiber takes out a frame, the TX buffer may be idle.
+    txSlotWaiting = true;
+    fiber_wait_for_event(MBIT_MORE_SERIAL_TX, MBIT_MORE_SERIAL_TX_POPPED);
+  }
+  return txQueue.acquire(priority, ch);
+}
+
+void MbitMoreSerial::commitFrame(MbitMoreTxPriority priority, MbitMoreTxFrame *slot, uint8_t responseType, size_t len) {
+  size_t frameSize = finishResponse(txFraming, slot->bytes, responseType, slot->ch, len);
+  txQueue.commit(priority, slot, frameSize);
+  if (txWaiting) {
+    MicroBitEvent evt(MBIT_MORE_SERIAL_TX, MBIT_MORE_SERIAL_TX_QUEUED);
+  }
+}
+
+bool MbitMoreSerial::queueFrame(MbitMoreTxPriority priority, uint8_t responseType, uint16_t ch,
+                                const uint8_t *dataBuffer, size_t len, bool wait) {
+  if (len > MM_SERIAL_RESPONSE_PAYLOAD_MAX) {
+    txQueue.dropped[priority]++;
+    return false;
+  }
+  MbitMoreTxFrame *slot = acquireFrame(priority, ch, wait);
+  if (slot == NULL) {
+    return false;
+  }
+  memcpy(&slot->bytes[responsePayloadOffset(txFraming)], dataBuffer, len);
+  commitFrame(priority, slot, responseType, len);
+  return true;
+}
+
+bool MbitMoreSerial::queueBatch(MbitMoreTxPriority priority, const uint16_t *channels, size_t count, bool wait) {
+  MbitMoreTxFrame *slot = acquireFrame(priority, 0x0000, wait);
+  if (slot == NULL) {
+    return false;
+  }
+  uint8_t *payload = &slot->bytes[responsePayloadOffset(txFraming)];
+  size_t payloadLen = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint8_t *dataBuffer;
+    size_t len = channelBuffer(channels[i], &dataBuffer);
+    if (len > 0) {
+      payloadLen = appendBatchEntry(payload, payloadLen, channels[i], dataBuffer, len);
     }
   }
+  commitFrame(priority, slot, ChResponse::RES_BATCH, payloadLen);
+  return true;
 }
 
-void MbitMoreSerial::startSerialReceiving() {
-  MbitMoreService *moreService = mbitMore.moreService;
-  int requestType;
-  uint16_t ch;
-  uint8_t *responseBuffer;
+void MbitMoreSerial::updateTxQueueStats(uint8_t *buff) {
+  buff[0] = txQueue.depth(MbitMoreTxPriority::TX_HIGH);
+  buff[1] = txQueue.depth(MbitMoreTxPriority::TX_LOW);
+  buff[2] = txQueue.maxDepth[MbitMoreTxPriority::TX_HIGH];
+  buff[3] = txQueue.maxDepth[MbitMoreTxPriority::TX_LOW];
+  buff[4] = txQueue.dropped[MbitMoreTxPriority::TX_HIGH] & 0xFF;
+  buff[5] = txQueue.dropped[MbitMoreTxPriority::TX_HIGH] >> 8;
+  buff[6] = txQueue.dropped[MbitMoreTxPriority::TX_LOW] & 0xFF;
+  buff[7] = txQueue.dropped[MbitMoreTxPriority::TX_LOW] >> 8;
+  buff[8] = txQueue.replaced & 0xFF;
+  buff[9] = txQueue.replaced >> 8;
+}
 
-  uBit.serial.setTxBufferSize(MM_TX_BUFFER_SIZE);
-  uBit.serial.clearTxBuffer();
-  uBit.serial.setRxBufferSize(MM_RX_BUFFER_SIZE);
-  uBit.serial.clearRxBuffer();
+MbitMoreSerialSubscription *MbitMoreSerial::findSubscription(uint16_t ch) {
+  for (int i = 0; i < MM_SERIAL_SUBSCRIPTION_COUNT; i++) {
+    if (subscriptions[i].ch == ch) {
+      return &subscriptions[i];
+    }
+  }
+  return NULL;
+}
+
+bool MbitMoreSerial::isSubscribed(uint16_t ch) {
+  MbitMoreSerialSubscription *subscription = findSubscription(ch);
+  return (subscription != NULL) && subscription->active;
+}
 
-  uint8_t frame[26] = {0};
-  size_t frameReceived = 0;
+void MbitMoreSerial::resetSubscriptions() {
+  unsigned long now = uBit.systemTime();
+  for (int i = 0; i < MM_SERIAL_SUBSCRIPTION_COUNT; i++) {
+    subscriptions[i] = defaultSubscriptions[i];
+    subscriptions[i].due += now;
+  }
+}
 
-  while (true) {
-    while ((frameReceived > 0) && (MM_SFD != frame[0])) {
-      frameReceived--;
-      memmove(frame, frame + 1, frameReceived);
+void MbitMoreSerial::startNotification(uint16_t ch, const uint8_t *data, size_t len) {
+  MbitMoreSerialSubscription *subscription = findSubscription(ch);
+  if (subscription == NULL) {
+    return;
+  }
+  subscription->active = true;
+  subscription->response = ChResponse::RES_NOTIFY;
+  if (!subscription->periodic) {
+    return;
+  }
+  subscription->batch = (len >= 3) && (data[2] & MM_SERIAL_NOTIFY_BATCH);
+  uint16_t period = MM_SERIAL_NOTIFY_PERIOD_DEFAULT;
+  if (len >= 2) {
+    period = data[0] | (data[1] << 8);
+  }
+  if (period < MM_SERIAL_NOTIFY_PERIOD_MIN) {
+    period = MM_SERIAL_NOTIFY_PERIOD_MIN;
+  }
+  subscription->period = period;
+  subscription->due = uBit.systemTime();
+  subscription->lastSent = 0;
+  subscription->achievedPeriod = 0;
+}
+
+size_t MbitMoreSerial::channelBuffer(uint16_t ch, uint8_t **dataBuffer) {
+  const MbitMoreChannel *channel = findChannel(ch);
+  if (channel == NULL || !(channel->properties & MM_CH_PROP_SAMPLED)) {
+    return 0;
+  }
+  *dataBuffer = mbitMore.moreService->channelBuffer(*channel);
+  return channel->size;
+}
+
+size_t MbitMoreSerial::sampleChannel(uint16_t ch, uint8_t **dataBuffer) {
+  size_t len = channelBuffer(ch, dataBuffer);
+  if (len > 0) {
+    mbitMore.updateChannel(*findChannel(ch), *dataBuffer);
+  }
+  return len;
+}
+
+void MbitMoreSerial::readChannel(const MbitMoreChannel &channel) {
+  if (channel.properties & MM_CH_PROP_SERIAL) {
+    // Statistics are filled without sleeping, so they are written straight into the slot.
+    MbitMoreTxFrame *slot = acquireFrame(MbitMoreTxPriority::TX_HIGH, channel.id, true);
+    if (slot == NULL) {
+      return;
     }
-    if (frameReceived == 0) {
-      frame[0] = readSync();
-      if (MM_SFD != frame[0]) {
-        continue;
-      }
-      frameReceived = 1;
+    uint8_t *value = &slot->bytes[responsePayloadOffset(txFraming)];
+    switch (channel.handler) {
+    case MbitMoreChannelHandler::CH_HANDLER_SERIAL_STATS:
+      updateStats(value);
+      break;
+    case MbitMoreChannelHandler::CH_HANDLER_TX_QUEUE_STATS:
+      updateTxQueueStats(value);
+      break;
+    default:
+      mbitMore.updateChannel(channel, value);
+      break;
+    }
+    commitFrame(MbitMoreTxPriority::TX_HIGH, slot, ChResponse::RES_READ, channel.size);
+    return;
+  }
+  uint8_t *dataBuffer = mbitMore.moreService->channelBuffer(channel);
+  mbitMore.updateChannel(channel, dataBuffer);
+  readResponseOnSerial(channel.id, dataBuffer, channel.size);
+}
+
+void MbitMoreSerial::readBatch(MbitMoreSerialFrame &frame) {
+  uint16_t channels[MM_SERIAL_PAYLOAD_MAX / 2];
+  size_t count = 0;
+  for (size_t i = 0; i + 1 < frame.length; i += 2) {
+    uint8_t *dataBuffer;
+    channels[count] = (frame.data[i] << 8) | frame.data[i + 1];
+    if (sampleChannel(channels[count], &dataBuffer) > 0) {
+      count++;
+    }
+  }
+  // Sampling may sleep, so the frame is built after all of them.
+  queueBatch(MbitMoreTxPriority::TX_HIGH, channels, count, true);
+}
+
+void MbitMoreSerial::advanceDeadline(MbitMoreSerialSubscription &subscription, unsigned long now) {
+  if (subscription.lastSent != 0) {
+    unsigned long interval = now - subscription.lastSent;
+    if (interval > 0xFFFF) {
+      interval = 0xFFFF;
+    }
+    subscription.achievedPeriod = (subscription.achievedPeriod == 0)
+                                      ? interval
+                                      : (subscription.achievedPeriod * 7 + interval) / 8;
+  }
+  subscription.lastSent = now;
+  subscription.due += subscription.period;
+  // Skip the deadlines which have passed instead of sending them in a burst.
+  while ((long)(now - subscription.due) >= 0) {
+    subscription.due += subscription.period;
+  }
+}
+
+void MbitMoreSerial::updateStats(uint8_t *buff) {
+  for (int i = 0; i < MM_SERIAL_STATS_COUNT; i++) {
+    MbitMoreSerialSubscription &subscription = subscriptions[i];
+    uint16_t requested = subscription.active ? subscription.period : 0;
+    uint16_t achieved = subscription.active ? subscription.achievedPeriod : 0;
+    buff[i * 4] = requested & 0xFF;
+    buff[i * 4 + 1] = requested >> 8;
+    buff[i * 4 + 2] = achieved & 0xFF;
+    buff[i * 4 + 3] = achieved >> 8;
+  }
+}
+
+void MbitMoreSerial::setBaud(uint32_t rate) {
+  baud = rate;
+  uBit.serial.setBaud(rate);
+}
+
+void MbitMoreSerial::waitTxSpace(int length, int limit) {
+  int over;
+  while ((over = uBit.serial.txBufferedSize() + length - limit) > 0) {
+    // Wake when the bytes over the limit have been sent, 10 bits each on the line,
+    // so that the UART keeps sending instead of going idle after the whole buffer has drained.
+    // The wake up is registered before the timer is set, so that a short timer can not be missed.
+    fiber_wake_on_event(MBIT_MORE_SERIAL_TX, MBIT_MORE_SERIAL_TX_SPACE);
+    system_timer_event_after_us((CODAL_TIMESTAMP)over * 10 * 1000000 / baud, MBIT_MORE_SERIAL_TX,
+                                MBIT_MORE_SERIAL_TX_SPACE);
+    schedule();
+  }
+}
+
+void MbitMoreSerial::drainTx() {
+  do {
+    while (uBit.serial.txBufferedSize() > 0) {
+      waitTxEmpty();
     }
-    if (frameReceived == 1) {
-      frame[1] = readSync();
-      frameReceived = 2;
+    fiber_sleep(MM_SERIAL_BAUD_SETTLE);
+  } while (uBit.serial.txBufferedSize() > 0);
+}
+
+void MbitMoreSerial::notifyBaud(MbitMoreSerialBaudStatus status, uint32_t rate) {
+  uint8_t data[5];
+  data[0] = status;
+  memcpy(&data[1], &rate, 4);
+  queueFrame(MbitMoreTxPriority::TX_HIGH, ChResponse::RES_NOTIFY, MM_CH_ID_SERIAL_BAUD, data, sizeof(data), true);
+}
+
+void MbitMoreSerial::requestBaud(uint32_t rate) {
+  if (previousBaud != 0 && rate == baud) {
+    // Echo on the new rate
+    previousBaud = 0;
+    notifyBaud(MbitMoreSerialBaudStatus::BAUD_CONFIRMED, rate);
+    return;
+  }
+  bool supported = false;
+  for (size_t i = 0; i < sizeof(supportedBauds) / sizeof(supportedBauds[0]); i++) {
+    if (supportedBauds[i] == rate) {
+      supported = true;
     }
-    requestType = frame[1];
-    if (requestType < 0 || requestType > ChRequest::REQ_NOTIFY_START) {
-      frameReceived--;
-      memmove(frame, frame + 1, frameReceived);
-      continue; // reset frame reading
+  }
+  if (!supported || previousBaud != 0 || nextBaud != 0) {
+    notifyBaud(MbitMoreSerialBaudStatus::BAUD_REJECTED, rate);
+    return;
+  }
+  if (rate == baud) {
+    notifyBaud(MbitMoreSerialBaudStatus::BAUD_CONFIRMED, rate);
+    return;
+  }
+  // The transmitting fiber switches after sending this and the other responses.
+  nextBaud = rate;
+  notifyBaud(MbitMoreSerialBaudStatus::BAUD_ACCEPTED, rate);
+}
+
+void MbitMoreSerial::requestFraming(uint8_t mode) {
+  if (mode <= MbitMoreSerialFraming::FRAMING_COBS) {
+    // The acknowledgement is encoded in the previous framing.
+    uint8_t ack = mode;
+    queueFrame(MbitMoreTxPriority::TX_HIGH, ChResponse::RES_NOTIFY, MM_CH_ID_SERIAL_FRAMING, &ack, 1, true);
+    txFraming = (MbitMoreSerialFraming)mode;
+    rxParser.setFraming(txFraming);
+    return;
+  }
+  uint8_t current = txFraming;
+  queueFrame(MbitMoreTxPriority::TX_HIGH, ChResponse::RES_NOTIFY, MM_CH_ID_SERIAL_FRAMING, &current, 1, true);
+}
+
+void MbitMoreSerial::switchBaud() {
+  drainTx();
+  previousBaud = baud;
+  setBaud(nextBaud);
+  nextBaud = 0;
+  baudSwitches++;
+  create_fiber(startMbitMoreSerialBaudWatchdog);
+}
+
+void MbitMoreSerial::startBaudWatchdog() {
+  uint8_t watching = baudSwitches;
+  fiber_sleep(MM_SERIAL_BAUD_CONFIRM_TIMEOUT);
+  if (watching != baudSwitches || previousBaud == 0) {
+    return;
+  }
+  drainTx();
+  setBaud(previousBaud);
+  previousBaud = 0;
+  notifyBaud(MbitMoreSerialBaudStatus::BAUD_FALLBACK, baud);
+}
+
+void MbitMoreSerial::receiveBulk() {
+  fiber_sleep(1); // Need to prevent from freezing
+  if (uBit.serial.rxBufferedSize() == 0) {
+    int c = uBit.serial.read(SYNC_SLEEP);
+    if (c < 0) {
+      return;
     }
-    if (frameReceived == 2) {
-      frame[2] = readSync();
-      frameReceived = 3;
+    uint8_t received = (uint8_t)c;
+    rxParser.push(&received, 1);
+  }
+  while (rxParser.writableSize() > 0 && uBit.serial.rxBufferedSize() > 0) {
+    int len = uBit.serial.read(rxParser.writePointer(), rxParser.writableSize(), ASYNC);
+    if (len <= 0) {
+      break;
     }
-    if (frameReceived == 3) {
-      frame[3] = readSync();
-      frameReceived = 4;
+    rxParser.commit(len);
+  }
+}
+
+void MbitMoreSerial::acknowledgeCommands(bool idle) {
+  if (!ackTracker.ackDue(idle)) {
+    return;
+  }
+  uint8_t ack[2];
+  ack[0] = ackTracker.lastSequence();
+  ack[1] = ackTracker.flags();
+  queueFrame(MbitMoreTxPriority::TX_HIGH, ChResponse::RES_ACK, MM_CH_ID_COMMAND, ack, sizeof(ack), true);
+  ackTracker.acked();
+}
+
+void MbitMoreSerial::dispatchFrame(MbitMoreSerialFrame &frame) {
+  MbitMoreService *moreService = mbitMore.moreService;
+  int requestType = frame.type;
+  uint16_t ch = frame.ch;
+  uint8_t *responseBuffer;
+
+  // Batch read of sensors
+  if (ChRequest::REQ_READ_BATCH == requestType) {
+    readBatch(frame);
+    return;
+  }
+
+  // Subscriptions
+  if (ChRequest::REQ_NOTIFY_START == requestType) {
+    startNotification(ch, frame.data, frame.length);
+    return;
+  }
+  if (ChRequest::REQ_NOTIFY_STOP == requestType) {
+    MbitMoreSerialSubscription *subscription = findSubscription(ch);
+    if (subscription != NULL) {
+      subscription->active = false;
     }
-    ch = frame[2] << 8;
-    ch |= frame[3];
-    // COMMAND
-    if (0x0100 == ch) {
-      if (ChRequest::REQ_READ == requestType) {
-        // Start connection
-        mbitMore.updateVersionData();
-        responseBuffer = moreService->commandChBuffer;
-        responseBuffer[2] = MbitMoreCommunicationRoute::SERIAL;
-        readResponseOnSerial(ch, responseBuffer, MM_CH_BUFFER_SIZE_COMMAND);
-        if (!mbitMore.serialConnected) {
-          mbitMore.onSerialConnected();
-          create_fiber(startMbitMoreSerialUpdating);
-        }
-        frameReceived = 0; // reset frame reading
-        continue;
-      }
-      if (ChRequest::REQ_WRITE == requestType || ChRequest::REQ_WRITE_RESPONSE == requestType) {
-        if (frameReceived == 4) {
-          frame[4] = readSync();
-          frameReceived = 5;
-        }
-        uint8_t commandLength = frame[4];
-        if (commandLength > 20) {
-          frameReceived--;
-          memmove(frame, frame + 1, frameReceived);
-          continue;
-        }
-        size_t frameSize = 5 + commandLength + 1;
-        for (size_t i = frameReceived; i < frameSize; i++) {
-          frame[i] = readSync();
-          frameReceived = i + 1;
-        }
-        if (chksum8(frame, 5 + commandLength) != frame[frameSize - 1]) {
-          frameReceived--;
-          memmove(frame, frame + 1, frameReceived);
-          continue;
-        }
-        memcpy(moreService->commandChBuffer, &frame[5], commandLength);
-        mbitMore.onCommandReceived(moreService->commandChBuffer, commandLength);
-        if (ChRequest::REQ_WRITE_RESPONSE == requestType) {
-          writeResponseOnSerial(ch, true);
-        }
-        frameReceived = 0; // reset frame reading
-        continue;
+    return;
+  }
+
+  const MbitMoreChannel *channel = findChannel(ch);
+  if (channel == NULL) {
+    return;
+  }
+
+  // COMMAND
+  if (MbitMoreChannelHandler::CH_HANDLER_COMMAND == channel->handler) {
+    if (ChRequest::REQ_READ == requestType) {
+      // Start connection
+      mbitMore.updateVersionData();
+      responseBuffer = moreService->commandChBuffer;
+      responseBuffer[2] = MbitMoreCommunicationRoute::SERIAL;
+      readResponseOnSerial(ch, responseBuffer, MM_CH_BUFFER_SIZE_COMMAND);
+      resetSubscriptions();
+      ackTracker.reset();
+      if (!mbitMore.serialConnected) {
+        mbitMore.onSerialConnected();
+        create_fiber(startMbitMoreSerialUpdating);
       }
+      return;
     }
-
-    // State
-    if (0x0101 == ch) {
-      if (ChRequest::REQ_READ == requestType) {
-        mbitMore.updateState(moreService->stateChBuffer);
-        readResponseOnSerial(0x0101, moreService->stateChBuffer, MM_CH_BUFFER_SIZE_STATE);
-        frameReceived = 0; // reset frame reading
-        continue;
+    if (ChRequest::REQ_WRITE_SEQUENCED == requestType) {
+      if (frame.length < 2 || !ackTracker.receive(frame.data[0])) {
+        return;
       }
+      memcpy(moreService->commandChBuffer, &frame.data[1], frame.length - 1);
+      mbitMore.onCommandReceived(moreService->commandChBuffer, frame.length - 1);
+      return;
     }
-
-    // Motion
-    if (0x0102 == ch) {
-      if (ChRequest::REQ_READ == requestType) {
-        mbitMore.updateMotion(moreService->motionChBuffer);
-        readResponseOnSerial(0x0102, moreService->motionChBuffer, MM_CH_BUFFER_SIZE_MOTION);
-        frameReceived = 0; // reset frame reading
-        continue;
+    if (frame.length > MM_CH_BUFFER_SIZE_COMMAND) {
+      return;
+    }
+    if (ChRequest::REQ_WRITE == requestType || ChRequest::REQ_WRITE_RESPONSE == requestType) {
+      memcpy(moreService->commandChBuffer, frame.data, frame.length);
+      mbitMore.onCommandReceived(moreService->commandChBuffer, frame.length);
+      if (ChRequest::REQ_WRITE_RESPONSE == requestType) {
+        writeResponseOnSerial(ch, true);
       }
+      return;
     }
+  }
+
+  // Sensors, events and statistics
+  if (ChRequest::REQ_READ == requestType && (channel->properties & MM_CH_PROP_READ)) {
+    readChannel(*channel);
+  }
+}
 
-    // ANALOG_IN_P0
-    if (0x0120 == ch) {
-      if (ChRequest::REQ_READ == requestType) {
-        mbitMore.updateAnalogIn(moreService->analogInP0ChBuffer, 0);
-        readResponseOnSerial(ch, moreService->analogInP0ChBuffer, MM_CH_BUFFER_SIZE_ANALOG_IN);
-        frameReceived = 0; // reset frame reading
+void MbitMoreSerial::startSerialUpdating() {
+  while (true) {
+    waitTxSpace(1, MM_SERIAL_UPDATE_TX_LIMIT);
+    unsigned long now = uBit.systemTime();
+    uint16_t batch[MM_SERIAL_STATS_COUNT];
+    size_t batchCount = 0;
+    for (int i = 0; i < MM_SERIAL_SUBSCRIPTION_COUNT; i++) {
+      MbitMoreSerialSubscription &subscription = subscriptions[i];
+      if (!subscription.active || !subscription.periodic || (long)(now - subscription.due) < 0) {
         continue;
       }
+      uint8_t *dataBuffer;
+      size_t len = sampleChannel(subscription.ch, &dataBuffer);
+      if (subscription.batch) {
+        // Characteristics due at the same time go in one frame as a snapshot.
+        batch[batchCount++] = subscription.ch;
+      } else if (ChResponse::RES_READ == subscription.response ||
+                 mbitMore.shouldNotifyChannel(*findChannel(subscription.ch), dataBuffer)) {
+        // Legacy read responses are sent always, notifications only on changes.
+        queueFrame(MbitMoreTxPriority::TX_LOW, subscription.response, subscription.ch, dataBuffer, len, false);
+      }
+      advanceDeadline(subscription, now);
     }
-
-    // ANALOG_IN_P1
-    if (0x0121 == ch) {
-      if (ChRequest::REQ_READ == requestType) {
-        mbitMore.updateAnalogIn(moreService->analogInP1ChBuffer, 1);
-        readResponseOnSerial(ch, moreService->analogInP1ChBuffer, MM_CH_BUFFER_SIZE_ANALOG_IN);
-        frameReceived = 0; // reset frame reading
+    if (batchCount > 0) {
+      queueBatch(MbitMoreTxPriority::TX_LOW, batch, batchCount, false);
+    }
+    // Sleep until the nearest deadline.
+    now = uBit.systemTime();
+    unsigned long wait = MM_SERIAL_UPDATE_IDLE;
+    for (int i = 0; i < MM_SERIAL_SUBSCRIPTION_COUNT; i++) {
+      MbitMoreSerialSubscription &subscription = subscriptions[i];
+      if (!subscription.active || !subscription.periodic) {
         continue;
       }
+      long remaining = (long)(subscription.due - now);
+      if (remaining < (long)wait) {
+        wait = (remaining > 0) ? remaining : 1;
+      }
     }
+    fiber_sleep(wait);
+  }
+}
 
-    // ANALOG_IN_P2
-    if (0x0122 == ch) {
-      if (ChRequest::REQ_READ == requestType) {
-        mbitMore.updateAnalogIn(moreService->analogInP2ChBuffer, 2);
-        readResponseOnSerial(ch, moreService->analogInP2ChBuffer, MM_CH_BUFFER_SIZE_ANALOG_IN);
-        frameReceived = 0; // reset frame reading
-        continue;
-      }
+void MbitMoreSerial::startSerialTransmitting() {
+  while (true) {
+    if (nextBaud != 0 && (txQueue.empty() || MbitMoreTxPriority::TX_LOW == txQueue.frontPriority())) {
+      // All responses before the acknowledgement have been sent on the current rate.
+      switchBaud();
+      continue;
+    }
+    if (txQueue.empty()) {
+      txWaiting = true;
+      fiber_wait_for_event(MBIT_MORE_SERIAL_TX, MBIT_MORE_SERIAL_TX_QUEUED);
+      txWaiting = false;
+      continue;
+    }
+    // Periodic data leaves room in the TX buffer so that events can go ahead of them.
+    int limit = (MbitMoreTxPriority::TX_HIGH == txQueue.frontPriority()) ? MM_TX_BUFFER_SIZE : MM_SERIAL_UPDATE_TX_LIMIT;
+    const MbitMoreTxFrame &frame = txQueue.front();
+    if (uBit.serial.txBufferedSize() + frame.length > limit) {
+      waitTxSpace(frame.length, limit);
+      continue;
     }
+    uBit.serial.send((uint8_t *)frame.bytes, frame.length, ASYNC);
+    txQueue.pop();
+    if (txSlotWaiting) {
+      txSlotWaiting = false;
+      MicroBitEvent evt(MBIT_MORE_SERIAL_TX, MBIT_MORE_SERIAL_TX_POPPED);
+    }
+  }
+}
 
-    // Not matched
-    frameReceived--;
-    memmove(frame, frame + 1, frameReceived);
+void MbitMoreSerial::startSerialReceiving() {
+  uBit.serial.setTxBufferSize(MM_TX_BUFFER_SIZE);
+  uBit.serial.clearTxBuffer();
+  uBit.serial.setRxBufferSize(MM_RX_BUFFER_SIZE);
+  uBit.serial.clearRxBuffer();
+
+  MbitMoreSerialFrame frame;
+  while (true) {
+    receiveBulk();
+    // Process all complete frames in the received bytes.
+    while (rxParser.next(frame)) {
+      dispatchFrame(frame);
+      acknowledgeCommands(false);
+    }
+    // Acknowledge the rest of a burst of commands.
+    acknowledgeCommands(true);
   }
 }
 
@@ -5,11 +5,105 @@
 #define MBIT_MORE_SERIAL_H
 
 #include "MbitMoreDevice.h"
+#include "MbitMoreAckTracker.h"
+#include "MbitMoreFrameParser.h"
+#include "MbitMoreTxQueue.h"
 
-#define MM_SFD 0xff
 #define MM_RX_BUFFER_SIZE 254
 #define MM_TX_BUFFER_SIZE 254
 
+/**
+ * @brief Number of characteristics which can be subscribed over serial.
+ * STATE, MOTION, ANALOG_IN_P0-P2, PIN_EVENT, ACTION_EVENT, DATA and ACCEL_STREAM.
+ */
+#define MM_SERIAL_SUBSCRIPTION_COUNT 9
+
+// Period of STATE and MOTION which are sent without subscription [ms]
+#define MM_SERIAL_NOTIFY_PERIOD_DEFAULT 40
+
+// Flag of REQ_NOTIFY_START to send the characteristic in batch responses
+#define MM_SERIAL_NOTIFY_BATCH 0x01
+
+// Shortest period which can be requested [ms]
+#define MM_SERIAL_NOTIFY_PERIOD_MIN 10
+
+// Sleep of the updating fiber while nothing is subscribed [ms]
+#define MM_SERIAL_UPDATE_IDLE 20
+
+// Periodic data waits while the TX buffer holds this or more, to leave room for events [bytes]
+#define MM_SERIAL_UPDATE_TX_LIMIT 100
+
+// Number of periodic characteristics reported in the serial statistics
+#define MM_SERIAL_STATS_COUNT 5
+
+// Slots of the TX queue for events and responses
+#define MM_SERIAL_TX_HIGH_SLOTS 8
+
+// Slots of the TX queue for periodic data, one for each periodic characteristic
+#define MM_SERIAL_TX_LOW_SLOTS MM_SERIAL_STATS_COUNT
+
+// Baud rate on start up, default of micro:bit
+#define MM_SERIAL_BAUD_DEFAULT 115200
+
+// Time to wait for the echo of a new baud rate before falling back [ms]
+#define MM_SERIAL_BAUD_CONFIRM_TIMEOUT 1000
+
+// Time for the last byte to leave the UART after the TX buffer got empty [ms]
+#define MM_SERIAL_BAUD_SETTLE 2
+
+/**
+ * @brief Status of the baud rate negotiation notified on 0x0142 with the rate.
+ * 
+ */
+enum MbitMoreSerialBaudStatus
+{
+  BAUD_ACCEPTED = 0x01,  // switch after this notification and wait for the echo
+  BAUD_REJECTED = 0x02,  // not supported or another negotiation is in progress
+  BAUD_CONFIRMED = 0x03, // the echo was received on the rate
+  BAUD_FALLBACK = 0x04,  // no echo, returned to the rate
+};
+
+// Sequenced commands to execute before acknowledging them
+#define MM_SERIAL_ACK_BATCH 4
+
+/**
+ * @brief Bound of the buffers on a fiber stack in the serial path [bytes].
+ * Frames are built in the slots of the TX queue, so only a request and small payloads are on the stack.
+ * Codal copies the used stack of a fiber to the heap while it sleeps.
+ */
+#define MM_SERIAL_STACK_BUFFER_MAX 64
+
+static_assert(sizeof(MbitMoreSerialFrame) + MM_SERIAL_COBS_REQUEST_MAX <= MM_SERIAL_STACK_BUFFER_MAX,
+              "a request and its COBS decoding buffer on the receiving fiber");
+static_assert(sizeof(MbitMoreSerialFrame) + sizeof(uint16_t) * (MM_SERIAL_PAYLOAD_MAX / 2) <= MM_SERIAL_STACK_BUFFER_MAX,
+              "a request and its characteristics in a batch read");
+static_assert(serialChannelSizeMax() <= MM_SERIAL_RESPONSE_PAYLOAD_MAX,
+              "values of the serial channels are built in a slot");
+static_assert(MM_SERIAL_STATS_COUNT * 4 == MM_CH_BUFFER_SIZE_SERIAL_STATS,
+              "periods of the periodic characteristics");
+
+// Event to wake the transmitting fiber
+#define MBIT_MORE_SERIAL_TX 8001
+#define MBIT_MORE_SERIAL_TX_QUEUED 1
+#define MBIT_MORE_SERIAL_TX_POPPED 2
+#define MBIT_MORE_SERIAL_TX_SPACE 3
+
+/**
+ * @brief Notifications of a characteristic over serial.
+ *
+ */
+typedef struct {
+  uint16_t ch;       /** characteristic to notify */
+  bool periodic;     /** sampled on the period, otherwise sent on events */
+  bool active;       /** notifications are started */
+  uint8_t response;  /** response type to send the data */
+  uint16_t period;   /** period of notifications [ms] */
+  unsigned long due; /** system time to send the next notification [ms] */
+  unsigned long lastSent; /** system time when the last notification was sent [ms] */
+  uint16_t achievedPeriod; /** moving average of the actual period [ms] */
+  bool batch;        /** sent in a batch response with the others due at the same time */
+} MbitMoreSerialSubscription;
+
 // // Forward declaration
 class MbitMoreDevice;
 
@@ -30,28 +124,254 @@ private:
   };
 
   /**
-   * @brief Request type from Scratch
+   * @brief Parser of bytes received from Scratch.
    * 
    */
-  enum ChRequest
-  {
-    REQ_READ = 0x01,
-    REQ_WRITE = 0x10,
-    REQ_WRITE_RESPONSE = 0x11,
-    REQ_NOTIFY_STOP = 0x20,
-    REQ_NOTIFY_START = 0x21,
-  };
+  MbitMoreFrameParser<MM_RX_BUFFER_SIZE> rxParser;
 
   /**
-   * @brief Response type to Scratch
+   * @brief Move all bytes in the RX buffer of the serial port to the parser.
+   * Current fiber sleeps until when at least one byte is received.
    * 
    */
-  enum ChResponse
-  {
-    RES_READ = 0x01,
-    RES_WRITE = 0x11,
-    RES_NOTIFY = 0x21,
-  };
+  void receiveBulk();
+
+  /**
+   * @brief Sequence of the commands written with REQ_WRITE_SEQUENCED.
+   * 
+   */
+  MbitMoreAckTracker<MM_SERIAL_ACK_BATCH> ackTracker;
+
+  /**
+   * @brief Send an acknowledgement of the sequenced commands when it is due.
+   * 
+   * @param idle No more request is waiting to be processed
+   */
+  void acknowledgeCommands(bool idle);
+
+  /**
+   * @brief Process a request from Scratch.
+   * 
+   * @param frame Request frame to process
+   */
+  void dispatchFrame(MbitMoreSerialFrame &frame);
+
+  /**
+   * @brief Notifications of each characteristic.
+   * 
+   */
+  MbitMoreSerialSubscription subscriptions[MM_SERIAL_SUBSCRIPTION_COUNT];
+
+  /**
+   * @brief Find the subscription of the characteristic.
+   * 
+   * @param ch Characteristic to find
+   * @return MbitMoreSerialSubscription* subscription or NULL when the characteristic can not notify
+   */
+  MbitMoreSerialSubscription *findSubscription(uint16_t ch);
+
+  /**
+   * @brief Set subscriptions as the legacy protocol: STATE and MOTION in turn and all events.
+   * 
+   */
+  void resetSubscriptions();
+
+  /**
+   * @brief Start notifications of the characteristic by the request.
+   * 
+   * @param ch Characteristic to notify
+   * @param data Payload of the request: period [ms] in uint16 little endian and optional flags
+   * @param len Length of the payload
+   */
+  void startNotification(uint16_t ch, const uint8_t *data, size_t len);
+
+  /**
+   * @brief Buffer of a sensor characteristic which holds the last sampled data.
+   * 
+   * @param ch Characteristic of the buffer
+   * @param dataBuffer Set to the buffer
+   * @return size_t length of the data, 0 when the characteristic is not a sensor
+   */
+  size_t channelBuffer(uint16_t ch, uint8_t **dataBuffer);
+
+  /**
+   * @brief Sample the data of a sensor characteristic.
+   * 
+   * @param ch Characteristic to sample
+   * @param dataBuffer Set to the buffer which holds the data
+   * @return size_t length of the data, 0 when the characteristic is not a sensor
+   */
+  size_t sampleChannel(uint16_t ch, uint8_t **dataBuffer);
+
+  /**
+   * @brief Respond to a batch read with the data of the requested characteristics.
+   * 
+   * @param frame Request with the list of characteristics
+   */
+  void readBatch(MbitMoreSerialFrame &frame);
+
+  /**
+   * @brief Respond to a read with the current value of the channel.
+   * 
+   * @param channel Readable channel in the table
+   */
+  void readChannel(const MbitMoreChannel &channel);
+
+  /**
+   * @brief Move the deadline of the subscription to the next period after now.
+   * The deadline advances by whole periods so that the timing does not drift.
+   * 
+   * @param subscription Subscription which was sent
+   * @param now Current system time [ms]
+   */
+  void advanceDeadline(MbitMoreSerialSubscription &subscription, unsigned long now);
+
+  /**
+   * @brief Fill the requested and achieved periods of the periodic characteristics.
+   * Requested period [ms] and achieved period [ms] in uint16 little endian
+   * for STATE, MOTION and ANALOG_IN_P0-P2 in this order. Both are 0 when not subscribed.
+   * 
+   * @param buff Buffer to fill, 4 bytes for each periodic characteristic
+   */
+  void updateStats(uint8_t *buff);
+
+  /**
+   * @brief Frames waiting to be sent.
+   * 
+   */
+  MbitMoreTxQueue<MM_SERIAL_TX_HIGH_SLOTS, MM_SERIAL_TX_LOW_SLOTS> txQueue;
+
+  /**
+   * @brief Whether the transmitting fiber is waiting for a frame to be queued.
+   * 
+   */
+  bool txWaiting = false;
+
+  /**
+   * @brief Whether a fiber is waiting for a slot of the TX queue to be freed.
+   * 
+   */
+  bool txSlotWaiting = false;
+
+  /**
+   * @brief Take a slot of the TX queue to build a response in place.
+   * Nothing which may sleep is allowed until commitFrame().
+   * 
+   * @param priority Priority of the frame
+   * @param ch Characteristic of the response
+   * @param wait Sleep while the slots are full instead of dropping the frame
+   * @return MbitMoreTxFrame* slot to write the payload at responsePayloadOffset(), NULL when dropped
+   */
+  MbitMoreTxFrame *acquireFrame(MbitMoreTxPriority priority, uint16_t ch, bool wait);
+
+  /**
+   * @brief Encode the response built in the slot and queue it to send.
+   * 
+   * @param priority Priority of the frame
+   * @param slot Slot returned by acquireFrame()
+   * @param responseType Type of the response
+   * @param len Length of the payload
+   */
+  void commitFrame(MbitMoreTxPriority priority, MbitMoreTxFrame *slot, uint8_t responseType, size_t len);
+
+  /**
+   * @brief Queue a batch response of sensor characteristics which have been sampled.
+   * 
+   * @param priority Priority of the frame
+   * @param channels Characteristics to put in the batch
+   * @param count Number of the characteristics
+   * @param wait Sleep while the slots are full instead of dropping the frame
+   * @return true the frame was queued
+   */
+  bool queueBatch(MbitMoreTxPriority priority, const uint16_t *channels, size_t count, bool wait);
+
+  /**
+   * @brief Encode a response and queue it to send.
+   * 
+   * @param priority Priority of the frame
+   * @param responseType Type of the response
+   * @param ch Characteristic of the response
+   * @param dataBuffer Payload of the response
+   * @param len Length of the payload
+   * @param wait Sleep while the slots are full instead of dropping the frame
+   * @return true the frame was queued, false dropped because the slots are full or the payload is too long
+   */
+  bool queueFrame(MbitMoreTxPriority priority, uint8_t responseType, uint16_t ch,
+                  const uint8_t *dataBuffer, size_t len, bool wait);
+
+  /**
+   * @brief Fill the statistics of the TX queue.
+   * Depth of high and low priority, max depth of high and low priority,
+   * dropped frames of high and low priority and replaced frames in uint16 little endian.
+   * 
+   * @param buff Buffer to fill, 10 bytes
+   */
+  void updateTxQueueStats(uint8_t *buff);
+
+  /**
+   * @brief Current baud rate of the serial port.
+   * 
+   */
+  uint32_t baud = MM_SERIAL_BAUD_DEFAULT;
+
+  /**
+   * @brief Accepted baud rate to switch after sending the queued responses, 0 for none.
+   * 
+   */
+  uint32_t nextBaud = 0;
+
+  /**
+   * @brief Baud rate to fall back while waiting for the echo, 0 for none.
+   * 
+   */
+  uint32_t previousBaud = 0;
+
+  /**
+   * @brief Number of baud rate switches to tell the watchdog of the current one.
+   * 
+   */
+  uint8_t baudSwitches = 0;
+
+  /**
+   * @brief Framing of the frames to send.
+   * 
+   */
+  MbitMoreSerialFraming txFraming = MbitMoreSerialFraming::FRAMING_SFD;
+
+  /**
+   * @brief Set the baud rate of the serial port.
+   * 
+   * @param rate Baud rate
+   */
+  void setBaud(uint32_t rate);
+
+  /**
+   * @brief Sleep until the TX buffer has room for the bytes under the limit.
+   * 
+   * @param length Number of the bytes to put
+   * @param limit Max number of the bytes in the TX buffer
+   */
+  void waitTxSpace(int length, int limit);
+
+  /**
+   * @brief Sleep until all bytes in the TX buffer have left the UART.
+   * 
+   */
+  void drainTx();
+
+  /**
+   * @brief Switch to the accepted baud rate and start waiting for the echo.
+   * 
+   */
+  void switchBaud();
+
+  /**
+   * @brief Notify the status of the baud rate negotiation.
+   * 
+   * @param status Status of the negotiation
+   * @param rate Baud rate of the status
+   */
+  void notifyBaud(MbitMoreSerialBaudStatus status, uint32_t rate);
 
 public:
   /**
@@ -90,8 +410,49 @@ public:
    * @param ch Characteristic to notify
    * @param dataBuffer Buffer to notify
    * @param len Length of the buffer to notify
+   * @param wait Sleep while the slots are full instead of dropping the notification
+   * @return true the notification is queued
+   */
+  bool notifyOnSerial(uint16_t ch, uint8_t *dataBuffer, size_t len, bool wait = false);
+
+  /**
+   * @brief Whether the notifications of the characteristic are started.
+   * 
+   * @param ch Characteristic to check
+   * @return true the characteristic is subscribed
+   */
+  bool isSubscribed(uint16_t ch);
+
+  /**
+   * @brief Request to change the baud rate from the host.
+   * A new rate is accepted and switched after the acknowledgement has been sent. Then the host
+   * has to send the same request on the new rate as the echo, otherwise the previous rate is restored.
+   * 
+   * @param rate Baud rate: 115200, 230400, 460800 or 1000000
+   */
+  void requestBaud(uint32_t rate);
+
+  /**
+   * @brief Request to change the framing from the host.
+   * The current framing is notified on 0x0143 in the previous framing, then all frames
+   * in both directions use the new one.
+   * 
+   * @param mode Framing: 0 for SFD and chksum8, 1 for COBS and CRC-16
+   */
+  void requestFraming(uint8_t mode);
+
+  /**
+   * @brief Restore the previous baud rate if the echo does not come in time.
+   * 
+   */
+  void startBaudWatchdog();
+
+  /**
+   * @brief Start continuous transmitting process of the queued frames to serial port.
+   * Events and responses go first, periodic data is sent while the TX buffer has room for events.
+   * 
    */
-  void notifyOnSerial(uint16_t ch, uint8_t *dataBuffer, size_t len);
+  void startSerialTransmitting();
 
   /**
    * @brief Start continuous receiving process from serial port.
@@ -101,6 +462,7 @@ public:
 
   /**
    * @brief Start continuous updating process to serial port.
+   * Sample and send the subscribed characteristics when their period has passed.
    * 
    */
   void startSerialUpdating();
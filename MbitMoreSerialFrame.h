@@ -0,0 +1,234 @@
+#ifndef MBIT_MORE_SERIAL_FRAME_H
+#define MBIT_MORE_SERIAL_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "MbitMoreCobs.h"
+
+#define MM_SFD 0xff
+
+/**
+ * @brief Max length of the payload in a request frame.
+ * Length of the command characteristic and a sequence number.
+ */
+#define MM_SERIAL_PAYLOAD_MAX 21
+
+/**
+ * @brief Max length of the payload in a response frame.
+ * Large enough for a batch of STATE, MOTION and ANALOG_IN_P0-P2 with their entry headers.
+ */
+#define MM_SERIAL_RESPONSE_PAYLOAD_MAX 48
+
+/**
+ * @brief Max length of a response frame in either framing.
+ * SFD, type, characteristic, length, payload and checksum, or
+ * COBS overhead, type, characteristic, payload, CRC and delimiter.
+ */
+#define MM_SERIAL_FRAME_MAX (7 + MM_SERIAL_RESPONSE_PAYLOAD_MAX)
+
+/**
+ * @brief Max length of an encoded request in COBS framing without the delimiter.
+ */
+#define MM_SERIAL_COBS_REQUEST_MAX (6 + MM_SERIAL_PAYLOAD_MAX)
+
+/**
+ * @brief Framing of the serial link.
+ *
+ */
+enum MbitMoreSerialFraming
+{
+  FRAMING_SFD = 0,  // SFD, header, length, payload and chksum8
+  FRAMING_COBS = 1, // COBS of header, payload and CRC-16, delimited by 0x00
+};
+
+/**
+ * @brief Request type from Scratch
+ *
+ */
+enum ChRequest
+{
+  REQ_READ = 0x01,
+  REQ_READ_BATCH = 0x02, // payload is the list of characteristics in big endian
+  REQ_WRITE = 0x10,
+  REQ_WRITE_RESPONSE = 0x11,
+  REQ_WRITE_SEQUENCED = 0x12, // payload is a sequence number and the data
+  REQ_NOTIFY_STOP = 0x20,
+  REQ_NOTIFY_START = 0x21,
+};
+
+/**
+ * @brief Response type to Scratch
+ *
+ */
+enum ChResponse
+{
+  RES_READ = 0x01,
+  RES_BATCH = 0x02, // payload is the list of entries: characteristic, length and data
+  RES_WRITE = 0x11,
+  RES_ACK = 0x12, // payload is the last sequence number executed in order and flags
+  RES_NOTIFY = 0x21,
+};
+
+/**
+ * @brief Request frame received from Scratch.
+ *
+ */
+typedef struct {
+  uint8_t type;                        /** request type */
+  uint16_t ch;                         /** characteristic of the request */
+  uint8_t length;                      /** length of the payload */
+  uint8_t data[MM_SERIAL_PAYLOAD_MAX]; /** payload */
+} MbitMoreSerialFrame;
+
+/**
+ * @brief Calculate checksum of the data. Sum of the buffer and return the remainder which deviced by 0xFF.
+ *
+ * @param buff Buffer to be calculate
+ * @param len Length of buffer
+ * @return uint8_t Number of checksum
+ */
+inline uint8_t chksum8(const uint8_t *buff, size_t len) {
+  unsigned int sum;
+  for (sum = 0; len != 0; len--) {
+    sum += *(buff++);
+  }
+  return (uint8_t)(sum % 0xFF);
+}
+
+/**
+ * @brief Whether the request has length, payload and checksum after the characteristic.
+ * REQ_NOTIFY_START carries the period of notifications as the payload.
+ *
+ * @param requestType type of the request
+ * @return true the request has payload
+ */
+inline bool requestHasPayload(int requestType) {
+  return (ChRequest::REQ_READ_BATCH == requestType ||
+          ChRequest::REQ_WRITE == requestType ||
+          ChRequest::REQ_WRITE_RESPONSE == requestType ||
+          ChRequest::REQ_WRITE_SEQUENCED == requestType ||
+          ChRequest::REQ_NOTIFY_START == requestType);
+}
+
+/**
+ * @brief Offset of the payload in a response frame which is built in place.
+ *
+ * @param framing framing of the frame
+ * @return size_t offset to write the payload
+ */
+inline size_t responsePayloadOffset(MbitMoreSerialFraming framing) {
+  return (MbitMoreSerialFraming::FRAMING_COBS == framing) ? 4 : 5;
+}
+
+/**
+ * @brief Complete a response frame whose payload has been written at responsePayloadOffset().
+ * SFD framing puts the header before the payload and the checksum after it.
+ * COBS framing puts the header before the payload and the CRC after it, then encodes them in place.
+ *
+ * @param framing framing of the frame
+ * @param frame Buffer of the frame, at least 7 + len bytes
+ * @param responseType type of the response
+ * @param ch characteristic of the response
+ * @param len length of the payload
+ * @return size_t length of the frame
+ */
+inline size_t finishResponse(MbitMoreSerialFraming framing, uint8_t *frame, uint8_t responseType, uint16_t ch, size_t len) {
+  if (MbitMoreSerialFraming::FRAMING_COBS == framing) {
+    uint8_t *body = &frame[1];
+    body[0] = responseType;
+    body[1] = ch >> 8;
+    body[2] = ch & 0x00FF;
+    uint16_t crc = crc16(body, 3 + len);
+    body[3 + len] = crc >> 8;
+    body[4 + len] = crc & 0x00FF;
+    size_t encoded = cobsEncode(body, 5 + len, frame);
+    frame[encoded] = MM_COBS_DELIMITER;
+    return encoded + 1;
+  }
+  frame[0] = MM_SFD;
+  frame[1] = responseType;
+  frame[2] = ch >> 8;
+  frame[3] = ch & 0x00FF;
+  frame[4] = len;
+  frame[5 + len] = chksum8(frame, 5 + len);
+  return 6 + len;
+}
+
+/**
+ * @brief Encode a response frame to Scratch.
+ *
+ * @param frame Buffer to store the frame, at least 6 + len bytes
+ * @param responseType type of the response
+ * @param ch characteristic of the response
+ * @param data payload of the response
+ * @param len length of the payload
+ * @return size_t length of the frame
+ */
+inline size_t encodeResponse(uint8_t *frame, uint8_t responseType, uint16_t ch, const uint8_t *data, size_t len) {
+  memcpy(&frame[5], data, len);
+  return finishResponse(MbitMoreSerialFraming::FRAMING_SFD, frame, responseType, ch, len);
+}
+
+/**
+ * @brief Encode a response frame to Scratch in COBS framing.
+ * Type, characteristic, payload and CRC-16 in big endian are encoded with COBS and delimited by 0x00.
+ *
+ * @param frame Buffer to store the frame, at least 7 + len bytes
+ * @param responseType type of the response
+ * @param ch characteristic of the response
+ * @param data payload of the response, up to MM_SERIAL_RESPONSE_PAYLOAD_MAX bytes
+ * @param len length of the payload
+ * @return size_t length of the frame
+ */
+inline size_t encodeResponseCobs(uint8_t *frame, uint8_t responseType, uint16_t ch, const uint8_t *data, size_t len) {
+  memcpy(&frame[4], data, len);
+  return finishResponse(MbitMoreSerialFraming::FRAMING_COBS, frame, responseType, ch, len);
+}
+
+/**
+ * @brief Decode a request frame from Scratch in COBS framing.
+ *
+ * @param buff Encoded frame without the delimiter, which is overwritten while decoding
+ * @param len Length of the encoded frame
+ * @param frame Frame to store the request
+ * @return true the frame is valid
+ */
+inline bool decodeRequestCobs(uint8_t *buff, size_t len, MbitMoreSerialFrame &frame) {
+  int decoded = cobsDecode(buff, len);
+  if (decoded < 5 || decoded - 5 > MM_SERIAL_PAYLOAD_MAX)
+    return false;
+  uint16_t crc = (buff[decoded - 2] << 8) | buff[decoded - 1];
+  if (crc16(buff, decoded - 2) != crc)
+    return false;
+  frame.type = buff[0];
+  frame.ch = (buff[1] << 8) | buff[2];
+  frame.length = decoded - 5;
+  memcpy(frame.data, &buff[3], frame.length);
+  return true;
+}
+
+/**
+ * @brief Append an entry of a characteristic to the payload of a batch response.
+ * An entry is the characteristic in big endian, the length and the data.
+ *
+ * @param payload payload of the batch, MM_SERIAL_RESPONSE_PAYLOAD_MAX bytes
+ * @param payloadLen length of the payload before appending
+ * @param ch characteristic of the entry
+ * @param data data of the characteristic
+ * @param len length of the data
+ * @return size_t length of the payload after appending, the same as payloadLen when the entry does not fit
+ */
+inline size_t appendBatchEntry(uint8_t *payload, size_t payloadLen, uint16_t ch, const uint8_t *data, size_t len) {
+  if (payloadLen + 3 + len > MM_SERIAL_RESPONSE_PAYLOAD_MAX) {
+    return payloadLen;
+  }
+  payload[payloadLen] = ch >> 8;
+  payload[payloadLen + 1] = ch & 0x00FF;
+  payload[payloadLen + 2] = len;
+  memcpy(&payload[payloadLen + 3], data, len);
+  return payloadLen + 3 + len;
+}
+
+#endif // MBIT_MORE_SERIAL_FRAME_H
@@ -20,17 +20,25 @@
 // service ID: 0b50f3e4-607f-4151-9091-7d008d6ffc5c
 const uint8_t MbitMoreService::baseUUID[16] = {0x0b, 0x50, 0xf3, 0xe4, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
 const uint16_t MbitMoreService::serviceUUID = 0xf3e4;
-const uint16_t MbitMoreService::charUUID[mbitmore_cIdx_COUNT] = {
-    0x0100, // COMMAND
-    0x0101, // STATE
-    0x0102, // MOTION
-    0x0110, // PIN_EVENT
-    0x0111, // ACTION_EVENT
-    0x0120, // ANALOG_IN_P0
-    0x0121, // ANALOG_IN_P1
-    0x0122, // ANALOG_IN_P2
-    0x0130  // MESSAGE
-};
+
+/**
+ * @brief Properties of the characteristic for the channel.
+ *
+ * @param properties MM_CH_PROP_* of the channel
+ * @return uint16_t properties of the characteristic
+ */
+static uint16_t characteristicProperties(uint8_t properties) {
+  uint16_t props = 0;
+  if (properties & MM_CH_PROP_READ)
+    props |= microbit_propREAD;
+  if (properties & MM_CH_PROP_WRITE)
+    props |= microbit_propWRITE | microbit_propWRITE_WITHOUT;
+  if (properties & MM_CH_PROP_NOTIFY)
+    props |= microbit_propNOTIFY;
+  if (properties & MM_CH_PROP_READ_AUTH)
+    props |= microbit_propREADAUTH;
+  return props;
+}
 
 /**
  * Constructor.
@@ -46,77 +54,16 @@ MbitMoreService::MbitMoreService() : uBit(pxt::uBit) {
   CreateService(serviceUUID);
 
   // Add each of our characteristics.
-  CreateCharacteristic(
-      mbitmore_cIdx_COMMAND,
-      charUUID[mbitmore_cIdx_COMMAND],
-      (uint8_t *)(commandChBuffer),
-      MM_CH_BUFFER_SIZE_COMMAND,
-      MM_CH_BUFFER_SIZE_COMMAND,
-      microbit_propWRITE | microbit_propWRITE_WITHOUT | microbit_propREAD);
-
-  CreateCharacteristic(
-      mbitmore_cIdx_STATE,
-      charUUID[mbitmore_cIdx_STATE],
-      (uint8_t *)(stateChBuffer),
-      MM_CH_BUFFER_SIZE_STATE,
-      MM_CH_BUFFER_SIZE_STATE,
-      microbit_propREAD);
-
-  CreateCharacteristic(
-      mbitmore_cIdx_MOTION,
-      charUUID[mbitmore_cIdx_MOTION],
-      (uint8_t *)(motionChBuffer),
-      MM_CH_BUFFER_SIZE_MOTION,
-      MM_CH_BUFFER_SIZE_MOTION,
-      microbit_propREAD);
-
-  CreateCharacteristic(
-      mbitmore_cIdx_PIN_EVENT,
-      charUUID[mbitmore_cIdx_PIN_EVENT],
-      (uint8_t *)(pinEventChBuffer),
-      MM_CH_BUFFER_SIZE_NOTIFY,
-      MM_CH_BUFFER_SIZE_NOTIFY,
-      microbit_propREAD | microbit_propNOTIFY);
-
-  CreateCharacteristic(
-      mbitmore_cIdx_ACTION_EVENT,
-      charUUID[mbitmore_cIdx_ACTION_EVENT],
-      (uint8_t *)(actionEventChBuffer),
-      MM_CH_BUFFER_SIZE_NOTIFY,
-      MM_CH_BUFFER_SIZE_NOTIFY,
-      microbit_propREAD | microbit_propNOTIFY);
-
-  CreateCharacteristic(
-      mbitmore_cIdx_ANALOG_IN_P0,
-      charUUID[mbitmore_cIdx_ANALOG_IN_P0],
-      (uint8_t *)(analogInP0ChBuffer),
-      MM_CH_BUFFER_SIZE_ANALOG_IN,
-      MM_CH_BUFFER_SIZE_ANALOG_IN,
-      microbit_propREAD | microbit_propREADAUTH);
-
-  CreateCharacteristic(
-      mbitmore_cIdx_ANALOG_IN_P1,
-      charUUID[mbitmore_cIdx_ANALOG_IN_P1],
-      (uint8_t *)(analogInP1ChBuffer),
-      MM_CH_BUFFER_SIZE_ANALOG_IN,
-      MM_CH_BUFFER_SIZE_ANALOG_IN,
-      microbit_propREAD | microbit_propREADAUTH);
-
-  CreateCharacteristic(
-      mbitmore_cIdx_ANALOG_IN_P2,
-      charUUID[mbitmore_cIdx_ANALOG_IN_P2],
-      (uint8_t *)(analogInP2ChBuffer),
-      MM_CH_BUFFER_SIZE_ANALOG_IN,
-      MM_CH_BUFFER_SIZE_ANALOG_IN,
-      microbit_propREAD | microbit_propREADAUTH);
-
-  CreateCharacteristic(
-      mbitmore_cIdx_DATA,
-      charUUID[mbitmore_cIdx_DATA],
-      (uint8_t *)(dataChBuffer),
-      MM_CH_BUFFER_SIZE_NOTIFY,
-      MM_CH_BUFFER_SIZE_NOTIFY,
-      microbit_propREAD | microbit_propNOTIFY);
+  for (int i = 0; i < MM_CH_BLE_COUNT; i++) {
+    const MbitMoreChannel &channel = mbitMoreChannels[i];
+    CreateCharacteristic(
+        i,
+        channel.id,
+        channelBuffer(channel),
+        channel.size,
+        channel.size,
+        characteristicProperties(channel.properties));
+  }
 
   // // Stop advertising.
   // uBit.ble->stopAdvertising();
@@ -160,7 +107,7 @@ void MbitMoreService::onDisconnect(const microbit_ble_evt_t *p_ble_evt) {
  * Callback. Invoked when any of our attributes are written via BLE.
  */
 void MbitMoreService::onDataWritten(const microbit_ble_evt_write_t *params) {
-  if (params->handle == valueHandle(mbitmore_cIdx_COMMAND) && params->len > 0) {
+  if (params->handle == valueHandle(MM_CH_IDX_COMMAND) && params->len > 0) {
     mbitMore->onCommandReceived((uint8_t *)params->data, params->len);
   }
 }
@@ -170,18 +117,15 @@ void MbitMoreService::onDataWritten(const microbit_ble_evt_write_t *params) {
  * Set  params->data and params->length to update the value
  */
 void MbitMoreService::onDataRead(microbit_onDataRead_t *params) {
-  if (params->handle == valueHandle(mbitmore_cIdx_ANALOG_IN_P0)) {
-    mbitMore->updateAnalogIn(analogInP0ChBuffer, 0);
-    params->data = analogInP0ChBuffer;
-    params->length = 2;
-  } else if (params->handle == valueHandle(mbitmore_cIdx_ANALOG_IN_P1)) {
-    mbitMore->updateAnalogIn(analogInP1ChBuffer, 1);
-    params->data = analogInP1ChBuffer;
-    params->length = 2;
-  } else if (params->handle == valueHandle(mbitmore_cIdx_ANALOG_IN_P2)) {
-    mbitMore->updateAnalogIn(analogInP2ChBuffer, 2);
-    params->data = analogInP2ChBuffer;
-    params->length = 2;
+  for (int i = 0; i < MM_CH_BLE_COUNT; i++) {
+    const MbitMoreChannel &channel = mbitMoreChannels[i];
+    if ((channel.properties & MM_CH_PROP_READ_AUTH) && params->handle == valueHandle(i)) {
+      uint8_t *buffer = channelBuffer(channel);
+      mbitMore->updateChannel(channel, buffer);
+      params->data = buffer;
+      params->length = channel.size;
+      return;
+    }
   }
 }
 
@@ -197,22 +141,26 @@ void MbitMoreService::idleCallback() {
 
 /**
  * @brief Notify action event.
+ *
+ * @return true the packet is queued to send or there is no connection, false the link has no room
  */
-void MbitMoreService::notifyActionEvent() {
+bool MbitMoreService::notifyActionEvent() {
   if (!getConnected())
-    return;
-  notifyChrValue(mbitmore_cIdx_ACTION_EVENT, actionEventChBuffer,
-                 MM_CH_BUFFER_SIZE_NOTIFY);
+    return true;
+  return notifyChrValue(MM_CH_IDX_ACTION_EVENT, actionEventChBuffer,
+                        MM_CH_BUFFER_SIZE_NOTIFY);
 }
 
 /**
  * @brief Notify pin event.
+ *
+ * @return true the packet is queued to send or there is no connection, false the link has no room
  */
-void MbitMoreService::notifyPinEvent() {
+bool MbitMoreService::notifyPinEvent() {
   if (!getConnected())
-    return;
-  notifyChrValue(mbitmore_cIdx_PIN_EVENT, pinEventChBuffer,
-                 MM_CH_BUFFER_SIZE_NOTIFY);
+    return true;
+  return notifyChrValue(MM_CH_IDX_PIN_EVENT, pinEventChBuffer,
+                        MM_CH_BUFFER_SIZE_NOTIFY);
 }
 
 /**
@@ -221,7 +169,19 @@ void MbitMoreService::notifyPinEvent() {
 void MbitMoreService::notifyData() {
   if (!getConnected())
     return;
-  notifyChrValue(mbitmore_cIdx_DATA, dataChBuffer, MM_CH_BUFFER_SIZE_NOTIFY);
+  notifyChrValue(MM_CH_IDX_DATA, dataChBuffer, MM_CH_BUFFER_SIZE_NOTIFY);
+}
+
+/**
+ * @brief Notify a packet of the accelerometer stream in its buffer.
+ *
+ * @param length length of the packet
+ * @return true the packet is queued to send or there is no connection, false the link has no room
+ */
+bool MbitMoreService::notifyAccelStream(size_t length) {
+  if (!getConnected())
+    return true;
+  return notifyChrValue(MM_CH_IDX_ACCEL_STREAM, accelStreamChBuffer, length);
 }
 
 /**
@@ -230,12 +190,20 @@ void MbitMoreService::notifyData() {
 void MbitMoreService::notify() {}
 
 /**
- * Update all sensors.
+ * Update all sensors and notify the ones which changed.
  */
 void MbitMoreService::update() {
-  if (getConnected()) {
-    mbitMore->updateState(stateChBuffer);
-    mbitMore->updateMotion(motionChBuffer);
+  if (!getConnected())
+    return;
+  for (int i = 0; i < MM_CH_BLE_COUNT; i++) {
+    const MbitMoreChannel &channel = mbitMoreChannels[i];
+    if ((channel.properties & MM_CH_PROP_SAMPLED) && !(channel.properties & MM_CH_PROP_READ_AUTH)) {
+      uint8_t *buffer = channelBuffer(channel);
+      mbitMore->updateChannel(channel, buffer);
+      if ((channel.properties & MM_CH_PROP_NOTIFY) && mbitMore->shouldNotifyChannel(channel, buffer)) {
+        notifyChrValue(i, buffer, channel.size);
+      }
+    }
   }
 }
 
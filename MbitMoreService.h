@@ -23,35 +23,8 @@ class MbitMoreDevice;
  * Class definition for the Scratch basic Service.
  * Provides a BLE service for default extension of micro:bit in Scratch3.
  */
-class MbitMoreService : public MicroBitBLEService, MicroBitComponent {
+class MbitMoreService : public MicroBitBLEService, MicroBitComponent, public MbitMoreChannelBuffers {
 public:
-  // Buffer of characteristic for receiving commands.
-  uint8_t commandChBuffer[MM_CH_BUFFER_SIZE_COMMAND] = {0};
-
-  // Buffer of characteristic for sending data of GPIO and sensors state.
-  uint8_t stateChBuffer[MM_CH_BUFFER_SIZE_STATE] = {0};
-
-  // Buffer of characteristic for sending data about motion.
-  uint8_t motionChBuffer[MM_CH_BUFFER_SIZE_MOTION] = {0};
-
-  // Buffer of characteristic for sending pin events.
-  uint8_t pinEventChBuffer[MM_CH_BUFFER_SIZE_NOTIFY] = {0};
-
-  // Buffer of characteristic for sending action events.
-  uint8_t actionEventChBuffer[MM_CH_BUFFER_SIZE_NOTIFY] = {0};
-
-  // Buffer of characteristic for sending analog input values of P0.
-  uint8_t analogInP0ChBuffer[MM_CH_BUFFER_SIZE_ANALOG_IN] = {0};
-
-  // Buffer of characteristic for sending analog input values of P1.
-  uint8_t analogInP1ChBuffer[MM_CH_BUFFER_SIZE_ANALOG_IN] = {0};
-
-  // Buffer of characteristic for sending analog input values of P2.
-  uint8_t analogInP2ChBuffer[MM_CH_BUFFER_SIZE_ANALOG_IN] = {0};
-
-  // Buffer of characteristic for sending data.
-  uint8_t dataChBuffer[MM_CH_BUFFER_SIZE_NOTIFY] = {0};
-
   /**
    * Constructor.
    * Create a representation of default extension for Scratch3.
@@ -86,13 +59,17 @@ public:
 
   /**
    * @brief Notify action event.
+   *
+   * @return true the packet is queued to send or there is no connection, false the link has no room
    */
-  void notifyActionEvent();
+  bool notifyActionEvent();
 
   /**
-   * @brief Notify action event.
+   * @brief Notify pin event.
+   *
+   * @return true the packet is queued to send or there is no connection, false the link has no room
    */
-  void notifyPinEvent();
+  bool notifyPinEvent();
 
   /**
    * @brief Notify sending data to Scratch
@@ -100,6 +77,14 @@ public:
    */
   void notifyData();
 
+  /**
+   * @brief Notify a packet of the accelerometer stream in its buffer.
+   *
+   * @param length length of the packet
+   * @return true the packet is queued to send or there is no connection, false the link has no room
+   */
+  bool notifyAccelStream(size_t length);
+
   void notify();
 
   void update();
@@ -166,28 +151,12 @@ private:
    */
   MbitMoreDevice *mbitMore;
 
-  // Index for each charactersitic in arrays of handles and UUIDs
-  typedef enum mbitmore_cIdx
-  {
-    mbitmore_cIdx_COMMAND,
-    mbitmore_cIdx_STATE,
-    mbitmore_cIdx_MOTION,
-    mbitmore_cIdx_PIN_EVENT,
-    mbitmore_cIdx_ACTION_EVENT,
-    mbitmore_cIdx_ANALOG_IN_P0,
-    mbitmore_cIdx_ANALOG_IN_P1,
-    mbitmore_cIdx_ANALOG_IN_P2,
-    mbitmore_cIdx_DATA,
-    mbitmore_cIdx_COUNT
-  } mbitmore_cIdx;
-
-  // UUIDs for our service and characteristics
+  // UUIDs for our service, characteristics are from the channel table
   static const uint8_t baseUUID[16];
   static const uint16_t serviceUUID;
-  static const uint16_t charUUID[mbitmore_cIdx_COUNT];
 
   // Data for each characteristic when they are held by Soft Device.
-  MicroBitBLEChar chars[mbitmore_cIdx_COUNT];
+  MicroBitBLEChar chars[MM_CH_BLE_COUNT];
 
   /**
    * Write IO characteristics.
@@ -195,7 +164,7 @@ private:
   void writeDigitalIn();
 
 public:
-  int characteristicCount() { return mbitmore_cIdx_COUNT; };
+  int characteristicCount() { return MM_CH_BLE_COUNT; };
   MicroBitBLEChar *characteristicPtr(int idx) { return &chars[idx]; };
 };
 
@@ -18,17 +18,23 @@
 const uint8_t MBIT_MORE_SERVICE[] = {0x0b, 0x50, 0xf3, 0xe4, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
 
 /**
- * @brief Characteristics in Microbit More Service.
+ * @brief Properties of the characteristic for the channel.
+ * Reading with MM_CH_PROP_READ_AUTH is authorized by the callback instead of a property.
  *
+ * @param properties MM_CH_PROP_* of the channel
+ * @return uint8_t properties of the characteristic
  */
-const uint8_t MBIT_MORE_CH_COMMAND[] = {0x0b, 0x50, 0x01, 0x00, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
-const uint8_t MBIT_MORE_CH_STATE[] = {0x0b, 0x50, 0x01, 0x01, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
-const uint8_t MBIT_MORE_CH_DIRECTION[] = {0x0b, 0x50, 0x01, 0x02, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
-const uint8_t MBIT_MORE_CH_PIN_EVENT[] = {0x0b, 0x50, 0x01, 0x10, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
-const uint8_t MBIT_MORE_CH_ACTION_EVENT[] = {0x0b, 0x50, 0x01, 0x11, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
-const uint8_t MBIT_MORE_CH_ANALOG_IN_P0[] = {0x0b, 0x50, 0x01, 0x20, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
-const uint8_t MBIT_MORE_CH_ANALOG_IN_P1[] = {0x0b, 0x50, 0x01, 0x21, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
-const uint8_t MBIT_MORE_CH_ANALOG_IN_P2[] = {0x0b, 0x50, 0x01, 0x22, 0x60, 0x7f, 0x41, 0x51, 0x90, 0x91, 0x7d, 0x00, 0x8d, 0x6f, 0xfc, 0x5c};
+static uint8_t characteristicProperties(uint8_t properties) {
+  uint8_t props = 0;
+  if (properties & MM_CH_PROP_READ)
+    props |= GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ;
+  if (properties & MM_CH_PROP_WRITE)
+    props |= GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE |
+             GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE;
+  if (properties & MM_CH_PROP_NOTIFY)
+    props |= GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY;
+  return props;
+}
 
 /**
  * Class definition for the Scratch MicroBit More Service.
@@ -43,61 +49,23 @@ MbitMoreServiceDAL::MbitMoreServiceDAL() : uBit(pxt::uBit) {
   mbitMore = &MbitMoreDevice::getInstance();
   mbitMore->moreService = this;
 
-  commandCh = new GattCharacteristic(
-      MBIT_MORE_CH_COMMAND, commandChBuffer, MM_CH_BUFFER_SIZE_COMMAND, MM_CH_BUFFER_SIZE_COMMAND,
-      GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE |
-          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
-  commandCh->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-
-  stateCh = new GattCharacteristic(
-      MBIT_MORE_CH_STATE, (uint8_t *)&stateChBuffer,
-      MM_CH_BUFFER_SIZE_STATE, MM_CH_BUFFER_SIZE_STATE,
-      GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
-  stateCh->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-
-  directionCh = new GattCharacteristic(
-      MBIT_MORE_CH_DIRECTION, (uint8_t *)&motionChBuffer,
-      MM_CH_BUFFER_SIZE_MOTION, MM_CH_BUFFER_SIZE_MOTION,
-      GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
-  directionCh->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-
-  pinEventCh = new GattCharacteristic(
-      MBIT_MORE_CH_PIN_EVENT, (uint8_t *)&pinEventChBuffer,
-      MM_CH_BUFFER_SIZE_NOTIFY, MM_CH_BUFFER_SIZE_NOTIFY,
-      GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ |
-          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
-  pinEventCh->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-
-  actionEventCh = new GattCharacteristic(
-      MBIT_MORE_CH_ACTION_EVENT, (uint8_t *)&actionEventChBuffer,
-      MM_CH_BUFFER_SIZE_NOTIFY, MM_CH_BUFFER_SIZE_NOTIFY,
-      GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ |
-          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
-  actionEventCh->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-
-  analogInP0Ch = new GattCharacteristic(
-      MBIT_MORE_CH_ANALOG_IN_P0, (uint8_t *)&analogInP0ChBuffer,
-      MM_CH_BUFFER_SIZE_ANALOG_IN, MM_CH_BUFFER_SIZE_ANALOG_IN,
-      GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
-  analogInP0Ch->setReadAuthorizationCallback(
-      this, &MbitMoreServiceDAL::onReadAnalogIn);
-  analogInP0Ch->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-
-  analogInP1Ch = new GattCharacteristic(
-      MBIT_MORE_CH_ANALOG_IN_P1, (uint8_t *)&analogInP1ChBuffer,
-      MM_CH_BUFFER_SIZE_ANALOG_IN, MM_CH_BUFFER_SIZE_ANALOG_IN,
-      GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
-  analogInP1Ch->setReadAuthorizationCallback(
-      this, &MbitMoreServiceDAL::onReadAnalogIn);
-  analogInP1Ch->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
-
-  analogInP2Ch = new GattCharacteristic(
-      MBIT_MORE_CH_ANALOG_IN_P2, (uint8_t *)&analogInP2ChBuffer,
-      MM_CH_BUFFER_SIZE_ANALOG_IN, MM_CH_BUFFER_SIZE_ANALOG_IN,
-      GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
-  analogInP2Ch->setReadAuthorizationCallback(
-      this, &MbitMoreServiceDAL::onReadAnalogIn);
-  analogInP2Ch->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+  // UUID of a characteristic is the one of the service with the channel ID at 2-3.
+  uint8_t charUUID[16];
+  memcpy(charUUID, MBIT_MORE_SERVICE, sizeof(charUUID));
+  for (int i = 0; i < MM_CH_BLE_COUNT; i++) {
+    const MbitMoreChannel &channel = mbitMoreChannels[i];
+    charUUID[2] = channel.id >> 8;
+    charUUID[3] = channel.id & 0xFF;
+    chars[i] = new GattCharacteristic(
+        charUUID, channelBuffer(channel),
+        channel.size, channel.size,
+        characteristicProperties(channel.properties));
+    if (channel.properties & MM_CH_PROP_READ_AUTH) {
+      chars[i]->setReadAuthorizationCallback(
+          this, &MbitMoreServiceDAL::onReadAnalogIn);
+    }
+    chars[i]->requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+  }
 
   /*
   stateCh = digitalIn[4], lightLevel[1], temperature[1], microphone[1]
@@ -107,17 +75,6 @@ MbitMoreServiceDAL::MbitMoreServiceDAL() : uBit(pxt::uBit) {
   analogInP0Ch, analogInP1Ch, analogInP2Ch
   */
 
-  GattCharacteristic *mbitMoreChs[] = {
-      commandCh,
-      stateCh,
-      directionCh,
-      pinEventCh,
-      actionEventCh,
-      analogInP0Ch,
-      analogInP1Ch,
-      analogInP2Ch,
-  };
-
   uBit.messageBus.listen(
       MICROBIT_ID_BLE,
       MICROBIT_BLE_EVT_CONNECTED,
@@ -125,9 +82,7 @@ MbitMoreServiceDAL::MbitMoreServiceDAL() : uBit(pxt::uBit) {
       &MbitMoreServiceDAL::onBLEConnected,
       MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY);
 
-  GattService mbitMoreService(MBIT_MORE_SERVICE, mbitMoreChs,
-                              sizeof(mbitMoreChs) /
-                                  sizeof(GattCharacteristic *));
+  GattService mbitMoreService(MBIT_MORE_SERVICE, chars, MM_CH_BLE_COUNT);
   uBit.ble->addService(mbitMoreService);
 
   // Setup callbacks for events.
@@ -139,7 +94,7 @@ MbitMoreServiceDAL::MbitMoreServiceDAL() : uBit(pxt::uBit) {
    */
 void MbitMoreServiceDAL::onBLEConnected(MicroBitEvent _e) {
   mbitMore->updateVersionData();
-  uBit.ble->gattServer().write(commandCh->getValueHandle(), commandChBuffer,
+  uBit.ble->gattServer().write(chars[MM_CH_IDX_COMMAND]->getValueHandle(), commandChBuffer,
                                MM_CH_BUFFER_SIZE_COMMAND);
 }
 
@@ -148,24 +103,17 @@ void MbitMoreServiceDAL::onBLEConnected(MicroBitEvent _e) {
  */
 void MbitMoreServiceDAL::onReadAnalogIn(
     GattReadAuthCallbackParams *authParams) {
-  if (authParams->handle == analogInP0Ch->getValueHandle()) {
-    mbitMore->updateAnalogIn(analogInP0ChBuffer, 0);
-    authParams->data = (uint8_t *)&analogInP0ChBuffer;
-    authParams->offset = 0;
-    authParams->len = MM_CH_BUFFER_SIZE_ANALOG_IN;
-    authParams->authorizationReply = AUTH_CALLBACK_REPLY_SUCCESS;
-  } else if (authParams->handle == analogInP1Ch->getValueHandle()) {
-    mbitMore->updateAnalogIn(analogInP1ChBuffer, 1);
-    authParams->data = (uint8_t *)&analogInP1ChBuffer;
-    authParams->offset = 0;
-    authParams->len = MM_CH_BUFFER_SIZE_ANALOG_IN;
-    authParams->authorizationReply = AUTH_CALLBACK_REPLY_SUCCESS;
-  } else if (authParams->handle == analogInP2Ch->getValueHandle()) {
-    mbitMore->updateAnalogIn(analogInP2ChBuffer, 2);
-    authParams->data = (uint8_t *)&analogInP2ChBuffer;
-    authParams->offset = 0;
-    authParams->len = MM_CH_BUFFER_SIZE_ANALOG_IN;
-    authParams->authorizationReply = AUTH_CALLBACK_REPLY_SUCCESS;
+  for (int i = 0; i < MM_CH_BLE_COUNT; i++) {
+    const MbitMoreChannel &channel = mbitMoreChannels[i];
+    if ((channel.properties & MM_CH_PROP_READ_AUTH) && authParams->handle == chars[i]->getValueHandle()) {
+      uint8_t *buffer = channelBuffer(channel);
+      mbitMore->updateChannel(channel, buffer);
+      authParams->data = buffer;
+      authParams->offset = 0;
+      authParams->len = channel.size;
+      authParams->authorizationReply = AUTH_CALLBACK_REPLY_SUCCESS;
+      return;
+    }
   }
 }
 
@@ -178,18 +126,26 @@ void MbitMoreServiceDAL::onDataWritten(const GattWriteCallbackParams *params) {
 
 /**
  * @brief Notify action event.
+ *
+ * @return true the packet is queued to send or there is no connection, false the link has no room
  */
-void MbitMoreServiceDAL::notifyActionEvent() {
-  uBit.ble->gattServer().notify(actionEventCh->getValueHandle(),
-                                actionEventChBuffer, MM_CH_BUFFER_SIZE_NOTIFY);
+bool MbitMoreServiceDAL::notifyActionEvent() {
+  if (!uBit.ble->gap().getState().connected)
+    return true;
+  return uBit.ble->gattServer().notify(chars[MM_CH_IDX_ACTION_EVENT]->getValueHandle(),
+                                       actionEventChBuffer, MM_CH_BUFFER_SIZE_NOTIFY) == BLE_ERROR_NONE;
 }
 
 /**
  * @brief Notify pin event.
+ *
+ * @return true the packet is queued to send or there is no connection, false the link has no room
  */
-void MbitMoreServiceDAL::notifyPinEvent() {
-  uBit.ble->gattServer().notify(pinEventCh->getValueHandle(), pinEventChBuffer,
-                                MM_CH_BUFFER_SIZE_NOTIFY);
+bool MbitMoreServiceDAL::notifyPinEvent() {
+  if (!uBit.ble->gap().getState().connected)
+    return true;
+  return uBit.ble->gattServer().notify(chars[MM_CH_IDX_PIN_EVENT]->getValueHandle(), pinEventChBuffer,
+                                       MM_CH_BUFFER_SIZE_NOTIFY) == BLE_ERROR_NONE;
 }
 
 /**
@@ -202,13 +158,17 @@ void MbitMoreServiceDAL::notify() {}
  */
 void MbitMoreServiceDAL::update() {
   if (uBit.ble->gap().getState().connected) {
-    mbitMore->updateState(stateChBuffer);
-    uBit.ble->gattServer().write(stateCh->getValueHandle(), stateChBuffer,
-                                 MM_CH_BUFFER_SIZE_STATE);
-    mbitMore->updateMotion(motionChBuffer);
-    uBit.ble->gattServer().write(directionCh->getValueHandle(),
-                                 motionChBuffer,
-                                 MM_CH_BUFFER_SIZE_MOTION);
+    for (int i = 0; i < MM_CH_BLE_COUNT; i++) {
+      const MbitMoreChannel &channel = mbitMoreChannels[i];
+      if ((channel.properties & MM_CH_PROP_SAMPLED) && !(channel.properties & MM_CH_PROP_READ_AUTH)) {
+        uint8_t *buffer = channelBuffer(channel);
+        mbitMore->updateChannel(channel, buffer);
+        // Writing a notifiable value notifies it, so the value is written only on changes.
+        if (!(channel.properties & MM_CH_PROP_NOTIFY) || mbitMore->shouldNotifyChannel(channel, buffer)) {
+          uBit.ble->gattServer().write(chars[i]->getValueHandle(), buffer, channel.size);
+        }
+      }
+    }
   } else {
     mbitMore->displayFriendlyName();
   }
@@ -18,7 +18,7 @@ class MbitMoreDevice;
  * Class definition for a MicroBitMore Service.
  * Provides a BLE service to remotely read the state of sensors from Scratch3.
  */
-class MbitMoreServiceDAL {
+class MbitMoreServiceDAL : public MbitMoreChannelBuffers {
 public:
   /**
    * Constructor.
@@ -35,13 +35,17 @@ public:
 
   /**
    * @brief Notify action event.
+   *
+   * @return true the packet is queued to send or there is no connection, false the link has no room
    */
-  void notifyActionEvent();
+  bool notifyActionEvent();
 
   /**
-   * @brief Notify action event.
+   * @brief Notify pin event.
+   *
+   * @return true the packet is queued to send or there is no connection, false the link has no room
    */
-  void notifyPinEvent();
+  bool notifyPinEvent();
 
   /**
    * Callback. Invoked when AnalogIn is read via BLE.
@@ -55,30 +59,6 @@ public:
 
   void update();
 
-  // Buffer of characteristic for receiving commands.
-  uint8_t commandChBuffer[MM_CH_BUFFER_SIZE_COMMAND] = {0};
-
-  // Buffer of characteristic for sending data of GPIO and sensors state.
-  uint8_t stateChBuffer[MM_CH_BUFFER_SIZE_STATE] = {0};
-
-  // Buffer of characteristic for sending data about motion.
-  uint8_t motionChBuffer[MM_CH_BUFFER_SIZE_MOTION] = {0};
-
-  // Buffer of characteristic for sending pin events.
-  uint8_t pinEventChBuffer[MM_CH_BUFFER_SIZE_NOTIFY] = {0};
-
-  // Buffer of characteristic for sending action events.
-  uint8_t actionEventChBuffer[MM_CH_BUFFER_SIZE_NOTIFY] = {0};
-
-  // Buffer of characteristic for sending analog input values of P0.
-  uint8_t analogInP0ChBuffer[MM_CH_BUFFER_SIZE_ANALOG_IN] = {0};
-
-  // Buffer of characteristic for sending analog input values of P1.
-  uint8_t analogInP1ChBuffer[MM_CH_BUFFER_SIZE_ANALOG_IN] = {0};
-
-  // Buffer of characteristic for sending analog input values of P2.
-  uint8_t analogInP2ChBuffer[MM_CH_BUFFER_SIZE_ANALOG_IN] = {0};
-
 private:
   /**
    * @brief micro:bit runtime object.
@@ -92,14 +72,8 @@ private:
    */
   MbitMoreDevice *mbitMore;
 
-  GattCharacteristic *commandCh;
-  GattCharacteristic *stateCh;
-  GattCharacteristic *directionCh;
-  GattCharacteristic *pinEventCh;
-  GattCharacteristic *actionEventCh;
-  GattCharacteristic *analogInP0Ch;
-  GattCharacteristic *analogInP1Ch;
-  GattCharacteristic *analogInP2Ch;
+  // Characteristics in the order of the channel table.
+  GattCharacteristic *chars[MM_CH_BLE_COUNT];
 };
 
 #endif // MBIT_MORE_SERVICE_DAL_H
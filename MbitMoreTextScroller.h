@@ -0,0 +1,195 @@
+#ifndef MBIT_MORE_TEXT_SCROLLER_H
+#define MBIT_MORE_TEXT_SCROLLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "MbitMoreDisplayFrame.h"
+
+/**
+ * @brief Number of the columns of a glyph.
+ */
+#define MM_GLYPH_WIDTH 5
+
+/**
+ * @brief Columns of a glyph and the blank column after it.
+ */
+#define MM_GLYPH_STRIDE (MM_GLYPH_WIDTH + 1)
+
+/**
+ * @brief Blank columns before the text, so that the first column of the text appears on the right edge.
+ */
+#define MM_TEXT_LEAD (MM_DISPLAY_SIZE - 1)
+
+/**
+ * @brief Convert the rows of a glyph in the system font to its columns.
+ * A row has the leftmost column at 0x10, and a column has the top row at bit 0.
+ *
+ * @param rows MM_DISPLAY_SIZE rows of the glyph, or NULL for blank
+ * @param columns MM_GLYPH_WIDTH columns
+ */
+inline void mbitMoreGlyphColumns(const uint8_t *rows, uint8_t *columns) {
+  for (size_t x = 0; x < MM_GLYPH_WIDTH; x++) {
+    uint8_t column = 0;
+    for (size_t y = 0; rows && y < MM_DISPLAY_SIZE; y++) {
+      if (rows[y] & (0x10 >> x))
+        column |= (uint8_t)(1 << y);
+    }
+    columns[x] = column;
+  }
+}
+
+/**
+ * @brief Show a glyph on the whole LED.
+ *
+ * @param rows MM_DISPLAY_SIZE rows of the glyph, or NULL for blank
+ * @param pixels MM_DISPLAY_PIXELS of brightness
+ */
+inline void mbitMoreGlyphPixels(const uint8_t *rows, uint8_t *pixels) {
+  for (size_t i = 0; i < MM_DISPLAY_PIXELS; i++) {
+    size_t x = i % MM_DISPLAY_SIZE;
+    pixels[i] = (rows && x < MM_GLYPH_WIDTH && (rows[i / MM_DISPLAY_SIZE] & (0x10 >> x))) ? 255 : 0;
+  }
+}
+
+/**
+ * @brief Scroller of text on the LED, which is rendered from the columns of the glyphs.
+ * The columns are made once when a character is appended, so that a step of the scroll only picks the columns.
+ * Text can be appended while it is scrolling without restarting. Characters which have gone out of the LED
+ * are released, so the text in a scroll can be longer than the buffer.
+ *
+ * @tparam N Number of the characters in the buffer
+ */
+template <size_t N>
+class MbitMoreTextScroller {
+public:
+  /**
+   * @brief Function which returns the rows of the glyph of a character, or NULL when it has no glyph.
+   */
+  typedef const uint8_t *(*GlyphFunction)(char c);
+
+  explicit MbitMoreTextScroller(GlyphFunction glyph) : glyph(glyph) {}
+
+  /**
+   * @brief Start a new scroll without text. It scrolls from the right edge when text is appended.
+   *
+   * @param stepTime time to shift by a column [ms], 0 is taken as 1
+   * @param now current time [ms]
+   */
+  void start(uint16_t stepTime, uint32_t now) {
+    delay = stepTime ? stepTime : 1;
+    first = 0;
+    end = 0;
+    step = 0;
+    due = now;
+    playing = true;
+  }
+
+  /**
+   * @brief Append text to the scroll. It stops at a null character.
+   *
+   * @param text characters to append
+   * @param length maximum length of the text
+   * @return size_t number of the characters which were appended, less than the length when the buffer is full
+   */
+  size_t append(const char *text, size_t length) {
+    size_t appended = 0;
+    while (appended < length && text[appended] != '\0' && end - first < N) {
+      mbitMoreGlyphColumns(glyph(text[appended]), columns[end % N]);
+      end++;
+      appended++;
+    }
+    return appended;
+  }
+
+  /**
+   * @brief Stop scrolling. The pixels which were shown are kept on the LED.
+   */
+  void stop() { playing = false; }
+
+  /**
+   * @brief Whether the text is scrolling.
+   *
+   * @return true scrolling
+   */
+  bool isPlaying() const { return playing; }
+
+  /**
+   * @brief Number of the characters in the buffer, which have not gone out of the LED.
+   *
+   * @return size_t number of the characters
+   */
+  size_t size() const { return (size_t)(end - first); }
+
+  /**
+   * @brief Advance the scroll to the time.
+   * It stops when the last character has gone out of the LED.
+   *
+   * @param now current time [ms]
+   * @param pixels brightness of the pixels of the frame to show
+   * @return true the frame to show was set on the pixels, false no frame is due
+   */
+  bool update(uint32_t now, uint8_t *pixels) {
+    if (!playing || (int32_t)(now - due) < 0)
+      return false;
+    for (size_t x = 0; x < MM_DISPLAY_SIZE; x++) {
+      uint8_t column = columnAt(step + x);
+      for (size_t y = 0; y < MM_DISPLAY_SIZE; y++) {
+        pixels[y * MM_DISPLAY_SIZE + x] = ((column >> y) & 1) ? 255 : 0;
+      }
+    }
+    step++;
+    if (step >= MM_TEXT_LEAD + end * MM_GLYPH_STRIDE) {
+      playing = false; // blank after the last character
+    }
+    while (first < end && MM_TEXT_LEAD + (first + 1) * MM_GLYPH_STRIDE <= step) {
+      first++;
+    }
+    due += delay;
+    if ((int32_t)(now - due) > 0) {
+      due = now + delay; // too late to catch up
+    }
+    return true;
+  }
+
+  /**
+   * @brief Time to wait for the next step.
+   *
+   * @param now current time [ms]
+   * @return uint32_t time until the next step [ms], 0 when it is due
+   */
+  uint32_t waitTime(uint32_t now) const {
+    int32_t wait = (int32_t)(due - now);
+    return wait > 0 ? (uint32_t)wait : 0;
+  }
+
+private:
+  /**
+   * @brief Column on the strip of the text, which starts with MM_TEXT_LEAD blank columns.
+   *
+   * @param position position on the strip
+   * @return uint8_t rows of the column
+   */
+  uint8_t columnAt(uint32_t position) const {
+    if (position < MM_TEXT_LEAD)
+      return 0;
+    uint32_t textColumn = position - MM_TEXT_LEAD;
+    uint32_t index = textColumn / MM_GLYPH_STRIDE;
+    uint32_t x = textColumn % MM_GLYPH_STRIDE;
+    if (index < first || index >= end || x >= MM_GLYPH_WIDTH)
+      return 0;
+    return columns[index % N][x];
+  }
+
+  GlyphFunction glyph;
+  uint8_t columns[N][MM_GLYPH_WIDTH] = {};
+  uint32_t first = 0; // index of the oldest character in the buffer
+  uint32_t end = 0;   // index after the last character
+  uint32_t step = 0;  // position of the left column of the LED on the strip
+  uint32_t due = 0;
+  uint16_t delay = 1;
+  bool playing = false;
+};
+
+#endif // MBIT_MORE_TEXT_SCROLLER_H
@@ -0,0 +1,149 @@
+#ifndef MBIT_MORE_TONE_SEQUENCER_H
+#define MBIT_MORE_TONE_SEQUENCER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "MbitMoreEventQueue.h"
+
+/**
+ * @brief Length of a note in a command: period [us] in uint16_t, volume and duration [ms] in uint16_t little-endian.
+ */
+#define MM_TONE_NOTE_SIZE 5
+
+/**
+ * @brief Length of the report of the tone queue: queued notes and free slots in uint8_t, played notes in uint16_t little-endian.
+ */
+#define MM_TONE_REPORT_SIZE 4
+
+/**
+ * @brief Note of a melody.
+ */
+struct MbitMoreTone {
+  uint16_t period;   /** period of the tone [us], 0 for a rest */
+  uint8_t volume;    /** volume [0..255], 0 for a rest */
+  uint16_t duration; /** time to play [ms] */
+};
+
+/**
+ * @brief Player of the notes which were queued by the host.
+ * Each note starts at the end time of the previous note on the microsecond timeline,
+ * so that the delay of waking up does not accumulate in the rhythm. The tone is silenced when the queue runs out.
+ *
+ * @tparam N Number of the notes, a power of 2
+ */
+template <size_t N>
+class MbitMoreToneSequencer {
+  static_assert(N < 256, "Level of the queue is reported in uint8_t");
+
+public:
+  /**
+   * @brief Number of the notes which have started.
+   *
+   */
+  uint16_t played = 0;
+
+  /**
+   * @brief Queue the notes in a command.
+   *
+   * @param data notes of MM_TONE_NOTE_SIZE
+   * @param length length of the data
+   * @return size_t number of the notes which were queued, less than in the data when the queue is full
+   */
+  size_t push(const uint8_t *data, size_t length) {
+    size_t queued = 0;
+    for (size_t offset = 0; offset + MM_TONE_NOTE_SIZE <= length; offset += MM_TONE_NOTE_SIZE) {
+      MbitMoreTone tone;
+      tone.period = (uint16_t)(data[offset] | (data[offset + 1] << 8));
+      tone.volume = data[offset + 2];
+      tone.duration = (uint16_t)(data[offset + 3] | (data[offset + 4] << 8));
+      if (!notes.push(tone))
+        break;
+      queued++;
+    }
+    return queued;
+  }
+
+  /**
+   * @brief Remove the queued notes and stop playing.
+   */
+  void clear() {
+    notes.clear();
+    playing = false;
+  }
+
+  /**
+   * @brief Number of the notes which are waiting.
+   *
+   * @return size_t number of the notes
+   */
+  size_t size() const { return notes.size(); }
+
+  /**
+   * @brief Whether a note is playing or waiting.
+   *
+   * @return true playing or waiting
+   */
+  bool isActive() const { return playing || notes.size() > 0; }
+
+  /**
+   * @brief Advance to the time. The first note after a pause starts at the time.
+   *
+   * @param now current time [us]
+   * @param tone tone to play, which has volume 0 when the queue ran out
+   * @return true the tone should be changed, false no change is due
+   */
+  bool update(uint64_t now, MbitMoreTone *tone) {
+    if (playing && now < due)
+      return false;
+    if (notes.size() == 0) {
+      if (!playing)
+        return false;
+      playing = false;
+      tone->period = 0;
+      tone->volume = 0;
+      tone->duration = 0;
+      return true;
+    }
+    if (!playing) {
+      due = now;
+      playing = true;
+    }
+    *tone = notes.peek(0);
+    notes.drop(1);
+    played++;
+    due += (uint64_t)tone->duration * 1000;
+    if (due < now) {
+      due = now + (uint64_t)tone->duration * 1000; // too late to catch up
+    }
+    return true;
+  }
+
+  /**
+   * @brief Time to wait for the next change.
+   *
+   * @param now current time [us]
+   * @return uint64_t time until the next change [us], 0 when it is due or nothing is playing
+   */
+  uint64_t waitTime(uint64_t now) const { return (playing && now < due) ? due - now : 0; }
+
+  /**
+   * @brief Pack the report of the queue.
+   *
+   * @param packet buffer of MM_TONE_REPORT_SIZE
+   */
+  void report(uint8_t *packet) const {
+    size_t queued = notes.size();
+    packet[0] = (uint8_t)queued;
+    packet[1] = (uint8_t)(N - queued);
+    packet[2] = played & 0xFF;
+    packet[3] = (played >> 8) & 0xFF;
+  }
+
+private:
+  MbitMoreEventQueue<MbitMoreTone, N> notes;
+  uint64_t due = 0;
+  bool playing = false;
+};
+
+#endif // MBIT_MORE_TONE_SEQUENCER_H
@@ -0,0 +1,202 @@
+#ifndef MBIT_MORE_TX_QUEUE_H
+#define MBIT_MORE_TX_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "MbitMoreSerialFrame.h"
+
+/**
+ * @brief Priority of a frame to send.
+ *
+ */
+enum MbitMoreTxPriority
+{
+  TX_HIGH = 0, // events and responses to requests
+  TX_LOW = 1,  // periodic data which can be superseded
+};
+
+/**
+ * @brief Frame waiting to be sent.
+ *
+ */
+typedef struct {
+  uint16_t ch;                        /** characteristic of the frame */
+  uint8_t length;                     /** length of the frame */
+  uint8_t bytes[MM_SERIAL_FRAME_MAX]; /** encoded frame */
+} MbitMoreTxFrame;
+
+/**
+ * @brief Queue of encoded frames in two priorities.
+ * High priority frames are taken out before any low priority one. A low priority frame
+ * replaces the queued one of the same characteristic, because only the latest data matters.
+ * Frames are built in fixed slots and dropped when the slots are full, so queueing never blocks
+ * and a frame is never copied before being sent.
+ *
+ * @tparam HIGH Number of slots for high priority frames
+ * @tparam LOW Number of slots for low priority frames
+ */
+template <size_t HIGH, size_t LOW>
+class MbitMoreTxQueue {
+public:
+  /**
+   * @brief Number of frames dropped because the slots were full, for each priority.
+   *
+   */
+  uint16_t dropped[2] = {0, 0};
+
+  /**
+   * @brief Number of low priority frames replaced by newer ones before being sent.
+   *
+   */
+  uint16_t replaced = 0;
+
+  /**
+   * @brief Max number of frames queued at once, for each priority.
+   *
+   */
+  uint8_t maxDepth[2] = {0, 0};
+
+  /**
+   * @brief Take a slot to build a frame in place. The frame is queued by commit().
+   * A low priority frame takes the slot of the queued one of the same characteristic.
+   * No other slot may be acquired and no frame may be taken out until commit().
+   *
+   * @param priority priority of the frame
+   * @param ch characteristic of the frame
+   * @return MbitMoreTxFrame* slot to build the frame, NULL when the slots are full
+   */
+  MbitMoreTxFrame *acquire(MbitMoreTxPriority priority, uint16_t ch) {
+    MbitMoreTxFrame *slot = NULL;
+    if (TX_LOW == priority) {
+      slot = low.find(ch);
+      if (slot == NULL)
+        slot = low.reserve();
+    } else {
+      slot = high.reserve();
+    }
+    if (slot == NULL) {
+      dropped[priority]++;
+      return NULL;
+    }
+    slot->ch = ch;
+    return slot;
+  }
+
+  /**
+   * @brief Queue the frame built in the acquired slot.
+   *
+   * @param priority priority of the frame
+   * @param slot slot returned by acquire()
+   * @param len length of the frame
+   */
+  void commit(MbitMoreTxPriority priority, MbitMoreTxFrame *slot, size_t len) {
+    slot->length = len;
+    bool appended = (TX_LOW == priority) ? low.commit(slot) : high.commit(slot);
+    if (!appended)
+      replaced++;
+    uint8_t queued = depth(priority);
+    if (queued > maxDepth[priority])
+      maxDepth[priority] = queued;
+  }
+
+  /**
+   * @brief Number of queued frames in the priority.
+   *
+   * @param priority priority to count
+   * @return uint8_t number of frames
+   */
+  uint8_t depth(MbitMoreTxPriority priority) const {
+    return (TX_LOW == priority) ? low.count : high.count;
+  }
+
+  /**
+   * @brief Whether all the slots of the priority are taken.
+   *
+   * @param priority priority to check
+   * @return true no frame of the priority can be queued until one is taken out
+   */
+  bool full(MbitMoreTxPriority priority) const { return depth(priority) >= ((TX_LOW == priority) ? LOW : HIGH); }
+
+  /**
+   * @brief Whether no frame is queued.
+   *
+   * @return true the queue is empty
+   */
+  bool empty() const { return high.count == 0 && low.count == 0; }
+
+  /**
+   * @brief Priority of the frame which will be taken out next. Valid only when not empty.
+   *
+   * @return MbitMoreTxPriority priority of the front frame
+   */
+  MbitMoreTxPriority frontPriority() const { return (high.count > 0) ? TX_HIGH : TX_LOW; }
+
+  /**
+   * @brief The frame which will be taken out next. Valid only when not empty.
+   *
+   * @return const MbitMoreTxFrame& the front frame
+   */
+  const MbitMoreTxFrame &front() const { return (high.count > 0) ? high.front() : low.front(); }
+
+  /**
+   * @brief Remove the front frame.
+   *
+   */
+  void pop() {
+    if (high.count > 0) {
+      high.pop();
+    } else {
+      low.pop();
+    }
+  }
+
+private:
+  /**
+   * @brief FIFO of frames in a priority.
+   *
+   * @tparam M Number of slots
+   */
+  template <size_t M>
+  struct Lane {
+    MbitMoreTxFrame slots[M];
+    uint8_t head = 0;
+    uint8_t count = 0;
+
+    static size_t wrap(size_t index) { return (index >= M) ? index - M : index; }
+
+    MbitMoreTxFrame *reserve() {
+      if (count == M)
+        return NULL;
+      return &slots[wrap(head + count)];
+    }
+
+    bool commit(MbitMoreTxFrame *slot) {
+      if (count == M || slot != &slots[wrap(head + count)])
+        return false;
+      count++;
+      return true;
+    }
+
+    MbitMoreTxFrame *find(uint16_t ch) {
+      for (size_t i = 0; i < count; i++) {
+        MbitMoreTxFrame *slot = &slots[wrap(head + i)];
+        if (slot->ch == ch)
+          return slot;
+      }
+      return NULL;
+    }
+
+    const MbitMoreTxFrame &front() const { return slots[head]; }
+
+    void pop() {
+      head = wrap(head + 1);
+      count--;
+    }
+  };
+
+  Lane<HIGH> high;
+  Lane<LOW> low;
+};
+
+#endif // MBIT_MORE_TX_QUEUE_H
@@ -0,0 +1,61 @@
+#ifndef MBIT_MORE_HOST_TEST_H
+#define MBIT_MORE_HOST_TEST_H
+
+// Minimal test helpers for the parts of Microbit More which do not depend on the micro:bit runtime.
+// Each *.test.cpp is built and run by `make test-host`.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static int hostTestFailures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      hostTestFailures++;                                             \
+    }                                                                 \
+  } while (0)
+
+#define CHECK_EQ(expected, actual)                                                          \
+  do {                                                                                      \
+    long long e_ = (long long)(expected);                                                   \
+    long long a_ = (long long)(actual);                                                     \
+    if (e_ != a_) {                                                                         \
+      std::printf("%s:%d: CHECK_EQ failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, \
+                  #expected, #actual, e_, a_);                                              \
+      hostTestFailures++;                                                                   \
+    }                                                                                       \
+  } while (0)
+
+#define RUN_TEST(fn)             \
+  do {                           \
+    std::printf("- %s\n", #fn); \
+    fn();                        \
+  } while (0)
+
+/**
+ * @brief Elapsed time since the construction in nanoseconds.
+ */
+class HostStopwatch {
+public:
+  HostStopwatch() : start(std::chrono::steady_clock::now()) {}
+  double elapsedNs() const {
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point start;
+};
+
+static int hostTestResult() {
+  if (hostTestFailures > 0) {
+    std::printf("%d check(s) failed\n", hostTestFailures);
+    return EXIT_FAILURE;
+  }
+  std::printf("ok\n");
+  return EXIT_SUCCESS;
+}
+
+#endif // MBIT_MORE_HOST_TEST_H
@@ -0,0 +1,257 @@
+#include <atomic>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "HostTest.h"
+
+#include "MbitMoreAckTracker.h"
+#include "MbitMoreFrameParser.h"
+
+typedef MbitMoreAckTracker<4> Tracker;
+
+static void testAcknowledgesInBatches() {
+  Tracker tracker;
+  CHECK(!tracker.ackDue(true));
+  for (int i = 0; i < 3; i++) {
+    CHECK(tracker.receive(10 + i));
+    CHECK(!tracker.ackDue(false));
+  }
+  CHECK(tracker.ackDue(true));
+  CHECK(tracker.receive(13));
+  CHECK(tracker.ackDue(false));
+  CHECK_EQ(13, tracker.lastSequence());
+  CHECK_EQ(0, tracker.flags());
+  tracker.acked();
+  CHECK(!tracker.ackDue(true));
+}
+
+static void testReportsGapOnceAndGoesBack() {
+  Tracker tracker;
+  CHECK(tracker.receive(254));
+  CHECK(tracker.receive(255));
+  // 0 is lost, the commands after it are discarded.
+  CHECK(!tracker.receive(1));
+  CHECK(tracker.ackDue(false));
+  CHECK_EQ(255, tracker.lastSequence());
+  CHECK_EQ(MM_ACK_GAP, tracker.flags());
+  tracker.acked();
+  CHECK(!tracker.receive(2));
+  CHECK(!tracker.ackDue(false));
+  // The host goes back to 0.
+  CHECK(tracker.receive(0));
+  CHECK(tracker.receive(1));
+  CHECK_EQ(1, tracker.lastSequence());
+  CHECK_EQ(0, tracker.flags());
+  CHECK_EQ(2, tracker.outOfOrder);
+}
+
+static void testAcknowledgesDuplicateAgain() {
+  Tracker tracker;
+  CHECK(tracker.receive(5));
+  tracker.acked();
+  CHECK(!tracker.receive(5));
+  CHECK(tracker.ackDue(false));
+  CHECK_EQ(5, tracker.lastSequence());
+  CHECK_EQ(1, tracker.duplicated);
+  tracker.reset();
+  CHECK(tracker.receive(100));
+}
+
+// Link model of the pty stand-in: the line rate of micro:bit serial and the latency of USB before each response.
+static const long BYTE_TIME_US = 87; // 115200 baud
+static const long USB_LATENCY_US = 1000;
+
+static void sleepUs(long us) {
+  if (us > 0)
+    usleep(us);
+}
+
+static void writeAll(int fd, const uint8_t *data, size_t len) {
+  while (len > 0) {
+    ssize_t written = write(fd, data, len);
+    if (written <= 0)
+      return;
+    data += written;
+    len -= written;
+  }
+}
+
+/**
+ * @brief Stand-in of the serial receiving process of the micro:bit on the other end of a pty.
+ */
+static void runDevice(int fd, std::atomic<bool> *running, long *executed, bool *inOrder) {
+  MbitMoreFrameParser<254> parser;
+  Tracker tracker;
+  MbitMoreSerialFrame frame;
+  uint8_t expected = 0;
+  bool first = true;
+  while (running->load()) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 10) <= 0)
+      continue;
+    ssize_t len = read(fd, parser.writePointer(), parser.writableSize());
+    if (len <= 0)
+      continue;
+    sleepUs(len * BYTE_TIME_US);
+    parser.commit(len);
+    while (true) {
+      bool got = parser.next(frame);
+      uint8_t response[MM_SERIAL_FRAME_MAX];
+      size_t responseSize = 0;
+      if (got && ChRequest::REQ_WRITE_RESPONSE == frame.type) {
+        uint8_t result = 1;
+        responseSize = encodeResponse(response, ChResponse::RES_WRITE, frame.ch, &result, 1);
+        (*executed)++;
+      } else if (got && ChRequest::REQ_WRITE_SEQUENCED == frame.type) {
+        if (tracker.receive(frame.data[0])) {
+          if (!first && frame.data[0] != expected)
+            *inOrder = false;
+          first = false;
+          expected = frame.data[0] + 1;
+          (*executed)++;
+        }
+      }
+      if (tracker.ackDue(!got)) {
+        uint8_t ack[2] = {tracker.lastSequence(), tracker.flags()};
+        responseSize = encodeResponse(response, ChResponse::RES_ACK, 0x0100, ack, sizeof(ack));
+        tracker.acked();
+      }
+      if (responseSize > 0) {
+        sleepUs(USB_LATENCY_US + responseSize * BYTE_TIME_US);
+        writeAll(fd, response, responseSize);
+      }
+      if (!got)
+        break;
+    }
+  }
+}
+
+/**
+ * @brief Host end of the pty which takes out response frames.
+ */
+struct HostLink {
+  int fd;
+  std::vector<uint8_t> received;
+
+  bool nextResponse(uint8_t *type, uint8_t *data) {
+    while (true) {
+      while (!received.empty() && received[0] != MM_SFD)
+        received.erase(received.begin());
+      if (received.size() >= 5 && received.size() >= (size_t)(6 + received[4])) {
+        size_t frameSize = 6 + received[4];
+        bool valid = chksum8(received.data(), frameSize - 1) == received[frameSize - 1];
+        *type = received[1];
+        memcpy(data, &received[5], received[4]);
+        received.erase(received.begin(), received.begin() + (valid ? frameSize : 1));
+        if (valid)
+          return true;
+        continue;
+      }
+      struct pollfd pfd = {fd, POLLIN, 0};
+      if (poll(&pfd, 1, 1000) <= 0)
+        return false;
+      uint8_t buff[256];
+      ssize_t len = read(fd, buff, sizeof(buff));
+      if (len <= 0)
+        return false;
+      received.insert(received.end(), buff, buff + len);
+    }
+  }
+};
+
+static void sendCommand(int fd, uint8_t type, long index) {
+  // Pin output command on P0
+  uint8_t request[12] = {MM_SFD, type, 0x01, 0x00};
+  size_t len = 0;
+  if (ChRequest::REQ_WRITE_SEQUENCED == type)
+    request[5 + len++] = (uint8_t)index;
+  request[5 + len++] = 0x21;
+  request[5 + len++] = 0;
+  request[5 + len++] = index & 1;
+  request[4] = len;
+  request[5 + len] = chksum8(request, 5 + len);
+  writeAll(fd, request, 6 + len);
+}
+
+static bool stopAndWait(HostLink &link, long commands) {
+  uint8_t type;
+  uint8_t data[MM_SERIAL_FRAME_MAX];
+  for (long i = 0; i < commands; i++) {
+    sendCommand(link.fd, ChRequest::REQ_WRITE_RESPONSE, i);
+    if (!link.nextResponse(&type, data) || ChResponse::RES_WRITE != type)
+      return false;
+  }
+  return true;
+}
+
+static bool pipelined(HostLink &link, long commands, long window) {
+  long next = 0;
+  long acked = 0;
+  uint8_t type;
+  uint8_t data[MM_SERIAL_FRAME_MAX];
+  while (acked < commands) {
+    while (next < commands && next - acked < window) {
+      sendCommand(link.fd, ChRequest::REQ_WRITE_SEQUENCED, next++);
+    }
+    if (!link.nextResponse(&type, data))
+      return false;
+    if (ChResponse::RES_ACK != type)
+      continue;
+    acked += (uint8_t)(data[0] + 1 - (uint8_t)acked);
+    if (data[1] & MM_ACK_GAP)
+      next = acked;
+  }
+  return true;
+}
+
+/**
+ * @brief Measure commands per second with and without sequence numbers through a pty.
+ */
+static void benchmarkPty() {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    std::printf("  pty is not available, skipped\n");
+    return;
+  }
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  const long commands = 400;
+  double rates[2];
+  for (int mode = 0; mode < 2; mode++) {
+    std::atomic<bool> running(true);
+    long executed = 0;
+    bool inOrder = true;
+    std::thread device(runDevice, slave, &running, &executed, &inOrder);
+    HostLink link = {master, std::vector<uint8_t>()};
+    HostStopwatch watch;
+    bool done = (mode == 0) ? stopAndWait(link, commands) : pipelined(link, commands, 8);
+    double seconds = watch.elapsedNs() / 1e9;
+    running.store(false);
+    device.join();
+    CHECK(done);
+    CHECK_EQ(commands, executed);
+    CHECK(inOrder);
+    rates[mode] = commands / seconds;
+  }
+  std::printf("  stop-and-wait %6.0f commands/s  pipelined %6.0f commands/s\n", rates[0], rates[1]);
+  CHECK(rates[1] > rates[0]);
+  close(slave);
+  close(master);
+}
+
+int main() {
+  RUN_TEST(testAcknowledgesInBatches);
+  RUN_TEST(testReportsGapOnceAndGoesBack);
+  RUN_TEST(testAcknowledgesDuplicateAgain);
+  RUN_TEST(benchmarkPty);
+  return hostTestResult();
+}
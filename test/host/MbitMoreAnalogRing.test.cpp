@@ -0,0 +1,177 @@
+#include "HostTest.h"
+
+#include "MbitMoreAnalogRing.h"
+
+typedef MbitMoreAnalogRing<5> Ring;
+
+/**
+ * @brief Fake ADC of a pin: the level with noise of a few counts and
+ * a spike now and then, like the switching noise of the radio.
+ */
+class FakeAdc {
+public:
+  uint16_t level = 512;
+  uint32_t conversions = 0;
+
+  uint16_t convert() {
+    conversions++;
+    seed = seed * 1103515245 + 12345;
+    int noise = (int)((seed >> 16) % 7) - 3;
+    if (((seed >> 8) & 0x3F) == 0)
+      noise += 300;
+    int value = level + noise;
+    return (uint16_t)(value > 1023 ? 1023 : value);
+  }
+
+private:
+  uint32_t seed = 1;
+};
+
+static void testMedianOfPartialRing() {
+  Ring ring;
+  CHECK_EQ(0, ring.size());
+  CHECK_EQ(0, ring.median());
+  ring.push(30);
+  CHECK_EQ(30, ring.median());
+  ring.push(10);
+  ring.push(20);
+  CHECK_EQ(3, ring.size());
+  CHECK_EQ(20, ring.median());
+}
+
+static void testOverwritesOldestSample() {
+  Ring ring;
+  for (uint16_t i = 1; i <= 5; i++) {
+    ring.push(i);
+  }
+  CHECK_EQ(3, ring.median());
+  for (uint16_t i = 0; i < 3; i++) {
+    ring.push(100);
+  }
+  CHECK_EQ(5, ring.size());
+  CHECK_EQ(100, ring.median());
+  ring.clear();
+  CHECK_EQ(0, ring.size());
+}
+
+static void testRejectsSpike() {
+  Ring ring;
+  const uint16_t samples[] = {510, 513, 812, 511, 512};
+  for (uint16_t sample : samples) {
+    ring.push(sample);
+  }
+  CHECK_EQ(512, ring.median());
+}
+
+static void testFollowsStepWithinThreeSamples() {
+  Ring ring;
+  for (int i = 0; i < 5; i++) {
+    ring.push(100);
+  }
+  ring.push(900);
+  ring.push(900);
+  CHECK_EQ(100, ring.median());
+  ring.push(900);
+  CHECK_EQ(900, ring.median());
+}
+
+static void testWindowSmallerThanCapacity() {
+  MbitMoreAnalogRing<11> ring;
+  ring.setWindow(3);
+  CHECK_EQ(3, ring.windowSize());
+  const uint16_t samples[] = {7, 1, 4, 9, 9};
+  for (uint16_t sample : samples) {
+    ring.push(sample);
+  }
+  CHECK_EQ(3, ring.size());
+  CHECK_EQ(22, ring.sum());
+  CHECK_EQ(9, ring.median());
+  ring.setWindow(0);
+  CHECK_EQ(11, ring.windowSize());
+  CHECK_EQ(0, ring.size());
+}
+
+template <size_t N>
+static void checkNetworkMatchesSort() {
+  uint32_t seed = 7;
+  for (int trial = 0; trial < 20000; trial++) {
+    uint16_t values[N];
+    uint16_t sorted[N];
+    for (size_t i = 0; i < N; i++) {
+      seed = seed * 1103515245 + 12345;
+      values[i] = (uint16_t)((seed >> 16) % ((trial % 2) ? 8 : 1024)); // with and without ties
+      sorted[i] = values[i];
+    }
+    uint16_t expected = mbitMoreSortMedian(sorted, N);
+    if (MbitMoreMedian<N>::of(values) != expected) {
+      CHECK_EQ(expected, MbitMoreMedian<N>::of(values));
+      return;
+    }
+  }
+}
+
+static void testNetworksMatchSort() {
+  checkNetworkMatchesSort<3>();
+  checkNetworkMatchesSort<5>();
+  checkNetworkMatchesSort<7>();
+  checkNetworkMatchesSort<9>();
+}
+
+/**
+ * @brief Compare converting 5 samples in every read with reading the samples taken in background.
+ * The sampler converts one sample every 10 ms and Scratch reads every 100 ms.
+ */
+static void benchmarkReadPath() {
+  const int reads = 100000;
+  FakeAdc blockingAdc;
+  Ring blocking;
+  long blockingError = 0;
+  HostStopwatch blockingWatch;
+  for (int i = 0; i < reads; i++) {
+    blocking.clear();
+    for (int j = 0; j < 5; j++) {
+      blocking.push(blockingAdc.convert());
+    }
+    int error = (int)blocking.median() - blockingAdc.level;
+    blockingError += error < 0 ? -error : error;
+  }
+  double blockingNs = blockingWatch.elapsedNs() / reads;
+
+  FakeAdc backgroundAdc;
+  Ring background;
+  long backgroundError = 0;
+  uint32_t readConversions = 0;
+  for (int i = 0; i < reads; i++) {
+    for (int tick = 0; tick < 10; tick++) {
+      background.push(backgroundAdc.convert());
+    }
+    uint32_t before = backgroundAdc.conversions;
+    int error = (int)background.median() - backgroundAdc.level;
+    readConversions += backgroundAdc.conversions - before;
+    backgroundError += error < 0 ? -error : error;
+  }
+  volatile uint32_t sink = 0;
+  HostStopwatch backgroundWatch;
+  for (int i = 0; i < reads; i++) {
+    sink = sink + background.median();
+  }
+  double backgroundNs = backgroundWatch.elapsedNs() / reads;
+
+  CHECK_EQ(5 * reads, blockingAdc.conversions);
+  CHECK_EQ(0, readConversions);
+  CHECK(blockingError / reads <= 3);
+  CHECK(backgroundError / reads <= 3);
+  std::printf("  read: blocking %.1f ns + 5 conversions (error %.2f), background %.1f ns + 0 conversions (error %.2f)\n",
+              blockingNs, (double)blockingError / reads, backgroundNs, (double)backgroundError / reads);
+}
+
+int main() {
+  RUN_TEST(testMedianOfPartialRing);
+  RUN_TEST(testOverwritesOldestSample);
+  RUN_TEST(testRejectsSpike);
+  RUN_TEST(testFollowsStepWithinThreeSamples);
+  RUN_TEST(testWindowSmallerThanCapacity);
+  RUN_TEST(testNetworksMatchSort);
+  RUN_TEST(benchmarkReadPath);
+  return hostTestResult();
+}
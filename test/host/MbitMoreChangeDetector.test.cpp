@@ -0,0 +1,92 @@
+#include "HostTest.h"
+
+#include "MbitMoreChangeDetector.h"
+
+static const uint8_t stateFields[] = {FIELD_BITS32, FIELD_U8, FIELD_U8, FIELD_U8};
+static const uint8_t motionFields[] = {FIELD_S16, FIELD_S16, FIELD_S16};
+
+static void testNotifiesFirstPacketAndChanges() {
+  MbitMoreChangeDetector<7> detector(stateFields, sizeof(stateFields));
+  uint8_t packet[7] = {0x01, 0, 0, 0, 100, 150, 0};
+  CHECK(detector.shouldNotify(packet, 0));
+  CHECK(!detector.shouldNotify(packet, 19));
+  packet[3] = 0x08; // button A
+  CHECK(detector.shouldNotify(packet, 38));
+  CHECK(!detector.shouldNotify(packet, 57));
+  packet[4] = 101;
+  CHECK(detector.shouldNotify(packet, 76));
+  CHECK_EQ(3, detector.notified);
+  CHECK_EQ(2, detector.suppressed);
+}
+
+static void testDeadbandSuppressesNoise() {
+  MbitMoreChangeDetector<6> detector(motionFields, sizeof(motionFields));
+  detector.deadband = 20;
+  uint8_t packet[6] = {0};
+  CHECK(detector.shouldNotify(packet, 0));
+  int16_t noise[] = {5, -20, 20, -3, 12};
+  for (size_t i = 0; i < sizeof(noise) / sizeof(noise[0]); i++) {
+    packet[2] = noise[i] & 0xFF;
+    packet[3] = (noise[i] >> 8) & 0xFF;
+    CHECK(!detector.shouldNotify(packet, 19 * (i + 1)));
+  }
+  // -21 from the last notified value crosses the deadband
+  packet[2] = (uint8_t)-21;
+  packet[3] = 0xFF;
+  CHECK(detector.shouldNotify(packet, 200));
+  // The deadband is around the last notified value, so drifting does not accumulate.
+  packet[2] = (uint8_t)-2;
+  CHECK(!detector.shouldNotify(packet, 219));
+  packet[2] = 0;
+  packet[3] = 0;
+  CHECK(detector.shouldNotify(packet, 238));
+}
+
+static void testKeepAliveWithoutChanges() {
+  MbitMoreChangeDetector<7> detector(stateFields, sizeof(stateFields));
+  detector.keepAlive = 100;
+  uint8_t packet[7] = {0};
+  CHECK(detector.shouldNotify(packet, 0xFFFFFFF0UL));
+  CHECK(!detector.shouldNotify(packet, 0xFFFFFFF0UL + 99));
+  CHECK(detector.shouldNotify(packet, 0xFFFFFFF0UL + 100)); // wraps around
+  CHECK(!detector.shouldNotify(packet, 0xFFFFFFF0UL + 150));
+}
+
+static void testDisabledOrResetNotifiesEveryPacket() {
+  MbitMoreChangeDetector<7> detector(stateFields, sizeof(stateFields));
+  uint8_t packet[7] = {0};
+  detector.enabled = false;
+  CHECK(detector.shouldNotify(packet, 0));
+  CHECK(detector.shouldNotify(packet, 19));
+  detector.enabled = true;
+  CHECK(!detector.shouldNotify(packet, 38));
+  detector.reset();
+  CHECK(detector.shouldNotify(packet, 57));
+}
+
+static void benchmarkIdleBoard() {
+  // A board on a desk: light and temperature flicker by one step, buttons are untouched.
+  MbitMoreChangeDetector<7> detector(stateFields, sizeof(stateFields));
+  detector.deadband = 1;
+  uint8_t packet[7] = {0, 0, 0, 0, 120, 150, 0};
+  const int ticks = 60 * 1000 / 19; // a minute of 19 ms updates
+  for (int t = 0; t < ticks; t++) {
+    packet[4] = 120 + (t % 3 == 0);
+    packet[5] = 150 - (t % 7 == 0);
+    if (t == ticks / 2)
+      packet[3] = 0x08;
+    detector.shouldNotify(packet, (unsigned long)t * 19);
+  }
+  CHECK(detector.notified < 70);
+  std::printf("  idle minute: %d samples, %u notified (keep-alive and one button press)\n",
+              ticks, (unsigned)detector.notified);
+}
+
+int main() {
+  RUN_TEST(testNotifiesFirstPacketAndChanges);
+  RUN_TEST(testDeadbandSuppressesNoise);
+  RUN_TEST(testKeepAliveWithoutChanges);
+  RUN_TEST(testDisabledOrResetNotifiesEveryPacket);
+  RUN_TEST(benchmarkIdleBoard);
+  return hostTestResult();
+}
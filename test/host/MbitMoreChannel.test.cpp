@@ -0,0 +1,77 @@
+#include "HostTest.h"
+
+#define MICROBIT_CODAL 1
+#include "MbitMoreChannel.h"
+
+static void testFindsEveryChannelByItsId() {
+  for (int i = 0; i < MM_CH_COUNT; i++) {
+    const MbitMoreChannel *channel = findChannel(mbitMoreChannels[i].id);
+    CHECK(channel == &mbitMoreChannels[i]);
+  }
+  CHECK_EQ(MM_CH_IDX_DATA, findChannel(MM_CH_ID_DATA) - mbitMoreChannels);
+  CHECK_EQ(MM_CH_IDX_TX_QUEUE_STATS, findChannel(0x0141) - mbitMoreChannels);
+}
+
+static void testRejectsUnknownIds() {
+  const uint16_t unknown[] = {0x0000, 0x0103, 0x010F, 0x0112, 0x0123, 0x0132, 0x0145, 0x0150, 0x01F0, 0x0200, 0xFFFF};
+  for (size_t i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++) {
+    CHECK(findChannel(unknown[i]) == NULL);
+  }
+}
+
+static void testBuffersAreDisjoint() {
+  MbitMoreChannelBuffers buffers;
+  CHECK_EQ(10, MM_CH_BLE_COUNT);
+  CHECK(buffers.channelBuffer(mbitMoreChannels[MM_CH_IDX_STATE]) == buffers.stateChBuffer);
+  CHECK(buffers.channelBuffer(mbitMoreChannels[MM_CH_IDX_ANALOG_IN_P2]) == buffers.analogInP2ChBuffer);
+  CHECK(buffers.channelBuffer(mbitMoreChannels[MM_CH_IDX_DATA]) == buffers.dataChBuffer);
+  CHECK(buffers.channelBuffer(mbitMoreChannels[MM_CH_IDX_ACCEL_STREAM]) == buffers.accelStreamChBuffer);
+  size_t total = 0;
+  for (int i = 0; i < MM_CH_BLE_COUNT; i++) {
+    const MbitMoreChannel &channel = mbitMoreChannels[i];
+    CHECK(!(channel.properties & MM_CH_PROP_SERIAL));
+    CHECK(channel.offset + channel.size <= sizeof(buffers));
+    for (int j = i + 1; j < MM_CH_BLE_COUNT; j++) {
+      const MbitMoreChannel &other = mbitMoreChannels[j];
+      CHECK(channel.offset + channel.size <= other.offset || other.offset + other.size <= channel.offset);
+    }
+    total += channel.size;
+  }
+  CHECK_EQ(total, sizeof(buffers));
+  for (int i = MM_CH_BLE_COUNT; i < MM_CH_COUNT; i++) {
+    CHECK(mbitMoreChannels[i].properties & MM_CH_PROP_SERIAL);
+  }
+}
+
+static void benchmarkLookup() {
+  const int rounds = 1000000;
+  volatile uint16_t ids[] = {0x0100, 0x0101, 0x0102, 0x0120, 0x0122, 0x0130, 0x0141, 0x0199};
+  const int count = sizeof(ids) / sizeof(ids[0]);
+  unsigned found = 0;
+  HostStopwatch table;
+  for (int r = 0; r < rounds; r++) {
+    found += (findChannel(ids[r % count]) != NULL);
+  }
+  double tableNs = table.elapsedNs() / rounds;
+  HostStopwatch linear;
+  for (int r = 0; r < rounds; r++) {
+    uint16_t id = ids[r % count];
+    for (int i = 0; i < MM_CH_COUNT; i++) {
+      if (mbitMoreChannels[i].id == id) {
+        found++;
+        break;
+      }
+    }
+  }
+  double linearNs = linear.elapsedNs() / rounds;
+  CHECK_EQ((unsigned)rounds * 7 / 8 * 2, found);
+  std::printf("  lookup: table %.1f ns, linear search %.1f ns\n", tableNs, linearNs);
+}
+
+int main() {
+  RUN_TEST(testFindsEveryChannelByItsId);
+  RUN_TEST(testRejectsUnknownIds);
+  RUN_TEST(testBuffersAreDisjoint);
+  RUN_TEST(benchmarkLookup);
+  return hostTestResult();
+}
@@ -0,0 +1,250 @@
+#include <vector>
+
+#include "HostTest.h"
+
+#include "MbitMoreFrameParser.h"
+
+typedef MbitMoreFrameParser<254> Parser;
+
+static uint32_t randomState = 7;
+
+static uint32_t nextRandom() {
+  randomState = randomState * 1103515245 + 12345;
+  return (randomState >> 16) & 0x7fff;
+}
+
+/**
+ * @brief Encode a request frame in the framing as the host does.
+ */
+static size_t encodeRequest(MbitMoreSerialFraming framing, uint8_t *out, uint8_t type, uint16_t ch, const uint8_t *data, uint8_t len) {
+  if (MbitMoreSerialFraming::FRAMING_COBS == framing) {
+    // A request in COBS framing has the same layout as a response.
+    return encodeResponseCobs(out, type, ch, data, len);
+  }
+  out[0] = MM_SFD;
+  out[1] = type;
+  out[2] = ch >> 8;
+  out[3] = ch & 0xff;
+  out[4] = len;
+  memcpy(&out[5], data, len);
+  out[5 + len] = chksum8(out, 5 + len);
+  return 6 + len;
+}
+
+static void randomCommand(uint8_t *data, uint8_t *len) {
+  *len = 3 + nextRandom() % (MM_SERIAL_PAYLOAD_MAX - 3);
+  for (int i = 0; i < *len; i++) {
+    // Commands often contain 0 and 0xFF as pixel and pin values.
+    uint32_t r = nextRandom() % 4;
+    data[i] = (r == 0) ? 0x00 : (r == 1) ? 0xFF : (uint8_t)nextRandom();
+  }
+}
+
+static void testCrcCheckValue() {
+  const uint8_t check[9] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  CHECK_EQ(0x29B1, crc16(check, sizeof(check)));
+}
+
+static void testCobsRoundTrip() {
+  uint8_t src[253];
+  uint8_t encoded[255];
+  for (int trial = 0; trial < 2000; trial++) {
+    size_t len = nextRandom() % sizeof(src);
+    for (size_t i = 0; i < len; i++) {
+      src[i] = (nextRandom() % 3 == 0) ? 0 : (uint8_t)nextRandom();
+    }
+    size_t encodedLen = cobsEncode(src, len, encoded);
+    CHECK_EQ(len + 1, encodedLen);
+    CHECK(memchr(encoded, MM_COBS_DELIMITER, encodedLen) == NULL);
+    CHECK_EQ((int)len, cobsDecode(encoded, encodedLen));
+    CHECK(memcmp(src, encoded, len) == 0);
+  }
+  uint8_t broken[3] = {5, 1, 2};
+  CHECK_EQ(-1, cobsDecode(broken, sizeof(broken)));
+}
+
+static void testEncodesResponseInPlace() {
+  uint8_t data[MM_SERIAL_RESPONSE_PAYLOAD_MAX];
+  for (int trial = 0; trial < 1000; trial++) {
+    size_t len = nextRandom() % sizeof(data);
+    for (size_t i = 0; i < len; i++) {
+      data[i] = (nextRandom() % 3 == 0) ? 0 : (uint8_t)nextRandom();
+    }
+    // Reference: COBS from a separate buffer
+    uint8_t body[5 + MM_SERIAL_RESPONSE_PAYLOAD_MAX];
+    body[0] = RES_NOTIFY;
+    body[1] = 0x01;
+    body[2] = 0x00;
+    memcpy(&body[3], data, len);
+    uint16_t crc = crc16(body, 3 + len);
+    body[3 + len] = crc >> 8;
+    body[4 + len] = crc & 0xff;
+    uint8_t expected[MM_SERIAL_FRAME_MAX];
+    size_t expectedLen = cobsEncode(body, 5 + len, expected);
+    expected[expectedLen++] = MM_COBS_DELIMITER;
+
+    uint8_t frame[MM_SERIAL_FRAME_MAX];
+    memcpy(&frame[responsePayloadOffset(MbitMoreSerialFraming::FRAMING_COBS)], data, len);
+    size_t frameLen = finishResponse(MbitMoreSerialFraming::FRAMING_COBS, frame, RES_NOTIFY, 0x0100, len);
+    CHECK_EQ(expectedLen, frameLen);
+    CHECK(frameLen <= MM_SERIAL_FRAME_MAX);
+    CHECK(memcmp(expected, frame, frameLen) == 0);
+  }
+}
+
+static void testParsesCobsFramesSplitAcrossChunks() {
+  std::vector<uint8_t> stream;
+  stream.push_back(0x12); // garbage before the first delimiter
+  stream.push_back(MM_COBS_DELIMITER);
+  uint8_t frame[MM_SERIAL_FRAME_MAX];
+  const uint8_t pixels[16] = {0x42, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255};
+  for (int i = 0; i < 10; i++) {
+    size_t len = encodeRequest(MbitMoreSerialFraming::FRAMING_COBS, frame, REQ_WRITE, 0x0100, pixels, sizeof(pixels));
+    stream.insert(stream.end(), frame, frame + len);
+  }
+  // Longer than any request
+  stream.insert(stream.end(), 40, 0x01);
+  stream.push_back(MM_COBS_DELIMITER);
+  size_t len = encodeRequest(MbitMoreSerialFraming::FRAMING_COBS, frame, REQ_READ, 0x0101, NULL, 0);
+  stream.insert(stream.end(), frame, frame + len);
+  stream.push_back(MM_COBS_DELIMITER);
+
+  Parser parser;
+  parser.setFraming(MbitMoreSerialFraming::FRAMING_COBS);
+  MbitMoreSerialFrame parsed;
+  int frames = 0;
+  for (size_t fed = 0; fed < stream.size(); fed += 5) {
+    parser.push(&stream[fed], (stream.size() - fed < 5) ? stream.size() - fed : 5);
+    while (parser.next(parsed)) {
+      frames++;
+      if (frames <= 10) {
+        CHECK_EQ(REQ_WRITE, parsed.type);
+        CHECK_EQ(16, parsed.length);
+        CHECK(memcmp(pixels, parsed.data, 16) == 0);
+      } else {
+        CHECK_EQ(REQ_READ, parsed.type);
+        CHECK_EQ(0x0101, parsed.ch);
+        CHECK_EQ(0, parsed.length);
+      }
+    }
+  }
+  CHECK_EQ(11, frames);
+  CHECK_EQ(2, parser.resyncCount);
+}
+
+/**
+ * @brief Rate of corrupted frames which are accepted as a frame different from the sent one.
+ */
+static double falseAcceptRate(MbitMoreSerialFraming framing, bool transpose, int trials) {
+  int falseAccepts = 0;
+  uint8_t frame[MM_SERIAL_FRAME_MAX];
+  uint8_t data[MM_SERIAL_PAYLOAD_MAX];
+  uint8_t len;
+  for (int trial = 0; trial < trials; trial++) {
+    randomCommand(data, &len);
+    size_t frameSize = encodeRequest(framing, frame, REQ_WRITE, 0x0100, data, len);
+    // Keep the delimiters so that only the errors inside a frame are measured.
+    size_t first = (MbitMoreSerialFraming::FRAMING_COBS == framing) ? 0 : 1;
+    size_t last = (MbitMoreSerialFraming::FRAMING_COBS == framing) ? frameSize - 1 : frameSize;
+    size_t span = last - first;
+    if (transpose) {
+      size_t i = first + nextRandom() % (span - 1);
+      uint8_t swapped = frame[i];
+      frame[i] = frame[i + 1];
+      frame[i + 1] = swapped;
+      if (frame[i] == frame[i + 1])
+        continue;
+    } else {
+      for (int e = 0; e < 2; e++) {
+        size_t i = first + nextRandom() % span;
+        uint8_t value = (uint8_t)nextRandom();
+        if (MbitMoreSerialFraming::FRAMING_COBS == framing && value == MM_COBS_DELIMITER)
+          value = 1;
+        frame[i] = value;
+      }
+    }
+    Parser parser;
+    parser.setFraming(framing);
+    parser.push(frame, frameSize);
+    MbitMoreSerialFrame parsed;
+    while (parser.next(parsed)) {
+      if (parsed.type != REQ_WRITE || parsed.ch != 0x0100 || parsed.length != len || memcmp(parsed.data, data, len) != 0)
+        falseAccepts++;
+    }
+  }
+  return (double)falseAccepts / trials;
+}
+
+static void testCobsRejectsMoreCorruptedFrames() {
+  const int trials = 200000;
+  double sfdSubstitution = falseAcceptRate(MbitMoreSerialFraming::FRAMING_SFD, false, trials);
+  double cobsSubstitution = falseAcceptRate(MbitMoreSerialFraming::FRAMING_COBS, false, trials);
+  double sfdTransposition = falseAcceptRate(MbitMoreSerialFraming::FRAMING_SFD, true, trials);
+  double cobsTransposition = falseAcceptRate(MbitMoreSerialFraming::FRAMING_COBS, true, trials);
+  std::printf("  false accepts, 2 substituted bytes:  chksum8 %.5f  CRC-16 %.5f\n", sfdSubstitution, cobsSubstitution);
+  std::printf("  false accepts, transposed bytes:     chksum8 %.5f  CRC-16 %.5f\n", sfdTransposition, cobsTransposition);
+  CHECK(cobsSubstitution < sfdSubstitution);
+  CHECK(cobsTransposition < sfdTransposition);
+  CHECK(cobsTransposition < 0.001);
+}
+
+static std::vector<uint8_t> commandStream(MbitMoreSerialFraming framing, int frames) {
+  std::vector<uint8_t> stream;
+  uint8_t frame[MM_SERIAL_FRAME_MAX];
+  uint8_t data[MM_SERIAL_PAYLOAD_MAX];
+  uint8_t len;
+  for (int i = 0; i < frames; i++) {
+    randomCommand(data, &len);
+    size_t frameSize = encodeRequest(framing, frame, REQ_WRITE, 0x0100, data, len);
+    stream.insert(stream.end(), frame, frame + frameSize);
+  }
+  return stream;
+}
+
+/**
+ * @brief Compare encoding and decoding speed of both framings.
+ */
+static void benchmarkFramings() {
+  const int frames = 100000;
+  const char *names[2] = {"SFD + chksum8", "COBS + CRC-16"};
+  for (int mode = 0; mode < 2; mode++) {
+    MbitMoreSerialFraming framing = (MbitMoreSerialFraming)mode;
+    uint8_t frame[MM_SERIAL_FRAME_MAX];
+    uint8_t motion[18] = {0};
+    HostStopwatch encodeWatch;
+    size_t encodedBytes = 0;
+    for (int i = 0; i < frames; i++) {
+      motion[i % sizeof(motion)] = (uint8_t)i;
+      encodedBytes += (MbitMoreSerialFraming::FRAMING_COBS == framing)
+                          ? encodeResponseCobs(frame, RES_READ, 0x0102, motion, sizeof(motion))
+                          : encodeResponse(frame, RES_READ, 0x0102, motion, sizeof(motion));
+    }
+    double encodeNs = encodeWatch.elapsedNs();
+
+    std::vector<uint8_t> stream = commandStream(framing, frames);
+    Parser parser;
+    parser.setFraming(framing);
+    MbitMoreSerialFrame parsed;
+    long decoded = 0;
+    HostStopwatch decodeWatch;
+    for (size_t fed = 0; fed < stream.size();) {
+      fed += parser.push(&stream[fed], stream.size() - fed);
+      while (parser.next(parsed))
+        decoded++;
+    }
+    double decodeNs = decodeWatch.elapsedNs();
+    CHECK_EQ(frames, decoded);
+    std::printf("  %-14s encode %6.1f ns/frame (%4.1f bytes)  decode %5.1f ns/byte\n",
+                names[mode], encodeNs / frames, (double)encodedBytes / frames, decodeNs / stream.size());
+  }
+}
+
+int main() {
+  RUN_TEST(testCrcCheckValue);
+  RUN_TEST(testCobsRoundTrip);
+  RUN_TEST(testEncodesResponseInPlace);
+  RUN_TEST(testParsesCobsFramesSplitAcrossChunks);
+  RUN_TEST(testCobsRejectsMoreCorruptedFrames);
+  RUN_TEST(benchmarkFramings);
+  return hostTestResult();
+}
@@ -0,0 +1,177 @@
+#include "HostTest.h"
+
+#include "MbitMoreDisplayFrame.h"
+
+/**
+ * @brief Image of the HAL which counts the writes.
+ */
+class FakeImage {
+public:
+  uint8_t pixels[MM_DISPLAY_SIZE][MM_DISPLAY_SIZE] = {{0}};
+  size_t writes = 0;
+  int setPixelValue(int16_t x, int16_t y, uint8_t value) {
+    pixels[y][x] = value;
+    writes++;
+    return 0;
+  }
+  int getPixelValue(int16_t x, int16_t y) { return pixels[y][x]; }
+};
+
+static void testUnpacks4Bit() {
+  uint8_t packed[MM_DISPLAY_PACKED_4_SIZE] = {0};
+  packed[0] = 0xF0;  // pixel 1 full, pixel 0 off
+  packed[6] = 0x08;  // pixel 12
+  packed[12] = 0x01; // pixel 24
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  mbitMoreUnpackFrame4(packed, pixels);
+  CHECK_EQ(0, pixels[0]);
+  CHECK_EQ(255, pixels[1]);
+  CHECK_EQ(136, pixels[12]);
+  CHECK_EQ(0, pixels[13]);
+  CHECK_EQ(17, pixels[24]);
+}
+
+static void testUnpacks1Bit() {
+  const uint8_t packed[MM_DISPLAY_PACKED_1_SIZE] = {0x11, 0x00, 0x00, 0x01};
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  mbitMoreUnpackFrame1(packed, 200, pixels);
+  CHECK_EQ(200, pixels[0]);
+  CHECK_EQ(0, pixels[1]);
+  CHECK_EQ(200, pixels[4]);
+  CHECK_EQ(200, pixels[24]);
+  CHECK_EQ(0, pixels[23]);
+}
+
+static void testShowsOnlyCompleteFrames() {
+  MbitMoreDisplayFrame frame;
+  FakeImage image;
+  const uint8_t row[MM_DISPLAY_SIZE] = {1, 2, 3, 4, 5};
+  frame.setRow(0, row);
+  frame.setRow(4, row);
+  CHECK_EQ(0, image.pixels[0][0]); // the back buffer is not on the image
+  CHECK_EQ(2 * MM_DISPLAY_SIZE, frame.present(image));
+  CHECK_EQ(3, image.pixels[0][2]);
+  CHECK_EQ(5, image.pixels[4][4]);
+  CHECK_EQ(0, image.pixels[2][2]);
+  frame.setRow(MM_DISPLAY_SIZE, row); // out of the LED
+}
+
+static void testPackedFrameSameAsRows() {
+  uint8_t rows[MM_DISPLAY_SIZE][MM_DISPLAY_SIZE];
+  uint8_t packed[MM_DISPLAY_PACKED_4_SIZE] = {0};
+  for (size_t i = 0; i < MM_DISPLAY_PIXELS; i++) {
+    uint8_t level = (uint8_t)((i * 7) % 16);
+    rows[i / MM_DISPLAY_SIZE][i % MM_DISPLAY_SIZE] = (uint8_t)(level * 17);
+    packed[i / 2] |= (uint8_t)(level << ((i % 2) * 4));
+  }
+  MbitMoreDisplayFrame byRows;
+  FakeImage rowsImage;
+  for (size_t y = 0; y < MM_DISPLAY_SIZE; y++) {
+    byRows.setRow(y, rows[y]);
+  }
+  byRows.present(rowsImage);
+  MbitMoreDisplayFrame byPacked;
+  FakeImage packedImage;
+  CHECK(!byPacked.setPacked4(packed, MM_DISPLAY_PACKED_4_SIZE - 1));
+  CHECK(byPacked.setPacked4(packed, MM_DISPLAY_PACKED_4_SIZE));
+  byPacked.present(packedImage);
+  CHECK(memcmp(rowsImage.pixels, packedImage.pixels, MM_DISPLAY_PIXELS) == 0);
+}
+
+static void testPacked1BitBrightness() {
+  MbitMoreDisplayFrame frame;
+  FakeImage image;
+  const uint8_t packed[MM_DISPLAY_PACKED_1_SIZE + 1] = {0x01, 0, 0, 0, 64};
+  CHECK(!frame.setPacked1(packed, MM_DISPLAY_PACKED_1_SIZE - 1));
+  CHECK(frame.setPacked1(packed, MM_DISPLAY_PACKED_1_SIZE));
+  frame.present(image);
+  CHECK_EQ(255, image.pixels[0][0]);
+  CHECK(frame.setPacked1(packed, sizeof(packed)));
+  frame.present(image);
+  CHECK_EQ(64, image.pixels[0][0]);
+  CHECK_EQ(0, image.pixels[0][1]);
+}
+
+static void testWritesOnlyChangedPixels() {
+  MbitMoreDisplayFrame frame;
+  FakeImage image;
+  CHECK(!frame.isDirty(image)); // blank on blank
+  CHECK_EQ(0, frame.present(image));
+  uint8_t row[MM_DISPLAY_SIZE] = {0, 0, 9, 0, 0};
+  frame.setRow(2, row);
+  CHECK(frame.isDirty(image));
+  CHECK_EQ(1, frame.present(image));
+  CHECK_EQ(9, image.pixels[2][2]);
+  CHECK(!frame.isDirty(image));
+  row[2] = 0;
+  frame.setRow(2, row);
+  row[2] = 9;
+  frame.setRow(2, row); // back to the shown pixels
+  CHECK(!frame.isDirty(image));
+}
+
+static void testOverwritesPixelsDrawnByOthers() {
+  MbitMoreDisplayFrame frame;
+  FakeImage image;
+  const uint8_t row[MM_DISPLAY_SIZE] = {255, 255, 255, 255, 255};
+  frame.setRow(0, row);
+  frame.present(image);
+  image.pixels[0][1] = 0; // user code drew on the LED
+  image.pixels[3][3] = 255;
+  frame.setRow(0, row); // the same frame again
+  CHECK(frame.isDirty(image));
+  CHECK_EQ(2, frame.present(image));
+  CHECK_EQ(255, image.pixels[0][1]);
+  CHECK_EQ(0, image.pixels[3][3]);
+}
+
+/**
+ * @brief Writes of the HAL for each frame of animations, compared with writing all the pixels.
+ */
+static void reportWritesPerFrame() {
+  const char *names[] = {"moving dot", "spinner", "fade", "random"};
+  uint32_t seed = 99;
+  for (int a = 0; a < 4; a++) {
+    MbitMoreDisplayFrame frame;
+    FakeImage image;
+    const int frames = 1000;
+    for (int f = 0; f < frames; f++) {
+      uint8_t packed[MM_DISPLAY_PACKED_4_SIZE] = {0};
+      for (size_t i = 0; i < MM_DISPLAY_PIXELS; i++) {
+        uint8_t level = 0;
+        if (a == 0) {
+          level = (i == (size_t)(f % MM_DISPLAY_PIXELS)) ? 15 : 0;
+        } else if (a == 1) {
+          static const uint8_t ring[8] = {6, 7, 8, 13, 18, 17, 16, 11};
+          level = (i == ring[f % 8] || i == 12) ? 15 : 0;
+        } else if (a == 2) {
+          level = (uint8_t)(f % 16);
+        } else {
+          seed = seed * 1103515245 + 12345;
+          level = (seed >> 16) & 0x0F;
+        }
+        packed[i / 2] |= (uint8_t)(level << ((i % 2) * 4));
+      }
+      frame.setPacked4(packed, sizeof(packed));
+      if (frame.isDirty(image))
+        frame.present(image);
+    }
+    std::printf("  %-10s %5.2f writes/frame (all pixels: %d)\n", names[a], (double)image.writes / frames,
+                MM_DISPLAY_PIXELS);
+    if (a < 2) {
+      CHECK(image.writes <= (size_t)(MM_DISPLAY_PIXELS + frames * 2));
+    }
+  }
+}
+
+int main() {
+  RUN_TEST(testUnpacks4Bit);
+  RUN_TEST(testUnpacks1Bit);
+  RUN_TEST(testShowsOnlyCompleteFrames);
+  RUN_TEST(testPackedFrameSameAsRows);
+  RUN_TEST(testPacked1BitBrightness);
+  RUN_TEST(testWritesOnlyChangedPixels);
+  RUN_TEST(testOverwritesPixelsDrawnByOthers);
+  RUN_TEST(reportWritesPerFrame);
+  return hostTestResult();
+}
@@ -0,0 +1,276 @@
+#include "HostTest.h"
+
+#include "MbitMoreEventQueue.h"
+
+typedef MbitMorePinEventQueue<8> Queue;
+
+static uint32_t read32(const uint8_t *data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static MbitMorePinEventRecord pinEvent(uint8_t pin, uint8_t event, uint32_t timestamp) {
+  MbitMorePinEventRecord e;
+  e.pin = pin;
+  e.event = event;
+  e.timestamp = timestamp;
+  return e;
+}
+
+static void testSingleEventKeepsLegacyLayout() {
+  Queue queue;
+  queue.push(pinEvent(8, 2, 0x12345678));
+  uint8_t packet[19];
+  CHECK_EQ(1, queue.pack(packet, sizeof(packet)));
+  CHECK_EQ(8, packet[0]);
+  CHECK_EQ(2, packet[1]);
+  CHECK_EQ(0x12345678, read32(&packet[2]));
+  queue.sent();
+  CHECK_EQ(0, queue.size());
+  CHECK_EQ(0, queue.pack(packet, sizeof(packet)));
+}
+
+static void testPacksEventsWithDropped() {
+  Queue queue;
+  for (uint32_t i = 0; i < 10; i++) {
+    queue.push(pinEvent(0, (uint8_t)(2 + i % 2), 1000 + i));
+  }
+  CHECK_EQ(8, queue.size());
+  CHECK_EQ(2, queue.dropped);
+  uint8_t packet[19];
+  CHECK_EQ(2, Queue::capacity(sizeof(packet)));
+  CHECK_EQ(2, queue.pack(packet, sizeof(packet)));
+  CHECK_EQ(2, packet[0]);
+  CHECK_EQ(2, packet[1] | (packet[2] << 8));
+  CHECK_EQ(2, packet[4]);
+  CHECK_EQ(1000, read32(&packet[5]));
+  CHECK_EQ(3, packet[10]);
+  CHECK_EQ(1001, read32(&packet[11]));
+  CHECK_EQ(8, queue.size()); // the link was busy
+  queue.sent();
+  uint8_t large[48];
+  CHECK_EQ(6, queue.pack(large, sizeof(large)));
+  CHECK_EQ(1002, read32(&large[5]));
+  CHECK_EQ(1007, read32(&large[3 + 5 * 6 + 2]));
+  queue.sent();
+  CHECK_EQ(0, queue.size());
+}
+
+static void testFlushKeepsEventsOnlyWhileLinkIsFull() {
+  Queue queue;
+  for (uint32_t i = 0; i < 5; i++) {
+    queue.push(pinEvent(0, 2, 1000 + i));
+  }
+  uint8_t packet[19];
+  size_t packets = 0;
+  MbitMoreNotifyResult result = MM_NOTIFY_FULL;
+  auto notify = [&](size_t count) {
+    CHECK(count > 0);
+    packets++;
+    return result;
+  };
+  CHECK(!mbitMoreFlushEvents(queue, packet, sizeof(packet), notify));
+  CHECK_EQ(1, packets);
+  CHECK_EQ(5, queue.size()); // kept for the retry
+  result = MM_NOTIFY_UNSUBSCRIBED;
+  CHECK(mbitMoreFlushEvents(queue, packet, sizeof(packet), notify));
+  CHECK_EQ(0, queue.size()); // discarded, not sent stale on the next subscription
+  queue.push(pinEvent(1, 3, 2000));
+  result = MM_NOTIFY_SENT;
+  packets = 0;
+  CHECK(mbitMoreFlushEvents(queue, packet, sizeof(packet), notify));
+  CHECK_EQ(1, packets);
+  CHECK_EQ(1, packet[0]);
+  CHECK_EQ(2000, read32(&packet[2]));
+  CHECK_EQ(0, queue.size());
+}
+
+static void testWrapsAround() {
+  MbitMoreEventQueue<uint32_t, 4> queue;
+  uint32_t next = 0;
+  uint32_t expected = 0;
+  for (int round = 0; round < 40000; round++) {
+    queue.push(next++);
+    queue.push(next++);
+    for (size_t i = 0; i < 2; i++) {
+      if (queue.peek(i) != expected + i)
+        CHECK_EQ(expected + i, queue.peek(i));
+    }
+    queue.drop(2);
+    expected += 2;
+  }
+  CHECK_EQ(0, queue.size());
+  CHECK_EQ(0, queue.dropped);
+}
+
+static void testNumbersActionsBySource() {
+  MbitMoreActionEventQueue<8> queue;
+  queue.push(MM_ACTION_BUTTON, 1, 1, 100);     // A down
+  queue.push(MM_ACTION_GESTURE, 13, 5, 101);   // face up
+  queue.push(MM_ACTION_BUTTON, 1, 2, 102);     // A up
+  queue.push(MM_ACTION_BUTTON, 2, 1, 103);     // B down
+  queue.push(MM_ACTION_BUTTON, 1, 3, 104);     // A click
+  CHECK_EQ(5, queue.size());
+  const uint8_t expected[] = {0, 0, 1, 0, 2};
+  for (size_t i = 0; i < 5; i++) {
+    CHECK_EQ(expected[i], queue.peek(i).sequence);
+  }
+}
+
+static void testSingleActionKeepsLegacyLayout() {
+  MbitMoreActionEventQueue<8> queue;
+  uint8_t packet[19];
+  queue.push(MM_ACTION_BUTTON, 121, 3, 0x01020304);
+  CHECK_EQ(1, queue.pack(packet, sizeof(packet)));
+  CHECK_EQ(MM_ACTION_BUTTON, packet[0]);
+  CHECK_EQ(121, packet[1] | (packet[2] << 8));
+  CHECK_EQ(3, packet[3]);
+  CHECK_EQ(0x01020304, read32(&packet[4]));
+  CHECK_EQ(0, packet[18]);
+  queue.sent();
+  queue.push(MM_ACTION_GESTURE, 13, 11, 500);
+  queue.push(MM_ACTION_GESTURE, 13, 11, 600);
+  queue.pack(packet, 14); // room for one event
+  CHECK_EQ(MM_ACTION_GESTURE, packet[0]);
+  CHECK_EQ(11, packet[1]);
+  CHECK_EQ(500, read32(&packet[2]));
+  CHECK_EQ(0, packet[13]);
+  queue.sent();
+  queue.pack(packet, sizeof(packet));
+  CHECK_EQ(1, packet[18]); // second shake
+}
+
+static void testBatchesActions() {
+  MbitMoreActionEventQueue<2> queue;
+  queue.push(MM_ACTION_BUTTON, 1, 1, 10);
+  queue.push(MM_ACTION_BUTTON, 1, 2, 20);
+  CHECK(!queue.push(MM_ACTION_BUTTON, 1, 3, 30)); // the click is dropped, its number is skipped
+  uint8_t packet[19];
+  CHECK_EQ(2, MbitMoreActionEventQueue<2>::capacity(sizeof(packet)));
+  CHECK_EQ(2, queue.pack(packet, sizeof(packet)));
+  CHECK_EQ(2, packet[0]);
+  CHECK_EQ(1, packet[1] | (packet[2] << 8));
+  CHECK_EQ(MM_ACTION_BUTTON, packet[3]);
+  CHECK_EQ(1, packet[4]);
+  CHECK_EQ(1, packet[5]);
+  CHECK_EQ(0, packet[6]);
+  CHECK_EQ(10, read32(&packet[7]));
+  CHECK_EQ(2, packet[13]);
+  CHECK_EQ(1, packet[14]);
+  CHECK_EQ(20, read32(&packet[15]));
+  queue.sent();
+  queue.push(MM_ACTION_BUTTON, 1, 4, 40);
+  CHECK_EQ(3, queue.peek(0).sequence);
+}
+
+static void testMasksActions() {
+  MbitMoreActionEventQueue<8> queue;
+  queue.gestureMask = 0;
+  queue.buttonMask = 1 << (3 - 1); // only clicks
+  CHECK(!queue.push(MM_ACTION_GESTURE, 13, 1, 0));
+  CHECK(!queue.push(MM_ACTION_BUTTON, 1, 1, 0));
+  CHECK(queue.push(MM_ACTION_BUTTON, 1, 3, 0));
+  CHECK_EQ(1, queue.size());
+  CHECK_EQ(0, queue.dropped);
+  CHECK_EQ(0, queue.peek(0).sequence); // filtered events are not numbered
+  queue.reset();
+  CHECK(queue.push(MM_ACTION_GESTURE, 13, 1, 0));
+}
+
+static void testFlushDiscardsUnsubscribedActions() {
+  MbitMoreActionEventQueue<8> queue;
+  queue.push(MM_ACTION_BUTTON, 1, 1, 100);
+  queue.push(MM_ACTION_GESTURE, 13, 11, 110);
+  uint8_t packet[19];
+  size_t polls = 0;
+  auto unsubscribed = [&](size_t) {
+    polls++;
+    return MM_NOTIFY_UNSUBSCRIBED;
+  };
+  CHECK(mbitMoreFlushEvents(queue, packet, sizeof(packet), unsubscribed));
+  CHECK_EQ(1, polls); // both events were in one packet
+  CHECK_EQ(0, queue.size());
+  queue.push(MM_ACTION_BUTTON, 1, 2, 200);
+  auto sent = [&](size_t count) {
+    CHECK_EQ(1, count);
+    return MM_NOTIFY_SENT;
+  };
+  CHECK(mbitMoreFlushEvents(queue, packet, sizeof(packet), sent));
+  CHECK_EQ(2, packet[3]);  // the fresh event, not a stale one
+  CHECK_EQ(1, packet[18]); // numbered after the discarded event of the source
+}
+
+/**
+ * @brief Replay edge trains for a second and send them over a link of 20-byte packets,
+ * which takes up to 4 packets in each 7.5 ms connection interval. The transmitter runs every 1 ms.
+ * It is compared with notifying each event from a single buffer, which fails while the link has no room.
+ */
+static void stressEdgeTrains() {
+  const uint32_t rates[] = {1000, 2000, 5000, 10000};
+  for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+    MbitMorePinEventQueue<64> queue;
+    uint8_t packet[19];
+    uint32_t generated = 0;
+    uint32_t delivered = 0;
+    uint32_t packets = 0;
+    uint32_t lastTimestamp = 0;
+    int disorders = 0;
+    uint32_t singleDelivered = 0;
+    uint32_t interval = 1000000 / rates[r];
+    int budget = 0;
+    int singleBudget = 0;
+    for (uint32_t us = 0; us < 1000000; us++) {
+      if (us % interval == 0) {
+        queue.push(pinEvent(0, (uint8_t)(2 + generated % 2), us));
+        generated++;
+        if (singleBudget > 0) {
+          singleDelivered++;
+          singleBudget--;
+        }
+      }
+      if (us % 7500 == 0) {
+        budget = 4;
+        singleBudget = 4;
+      }
+      if (us % 1000 != 0)
+        continue;
+      while (budget > 0) {
+        size_t n = queue.pack(packet, sizeof(packet));
+        if (n == 0)
+          break;
+        for (size_t i = 0; i < n; i++) {
+          uint32_t timestamp = (n == 1) ? read32(&packet[2]) : read32(&packet[3 + i * 6 + 2]);
+          if (delivered > 0 && timestamp <= lastTimestamp)
+            disorders++;
+          lastTimestamp = timestamp;
+          delivered++;
+        }
+        queue.sent();
+        packets++;
+        budget--;
+      }
+    }
+    uint32_t left = (uint32_t)queue.size();
+    std::printf("  %5u Hz: %u events, queue delivered %u in %u packets and dropped %u, single buffer delivered %u\n",
+                (unsigned)rates[r], (unsigned)generated, (unsigned)delivered, (unsigned)packets,
+                (unsigned)queue.dropped, (unsigned)singleDelivered);
+    CHECK_EQ(generated, delivered + queue.dropped + left);
+    CHECK_EQ(0, disorders);
+    if (rates[r] <= 1000) {
+      CHECK_EQ(0, queue.dropped);
+    }
+  }
+}
+
+int main() {
+  RUN_TEST(testSingleEventKeepsLegacyLayout);
+  RUN_TEST(testPacksEventsWithDropped);
+  RUN_TEST(testFlushKeepsEventsOnlyWhileLinkIsFull);
+  RUN_TEST(testWrapsAround);
+  RUN_TEST(testNumbersActionsBySource);
+  RUN_TEST(testSingleActionKeepsLegacyLayout);
+  RUN_TEST(testBatchesActions);
+  RUN_TEST(testMasksActions);
+  RUN_TEST(testFlushDiscardsUnsubscribedActions);
+  RUN_TEST(stressEdgeTrains);
+  return hostTestResult();
+}
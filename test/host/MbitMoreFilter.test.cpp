@@ -0,0 +1,143 @@
+#include "HostTest.h"
+
+#include "MbitMoreFilter.h"
+
+typedef MbitMoreFilterChain<11, 3> Chain;
+
+static void testEmptyChainPassesThrough() {
+  Chain chain;
+  CHECK_EQ(0, chain.size());
+  CHECK(!chain.hasValue());
+  CHECK_EQ(300, chain.push(300));
+  CHECK(chain.hasValue());
+  CHECK_EQ(300, chain.value());
+}
+
+static void testMedianRejectsSpike() {
+  Chain chain;
+  const uint8_t config[] = {MbitMoreFilterKind::FILTER_MEDIAN, 3};
+  CHECK(chain.configure(config, sizeof(config)));
+  chain.push(100);
+  chain.push(101);
+  CHECK_EQ(101, chain.push(900));
+  CHECK_EQ(101, chain.push(99));
+}
+
+static void testBoxcarAveragesWindow() {
+  Chain chain;
+  const uint8_t config[] = {MbitMoreFilterKind::FILTER_BOXCAR, 4};
+  CHECK(chain.configure(config, sizeof(config)));
+  CHECK_EQ(10, chain.push(10)); // average of the samples so far while filling
+  CHECK_EQ(15, chain.push(20));
+  chain.push(30);
+  CHECK_EQ(25, chain.push(40));
+  CHECK_EQ(35, chain.push(50));
+}
+
+static void testEmaConvergesToStep() {
+  Chain chain;
+  const uint8_t config[] = {MbitMoreFilterKind::FILTER_EMA, 2};
+  CHECK(chain.configure(config, sizeof(config)));
+  CHECK_EQ(0, chain.push(0));
+  CHECK_EQ(250, chain.push(1000)); // a quarter of the step
+  uint16_t value = 0;
+  for (int i = 0; i < 40; i++) {
+    value = chain.push(1000);
+  }
+  CHECK_EQ(1000, value);
+}
+
+static void testDeadbandHoldsSmallChanges() {
+  Chain chain;
+  const uint8_t config[] = {MbitMoreFilterKind::FILTER_DEADBAND, 4};
+  CHECK(chain.configure(config, sizeof(config)));
+  CHECK_EQ(500, chain.push(500));
+  CHECK_EQ(500, chain.push(504));
+  CHECK_EQ(500, chain.push(496));
+  CHECK_EQ(505, chain.push(505));
+  CHECK_EQ(505, chain.push(502));
+}
+
+static void testStagesRunInOrder() {
+  Chain chain;
+  const uint8_t config[] = {
+      MbitMoreFilterKind::FILTER_MEDIAN, 3,
+      MbitMoreFilterKind::FILTER_NONE, 0,
+      MbitMoreFilterKind::FILTER_DEADBAND, 10};
+  CHECK(chain.configure(config, sizeof(config)));
+  CHECK_EQ(2, chain.size());
+  chain.push(200);
+  chain.push(205);
+  CHECK_EQ(200, chain.push(1000)); // the spike does not pass the median, the rest is in the deadband
+  CHECK_EQ(200, chain.push(208));
+  chain.push(230);
+  CHECK_EQ(230, chain.push(230));
+}
+
+static void testRejectsInvalidConfig() {
+  Chain chain;
+  const uint8_t valid[] = {MbitMoreFilterKind::FILTER_MEDIAN, 5};
+  CHECK(chain.configure(valid, sizeof(valid)));
+  const uint8_t tooWide[] = {MbitMoreFilterKind::FILTER_BOXCAR, 12};
+  CHECK(!chain.configure(tooWide, sizeof(tooWide)));
+  const uint8_t noShift[] = {MbitMoreFilterKind::FILTER_EMA, 0};
+  CHECK(!chain.configure(noShift, sizeof(noShift)));
+  const uint8_t unknown[] = {9, 1};
+  CHECK(!chain.configure(unknown, sizeof(unknown)));
+  const uint8_t tooMany[] = {1, 3, 1, 3, 1, 3, 1, 3};
+  CHECK(!chain.configure(tooMany, sizeof(tooMany)));
+  CHECK(!chain.configure(valid, 1));
+  CHECK_EQ(1, chain.size()); // the last valid stages are kept
+  CHECK(chain.configure(valid, 0));
+  CHECK_EQ(0, chain.size());
+}
+
+static double nsPerSample(const uint8_t *config, size_t length) {
+  const int samples = 200000;
+  Chain chain;
+  chain.configure(config, length);
+  uint32_t seed = 1;
+  volatile uint32_t sink = 0;
+  HostStopwatch watch;
+  for (int i = 0; i < samples; i++) {
+    seed = seed * 1103515245 + 12345;
+    sink = sink + chain.push((uint16_t)(512 + ((seed >> 16) & 0x0F)));
+  }
+  return watch.elapsedNs() / samples;
+}
+
+/**
+ * @brief Time of each stage per sample, to choose the settings within the cycle budget.
+ * Median of a window without a network uses the insertion sort.
+ */
+static void benchmarkStages() {
+  struct {
+    const char *name;
+    uint8_t config[2];
+  } stages[] = {
+      {"none", {MbitMoreFilterKind::FILTER_NONE, 0}},
+      {"median 3", {MbitMoreFilterKind::FILTER_MEDIAN, 3}},
+      {"median 5", {MbitMoreFilterKind::FILTER_MEDIAN, 5}},
+      {"median 7", {MbitMoreFilterKind::FILTER_MEDIAN, 7}},
+      {"median 9", {MbitMoreFilterKind::FILTER_MEDIAN, 9}},
+      {"median 11", {MbitMoreFilterKind::FILTER_MEDIAN, 11}},
+      {"boxcar 11", {MbitMoreFilterKind::FILTER_BOXCAR, 11}},
+      {"ema 1/8", {MbitMoreFilterKind::FILTER_EMA, 3}},
+      {"deadband 4", {MbitMoreFilterKind::FILTER_DEADBAND, 4}},
+  };
+  for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+    std::printf("  %-10s %.1f ns\n", stages[i].name, nsPerSample(stages[i].config, 2));
+  }
+}
+
+int main() {
+  RUN_TEST(testEmptyChainPassesThrough);
+  RUN_TEST(testMedianRejectsSpike);
+  RUN_TEST(testBoxcarAveragesWindow);
+  RUN_TEST(testEmaConvergesToStep);
+  RUN_TEST(testDeadbandHoldsSmallChanges);
+  RUN_TEST(testStagesRunInOrder);
+  RUN_TEST(testRejectsInvalidConfig);
+  RUN_TEST(benchmarkStages);
+  return hostTestResult();
+}
@@ -0,0 +1,356 @@
+#include <vector>
+
+#include "HostTest.h"
+
+#include "MbitMoreFrameParser.h"
+
+typedef MbitMoreFrameParser<254> Parser;
+
+/**
+ * @brief Append a request frame to the stream as Scratch sends it.
+ */
+static void appendRequest(std::vector<uint8_t> &stream, uint8_t type, uint16_t ch, const uint8_t *data, uint8_t len) {
+  size_t start = stream.size();
+  stream.push_back(MM_SFD);
+  stream.push_back(type);
+  stream.push_back(ch >> 8);
+  stream.push_back(ch & 0xff);
+  if (!requestHasPayload(type))
+    return;
+  stream.push_back(len);
+  stream.insert(stream.end(), data, data + len);
+  stream.push_back(chksum8(&stream[start], stream.size() - start));
+}
+
+/**
+ * @brief Byte stream of a typical session: connect, display and pin commands, analog reads.
+ */
+static std::vector<uint8_t> recordedSession(int repeat) {
+  std::vector<uint8_t> stream;
+  appendRequest(stream, REQ_READ, 0x0100, NULL, 0);
+  const uint8_t pixels0[16] = {0x42, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255};
+  const uint8_t pixels1[11] = {0x43, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255};
+  const uint8_t pinOutput[3] = {0x21, 0, 1};
+  for (int i = 0; i < repeat; i++) {
+    appendRequest(stream, REQ_WRITE, 0x0100, pixels0, sizeof(pixels0));
+    appendRequest(stream, REQ_WRITE_RESPONSE, 0x0100, pixels1, sizeof(pixels1));
+    appendRequest(stream, REQ_WRITE, 0x0100, pinOutput, sizeof(pinOutput));
+    appendRequest(stream, REQ_READ, 0x0120 + (i % 3), NULL, 0);
+  }
+  return stream;
+}
+
+static uint32_t randomState = 1;
+
+static uint32_t nextRandom() {
+  randomState = randomState * 1103515245 + 12345;
+  return (randomState >> 16) & 0x7fff;
+}
+
+/**
+ * @brief Session with bit errors on the line.
+ */
+static std::vector<uint8_t> noisySession(int repeat, int errorPerMille) {
+  std::vector<uint8_t> stream = recordedSession(repeat);
+  for (size_t i = 0; i < stream.size(); i++) {
+    if ((int)(nextRandom() % 1000) < errorPerMille) {
+      stream[i] ^= (uint8_t)(1 << (nextRandom() % 8));
+    }
+  }
+  return stream;
+}
+
+/**
+ * @brief Session interleaved with bursts which are full of SFD, the worst case for resynchronization.
+ */
+static std::vector<uint8_t> sfdBurstSession(int repeat) {
+  std::vector<uint8_t> stream;
+  const uint8_t command[3] = {0x21, 0, 1};
+  for (int i = 0; i < repeat; i++) {
+    for (int j = 0; j < 64; j++) {
+      stream.push_back((j % 3) ? MM_SFD : REQ_WRITE);
+    }
+    appendRequest(stream, REQ_WRITE, 0x0100, command, sizeof(command));
+  }
+  return stream;
+}
+
+/**
+ * @brief Session interleaved with runs of valid headers whose frames never complete,
+ * so that every SFD starts a candidate of the longest frame.
+ */
+static std::vector<uint8_t> brokenHeaderSession(int repeat) {
+  std::vector<uint8_t> stream;
+  const uint8_t header[5] = {MM_SFD, REQ_WRITE, 0x01, 0x00, MM_SERIAL_PAYLOAD_MAX};
+  const uint8_t command[3] = {0x21, 0, 1};
+  for (int i = 0; i < repeat; i++) {
+    for (int j = 0; j < 16; j++) {
+      stream.insert(stream.end(), header, header + sizeof(header));
+    }
+    appendRequest(stream, REQ_WRITE, 0x0100, command, sizeof(command));
+  }
+  return stream;
+}
+
+/**
+ * @brief The parser before the state machine: shift the frame buffer by one byte on every error.
+ */
+static long legacyParse(const std::vector<uint8_t> &stream, std::vector<MbitMoreSerialFrame> *out) {
+  uint8_t frame[26] = {0};
+  size_t frameReceived = 0;
+  size_t pos = 0;
+  long frames = 0;
+  while (true) {
+    while ((frameReceived > 0) && (MM_SFD != frame[0])) {
+      frameReceived--;
+      memmove(frame, frame + 1, frameReceived);
+    }
+    if (frameReceived == 0) {
+      if (pos >= stream.size())
+        return frames;
+      frame[0] = stream[pos++];
+      if (MM_SFD != frame[0])
+        continue;
+      frameReceived = 1;
+    }
+    size_t needed = 4;
+    if (frameReceived >= 2 && requestHasPayload(frame[1]))
+      needed = 5;
+    while (frameReceived < needed) {
+      if (pos >= stream.size())
+        return frames;
+      frame[frameReceived++] = stream[pos++];
+      if (frameReceived == 2 && requestHasPayload(frame[1]))
+        needed = 5;
+    }
+    if (frame[1] > REQ_NOTIFY_START) {
+      frameReceived--;
+      memmove(frame, frame + 1, frameReceived);
+      continue;
+    }
+    MbitMoreSerialFrame parsed;
+    parsed.type = frame[1];
+    parsed.ch = (frame[2] << 8) | frame[3];
+    parsed.length = 0;
+    size_t frameSize = 4;
+    if (requestHasPayload(frame[1])) {
+      if (frame[4] > MM_SERIAL_PAYLOAD_MAX) {
+        frameReceived--;
+        memmove(frame, frame + 1, frameReceived);
+        continue;
+      }
+      frameSize = 5 + frame[4] + 1;
+      while (frameReceived < frameSize) {
+        if (pos >= stream.size())
+          return frames;
+        frame[frameReceived++] = stream[pos++];
+      }
+      if (chksum8(frame, frameSize - 1) != frame[frameSize - 1]) {
+        frameReceived--;
+        memmove(frame, frame + 1, frameReceived);
+        continue;
+      }
+      parsed.length = frame[4];
+      memcpy(parsed.data, &frame[5], parsed.length);
+    }
+    frames++;
+    if (out)
+      out->push_back(parsed);
+    frameReceived -= frameSize;
+    memmove(frame, frame + frameSize, frameReceived);
+  }
+}
+
+/**
+ * @brief Feed the stream in the chunks and take out all frames.
+ */
+static long parseStream(const std::vector<uint8_t> &stream, size_t chunkSize, std::vector<MbitMoreSerialFrame> *out) {
+  Parser parser;
+  MbitMoreSerialFrame frame;
+  long frames = 0;
+  size_t fed = 0;
+  while (fed < stream.size()) {
+    size_t chunk = stream.size() - fed < chunkSize ? stream.size() - fed : chunkSize;
+    fed += parser.push(&stream[fed], chunk);
+    while (parser.next(frame)) {
+      frames++;
+      if (out)
+        out->push_back(frame);
+    }
+  }
+  return frames;
+}
+
+static bool sameFrames(const std::vector<MbitMoreSerialFrame> &a, const std::vector<MbitMoreSerialFrame> &b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].type != b[i].type || a[i].ch != b[i].ch || a[i].length != b[i].length)
+      return false;
+    if (memcmp(a[i].data, b[i].data, a[i].length) != 0)
+      return false;
+  }
+  return true;
+}
+
+static void testRingBufferWrapsAround() {
+  MbitMoreRingBuffer<8> ring;
+  const uint8_t bytes[6] = {1, 2, 3, 4, 5, 6};
+  CHECK_EQ(6, ring.push(bytes, 6));
+  ring.drop(4);
+  CHECK_EQ(6, ring.push(bytes, 6));
+  CHECK_EQ(8, ring.size());
+  CHECK_EQ(0, ring.push(bytes, 1));
+  CHECK_EQ(5, ring.peek(0));
+  CHECK_EQ(1, ring.peek(2));
+  uint8_t out[8];
+  ring.copyOut(0, out, 8);
+  CHECK_EQ(6, out[1]);
+  CHECK_EQ(6, out[7]);
+}
+
+static void testParsesFramesSplitAcrossChunks() {
+  std::vector<uint8_t> stream = recordedSession(3);
+  CHECK_EQ(1 + 3 * 4, parseStream(stream, 1, NULL));
+  CHECK_EQ(1 + 3 * 4, parseStream(stream, 7, NULL));
+}
+
+static void testSkipsGarbageAndBadChecksum() {
+  std::vector<uint8_t> stream;
+  stream.push_back(0x00);
+  stream.push_back(MM_SFD);
+  stream.push_back(0x7f); // not a request type
+  const uint8_t command[3] = {0x21, 0, 1};
+  appendRequest(stream, REQ_WRITE, 0x0100, command, sizeof(command));
+  stream.back() ^= 0x01; // broken checksum
+  appendRequest(stream, REQ_WRITE, 0x0100, command, sizeof(command));
+  Parser parser;
+  parser.push(stream.data(), stream.size());
+  MbitMoreSerialFrame frame;
+  CHECK(parser.next(frame));
+  CHECK_EQ(REQ_WRITE, frame.type);
+  CHECK_EQ(0x0100, frame.ch);
+  CHECK_EQ(3, frame.length);
+  CHECK_EQ(0x21, frame.data[0]);
+  CHECK(!parser.next(frame));
+  CHECK_EQ(0, parser.pendingSize());
+  CHECK_EQ(2, parser.resyncCount);
+}
+
+static void testResyncsOnSfdInsideBrokenFrame() {
+  // A frame which is cut off by the next frame must not hide the next one.
+  std::vector<uint8_t> stream;
+  stream.push_back(MM_SFD);
+  stream.push_back(REQ_WRITE);
+  stream.push_back(0x01);
+  stream.push_back(0x00);
+  stream.push_back(10);
+  appendRequest(stream, REQ_READ, 0x0101, NULL, 0);
+  const uint8_t command[1] = {0x40};
+  appendRequest(stream, REQ_WRITE, 0x0100, command, sizeof(command));
+  std::vector<MbitMoreSerialFrame> parsed;
+  std::vector<MbitMoreSerialFrame> legacy;
+  parseStream(stream, 3, &parsed);
+  legacyParse(stream, &legacy);
+  CHECK(sameFrames(legacy, parsed));
+  CHECK_EQ(2, parsed.size());
+}
+
+static void testParsesNotifyRequests() {
+  std::vector<uint8_t> stream;
+  const uint8_t period[2] = {100, 0};
+  appendRequest(stream, REQ_NOTIFY_START, 0x0120, period, sizeof(period));
+  appendRequest(stream, REQ_NOTIFY_STOP, 0x0101, NULL, 0);
+  std::vector<MbitMoreSerialFrame> parsed;
+  parseStream(stream, 5, &parsed);
+  CHECK_EQ(2, parsed.size());
+  CHECK_EQ(REQ_NOTIFY_START, parsed[0].type);
+  CHECK_EQ(0x0120, parsed[0].ch);
+  CHECK_EQ(2, parsed[0].length);
+  CHECK_EQ(100, parsed[0].data[0]);
+  CHECK_EQ(REQ_NOTIFY_STOP, parsed[1].type);
+  CHECK_EQ(0, parsed[1].length);
+}
+
+static void testParsesBatchReadAndEncodesBatchResponse() {
+  std::vector<uint8_t> stream;
+  const uint8_t channels[6] = {0x01, 0x20, 0x01, 0x21, 0x01, 0x22};
+  appendRequest(stream, REQ_READ_BATCH, 0x0000, channels, sizeof(channels));
+  std::vector<MbitMoreSerialFrame> parsed;
+  parseStream(stream, 4, &parsed);
+  CHECK_EQ(1, parsed.size());
+  CHECK_EQ(REQ_READ_BATCH, parsed[0].type);
+  CHECK_EQ(6, parsed[0].length);
+
+  uint8_t payload[MM_SERIAL_RESPONSE_PAYLOAD_MAX];
+  size_t payloadLen = 0;
+  const uint8_t state[7] = {1, 2, 3, 4, 5, 6, 7};
+  const uint8_t motion[18] = {0};
+  const uint8_t analog[2] = {0x34, 0x12};
+  payloadLen = appendBatchEntry(payload, payloadLen, 0x0101, state, sizeof(state));
+  payloadLen = appendBatchEntry(payload, payloadLen, 0x0102, motion, sizeof(motion));
+  for (int i = 0; i < 3; i++) {
+    payloadLen = appendBatchEntry(payload, payloadLen, 0x0120 + i, analog, sizeof(analog));
+  }
+  CHECK_EQ(3 * 5 + 7 + 18 + 3 * 2, payloadLen);
+  // An entry which does not fit is not appended.
+  CHECK_EQ(payloadLen, appendBatchEntry(payload, payloadLen, 0x0102, motion, sizeof(motion)));
+  CHECK_EQ(0x01, payload[10]);
+  CHECK_EQ(0x02, payload[11]);
+  CHECK_EQ(18, payload[12]);
+
+  uint8_t frame[MM_SERIAL_FRAME_MAX];
+  size_t frameSize = encodeResponse(frame, RES_BATCH, 0x0000, payload, payloadLen);
+  CHECK_EQ(6 + payloadLen, frameSize);
+  CHECK_EQ(payloadLen, frame[4]);
+  CHECK_EQ(chksum8(frame, frameSize - 1), frame[frameSize - 1]);
+}
+
+static void testAcceptsSameFramesAsLegacyParser() {
+  std::vector<uint8_t> corpora[4] = {noisySession(2000, 10), noisySession(2000, 100), sfdBurstSession(500), brokenHeaderSession(500)};
+  for (int i = 0; i < 4; i++) {
+    std::vector<MbitMoreSerialFrame> parsed;
+    std::vector<MbitMoreSerialFrame> legacy;
+    parseStream(corpora[i], 12, &parsed);
+    legacyParse(corpora[i], &legacy);
+    CHECK(sameFrames(legacy, parsed));
+  }
+}
+
+static void benchmark(const char *name, const std::vector<uint8_t> &stream) {
+  const int rounds = 20;
+  long frames = 0;
+  HostStopwatch legacyWatch;
+  for (int i = 0; i < rounds; i++)
+    frames = legacyParse(stream, NULL);
+  double legacyNs = legacyWatch.elapsedNs() / rounds;
+  HostStopwatch parserWatch;
+  for (int i = 0; i < rounds; i++)
+    frames = parseStream(stream, 12, NULL);
+  double parserNs = parserWatch.elapsedNs() / rounds;
+  std::printf("  %-22s %7zu bytes %6ld frames  legacy %6.1f ns/byte  parser %6.1f ns/byte  %.0f frames/s\n",
+              name, stream.size(), frames, legacyNs / stream.size(), parserNs / stream.size(), frames / (parserNs / 1e9));
+}
+
+/**
+ * @brief Compare the parser with the memmove-based one on clean and corrupted streams.
+ */
+static void benchmarkCorpora() {
+  benchmark("clean session", recordedSession(20000));
+  benchmark("1% bit errors", noisySession(20000, 10));
+  benchmark("10% bit errors", noisySession(20000, 100));
+  benchmark("SFD bursts", sfdBurstSession(5000));
+  benchmark("broken headers", brokenHeaderSession(5000));
+}
+
+int main() {
+  RUN_TEST(testRingBufferWrapsAround);
+  RUN_TEST(testParsesFramesSplitAcrossChunks);
+  RUN_TEST(testSkipsGarbageAndBadChecksum);
+  RUN_TEST(testResyncsOnSfdInsideBrokenFrame);
+  RUN_TEST(testParsesNotifyRequests);
+  RUN_TEST(testParsesBatchReadAndEncodesBatchResponse);
+  RUN_TEST(testAcceptsSameFramesAsLegacyParser);
+  RUN_TEST(benchmarkCorpora);
+  return hostTestResult();
+}
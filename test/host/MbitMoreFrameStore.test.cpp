@@ -0,0 +1,114 @@
+#include "HostTest.h"
+
+#include "MbitMoreFrameStore.h"
+
+typedef MbitMoreFrameStore<4> Store;
+
+/**
+ * @brief Frame with a level on all the pixels.
+ */
+static void fillFrame(uint8_t *packed, uint8_t level) {
+  memset(packed, (uint8_t)(level | (level << 4)), MM_DISPLAY_PACKED_4_SIZE);
+}
+
+static void storeFrames(Store &store) {
+  uint8_t packed[MM_DISPLAY_PACKED_4_SIZE];
+  for (size_t i = 0; i < 4; i++) {
+    fillFrame(packed, (uint8_t)(i + 1));
+    CHECK(store.store(i, (uint16_t)(100 * (i + 1)), packed, sizeof(packed)));
+  }
+}
+
+static void testRejectsOutOfStore() {
+  Store store;
+  uint8_t packed[MM_DISPLAY_PACKED_4_SIZE] = {0};
+  CHECK(!store.store(4, 100, packed, sizeof(packed)));
+  CHECK(!store.store(0, 100, packed, sizeof(packed) - 1));
+  CHECK(!store.play(0, 0, false, 0));
+  CHECK(!store.play(2, 3, false, 0));
+  CHECK(!store.play(4, 1, false, 0));
+  CHECK(!store.isPlaying());
+}
+
+static void testPlaysOnceOnTime() {
+  Store store;
+  storeFrames(store);
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  CHECK(store.play(1, 2, false, 1000));
+  CHECK(store.update(1000, pixels));
+  CHECK_EQ(2 * 17, pixels[0]);
+  CHECK_EQ(200, store.waitTime(1000));
+  CHECK(!store.update(1199, pixels));
+  CHECK(store.update(1203, pixels)); // woke up late
+  CHECK_EQ(3 * 17, pixels[24]);
+  CHECK_EQ(297, store.waitTime(1203)); // the lateness is not accumulated
+  CHECK(!store.update(1499, pixels));
+  CHECK(store.isPlaying());
+  CHECK(!store.update(1500, pixels));
+  CHECK(!store.isPlaying());
+}
+
+static void testLoopsAndStops() {
+  Store store;
+  storeFrames(store);
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  CHECK(store.play(0, 2, true, 0));
+  uint32_t shown = 0;
+  for (uint32_t now = 0; now < 3000; now++) {
+    if (store.update(now, pixels)) {
+      CHECK_EQ((shown % 2) ? 34 : 17, pixels[12]);
+      shown++;
+    }
+  }
+  CHECK_EQ(20, shown); // 300 ms for the two frames
+  store.stop();
+  CHECK(!store.update(5000, pixels));
+}
+
+static void testSkipsWhenFarBehind() {
+  Store store;
+  storeFrames(store);
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  store.play(0, 1, true, 0);
+  CHECK(store.update(0, pixels));
+  CHECK(store.update(10000, pixels)); // the fiber was blocked
+  CHECK_EQ(100, store.waitTime(10000));
+  CHECK(!store.update(10050, pixels));
+}
+
+/**
+ * @brief Frame timing when the player wakes up on a 6 ms scheduler tick, as on DAL.
+ */
+static void testTimingOnSchedulerTick() {
+  MbitMoreFrameStore<8> store;
+  uint8_t packed[MM_DISPLAY_PACKED_4_SIZE] = {0};
+  for (size_t i = 0; i < 8; i++) {
+    store.store(i, 33, packed, sizeof(packed));
+  }
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  store.play(0, 8, true, 0);
+  uint32_t now = 0;
+  uint32_t frames = 0;
+  uint32_t worst = 0;
+  while (now < 60000) {
+    if (store.update(now, pixels)) {
+      uint32_t ideal = frames * 33;
+      worst = (now - ideal > worst) ? now - ideal : worst;
+      frames++;
+    }
+    uint32_t wait = store.waitTime(now);
+    now += ((wait + 5) / 6) * 6;
+  }
+  std::printf("  %u frames in 60 s, worst lateness %u ms\n", (unsigned)frames, (unsigned)worst);
+  CHECK(worst < 6);
+  CHECK(frames >= 60000 / 33);
+}
+
+int main() {
+  RUN_TEST(testRejectsOutOfStore);
+  RUN_TEST(testPlaysOnceOnTime);
+  RUN_TEST(testLoopsAndStops);
+  RUN_TEST(testSkipsWhenFarBehind);
+  RUN_TEST(testTimingOnSchedulerTick);
+  return hostTestResult();
+}
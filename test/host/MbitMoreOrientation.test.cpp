@@ -0,0 +1,104 @@
+#include "HostTest.h"
+
+#include <cmath>
+
+#include "MbitMoreOrientation.h"
+
+/**
+ * @brief Float reference: pitch and roll as CODAL computes them, heading by the usual tilt compensation.
+ */
+struct FloatOrientation {
+  double pitch;
+  double roll;
+  double heading;
+
+  FloatOrientation(double x, double y, double z, double mx, double my, double mz) {
+    roll = atan2(x, -z);
+    pitch = atan2(y, (x * sin(roll) - z * cos(roll)));
+    if (z > 0.0) {
+      double reference = pitch > 0.0 ? (M_PI / 2.0) : (-M_PI / 2.0);
+      pitch = reference + (reference - pitch);
+    }
+    // Forward, right and down of the board.
+    double gx = y, gy = x, gz = -z;
+    double bx = my, by = mx, bz = -mz;
+    double phi = atan2(gy, gz);
+    double theta = atan(-gx / (gy * sin(phi) + gz * cos(phi)));
+    double north = bx * cos(theta) + by * sin(theta) * sin(phi) + bz * sin(theta) * cos(phi);
+    double left = bz * sin(phi) - by * cos(phi);
+    heading = atan2(left, north) * 180.0 / M_PI;
+    if (heading < 0)
+      heading += 360.0;
+  }
+};
+
+static double angleError(double a, double b, double turn) {
+  double diff = fabs(a - b);
+  return (diff > turn / 2) ? turn - diff : diff;
+}
+
+static void testAtan2OfAxes() {
+  uint32_t magnitude = 0;
+  CHECK_EQ(0, mbitMoreAngleToMilliradians(mbitMoreAtan2(0, 1000, &magnitude)));
+  CHECK_EQ(1000, magnitude);
+  CHECK_EQ(1571, mbitMoreAngleToMilliradians(mbitMoreAtan2(5, 0)));
+  CHECK_EQ(180, mbitMoreAngleToDegrees(mbitMoreAtan2(0, -3)));
+  CHECK_EQ(-1571, mbitMoreAngleToMilliradians(mbitMoreAtan2(-(1LL << 40), 0)));
+  CHECK_EQ(0, mbitMoreAtan2(0, 0, &magnitude));
+  CHECK_EQ(0, magnitude);
+  mbitMoreAtan2(-1024, 768, &magnitude);
+  CHECK_EQ(1280, magnitude);
+  CHECK_EQ(3142, mbitMoreAngleToMilliradians(MM_ANGLE_TURN / 2));
+  CHECK_EQ(-1571, mbitMoreAngleToMilliradians(-MM_ANGLE_TURN / 4));
+  CHECK_EQ(270, mbitMoreAngleToDegrees(-MM_ANGLE_TURN / 4));
+  CHECK_EQ(0, mbitMoreAngleToDegrees(MM_ANGLE_TURN - 1));
+}
+
+static void testFlatBoardHeading() {
+  MbitMoreOrientation orientation;
+  orientation.update(0, 0, -1024);
+  CHECK_EQ(0, orientation.pitch());
+  CHECK_EQ(0, orientation.roll());
+  CHECK_EQ(0, orientation.heading(0, 30000, -40000));   // logo to the north
+  CHECK_EQ(90, orientation.heading(-30000, 0, -40000)); // north is on the left
+  CHECK_EQ(180, orientation.heading(0, -30000, -40000));
+  CHECK_EQ(270, orientation.heading(30000, 0, -40000));
+}
+
+/**
+ * @brief Compare with the float reference on random orientations and fields, including face down.
+ */
+static void testMatchesFloatReference() {
+  uint32_t seed = 12345;
+  double pitchError = 0, rollError = 0, headingError = 0;
+  for (int i = 0; i < 100000; i++) {
+    int32_t v[6];
+    for (int j = 0; j < 6; j++) {
+      seed = seed * 1103515245 + 12345;
+      int32_t range = (j < 3) ? 2048 : 60000;
+      v[j] = (int32_t)((seed >> 8) % (2 * range)) - range;
+    }
+    if (v[0] == 0 && v[2] == 0)
+      continue;
+    FloatOrientation reference(v[0], v[1], v[2], v[3], v[4], v[5]);
+    MbitMoreOrientation orientation;
+    orientation.update(v[0], v[1], v[2]);
+    double e = angleError(orientation.pitch(), reference.pitch * 1000, 2000 * M_PI);
+    pitchError = e > pitchError ? e : pitchError;
+    e = angleError(orientation.roll(), reference.roll * 1000, 2000 * M_PI);
+    rollError = e > rollError ? e : rollError;
+    e = angleError(orientation.heading(v[3], v[4], v[5]), reference.heading, 360);
+    headingError = e > headingError ? e : headingError;
+  }
+  std::printf("  max error: pitch %.2f mrad, roll %.2f mrad, heading %.2f degree\n", pitchError, rollError, headingError);
+  CHECK(pitchError <= 1.0);
+  CHECK(rollError <= 1.0);
+  CHECK(headingError <= 1.0);
+}
+
+int main() {
+  RUN_TEST(testAtan2OfAxes);
+  RUN_TEST(testFlatBoardHeading);
+  RUN_TEST(testMatchesFloatReference);
+  return hostTestResult();
+}
@@ -0,0 +1,129 @@
+#include "HostTest.h"
+
+#include "MbitMorePinPort.h"
+
+static const uint8_t gpioPin[9] = {0, 1, 2, 8, 12, 13, 14, 15, 16};
+
+// Pins in the ports of the edge pins in gpioPin, as named by the runtime.
+static const int portPinV1[9] = {3, 2, 1, 18, 20, 23, 22, 21, 16};
+static const int portPinV2[9] = {2, 3, 4, 10, 12, 17, 1, 13, 32 + 2};
+
+static uint32_t portIn[MM_PIN_PORT_COUNT];
+
+/**
+ * @brief Pin of the HAL on the simulated ports, which is called through the vtable as MicroBitPin.
+ */
+class FakePin {
+public:
+  enum Mode { DIGITAL_IN, DIGITAL_OUT, ANALOG_IN, ANALOG_OUT, TOUCH };
+  Mode mode = DIGITAL_IN;
+  int name = 0;
+  virtual ~FakePin() {}
+  virtual int isDigital() { return mode == DIGITAL_IN || mode == DIGITAL_OUT; }
+  virtual int isInput() { return mode == DIGITAL_IN || mode == ANALOG_IN || mode == TOUCH; }
+  virtual int getDigitalValue() {
+    mode = DIGITAL_IN;
+    return (portIn[name / 32] >> (name % 32)) & 1;
+  }
+};
+
+static FakePin pins[17];
+
+static void setUpPins(const int *portPin) {
+  for (size_t i = 0; i < 9; i++) {
+    pins[gpioPin[i]].name = portPin[i];
+    pins[gpioPin[i]].mode = FakePin::DIGITAL_IN;
+  }
+}
+
+static void testGroupsPinsBySameShift() {
+  MbitMorePinPort<9> port;
+  CHECK(port.configure(gpioPin, portPinV2));
+  for (size_t i = 0; i < 9; i++) {
+    port.setInput(gpioPin[i], true);
+  }
+  CHECK_EQ(0x1F107, port.inputs());
+  uint32_t in[MM_PIN_PORT_COUNT] = {1UL << 17, 1UL << 2};
+  CHECK_EQ((1UL << 13) | (1UL << 16), port.levels(in));
+  port.setInput(16, false);
+  port.setInput(5, true); // not a GPIO
+  CHECK_EQ((1UL << 13), port.levels(in));
+  CHECK_EQ(0x0F107, port.inputs());
+}
+
+static void testFallsBackOutOfPorts() {
+  MbitMorePinPort<9> port;
+  int portPin[9];
+  for (size_t i = 0; i < 9; i++) {
+    portPin[i] = portPinV2[i];
+  }
+  portPin[8] = 0xFF; // NC
+  CHECK(!port.configure(gpioPin, portPin));
+  CHECK(!port.isReady());
+}
+
+/**
+ * @brief The levels from the ports are the same as the HAL on random levels and modes of the pins.
+ */
+static void checkSameAsHal(const int *portPin) {
+  setUpPins(portPin);
+  MbitMorePinPort<9> port;
+  CHECK(port.configure(gpioPin, portPin));
+  for (size_t i = 0; i < 9; i++) {
+    port.setInput(gpioPin[i], pins[gpioPin[i]].isDigital() && pins[gpioPin[i]].isInput());
+  }
+  uint32_t seed = 7;
+  int mismatches = 0;
+  for (int round = 0; round < 10000; round++) {
+    for (size_t p = 0; p < MM_PIN_PORT_COUNT; p++) {
+      seed = seed * 1103515245 + 12345;
+      portIn[p] = seed ^ (seed << 13);
+    }
+    seed = seed * 1103515245 + 12345;
+    size_t i = (seed >> 8) % 9;
+    pins[gpioPin[i]].mode = (FakePin::Mode)((seed >> 16) % 5);
+    port.setInput(gpioPin[i], pins[gpioPin[i]].isDigital() && pins[gpioPin[i]].isInput());
+    uint32_t fast = port.levels(portIn);
+    uint32_t hal = mbitMoreReadPinLevels(pins, gpioPin, 9);
+    if (fast != hal)
+      mismatches++;
+  }
+  CHECK_EQ(0, mismatches);
+}
+
+static void testSameAsHalOnV1() { checkSameAsHal(portPinV1); }
+
+static void testSameAsHalOnV2() { checkSameAsHal(portPinV2); }
+
+static void benchmarkRead() {
+  const int rounds = 1000000;
+  setUpPins(portPinV2);
+  MbitMorePinPort<9> port;
+  port.configure(gpioPin, portPinV2);
+  for (size_t i = 0; i < 9; i++) {
+    port.setInput(gpioPin[i], true);
+  }
+  volatile uint32_t sink = 0;
+  HostStopwatch halWatch;
+  for (int i = 0; i < rounds; i++) {
+    portIn[0] = (uint32_t)i;
+    sink = sink + mbitMoreReadPinLevels(pins, gpioPin, 9);
+  }
+  double halNs = halWatch.elapsedNs() / rounds;
+  HostStopwatch portWatch;
+  for (int i = 0; i < rounds; i++) {
+    portIn[0] = (uint32_t)i;
+    sink = sink + port.levels(portIn);
+  }
+  double portNs = portWatch.elapsedNs() / rounds;
+  std::printf("  read 9 pins: HAL %.1f ns, port %.1f ns\n", halNs, portNs);
+}
+
+int main() {
+  RUN_TEST(testGroupsPinsBySameShift);
+  RUN_TEST(testFallsBackOutOfPorts);
+  RUN_TEST(testSameAsHalOnV1);
+  RUN_TEST(testSameAsHalOnV2);
+  RUN_TEST(benchmarkRead);
+  return hostTestResult();
+}
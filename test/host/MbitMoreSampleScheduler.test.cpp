@@ -0,0 +1,101 @@
+#include "HostTest.h"
+
+#include "MbitMoreSampleScheduler.h"
+
+typedef MbitMoreSampleScheduler<3> Scheduler;
+
+static void testEachSensorHasItsOwnPeriod() {
+  Scheduler scheduler;
+  scheduler.setPeriod(0, 10, 0);
+  scheduler.setPeriod(1, 20, 0);
+  scheduler.setPeriod(2, 1000, 0);
+  uint32_t counts[3] = {0};
+  for (unsigned long now = 0; now < 2000; now++) {
+    for (size_t i = 0; i < 3; i++) {
+      if (scheduler.isDue(i, now)) {
+        scheduler.sampled(i, now, 50);
+        counts[i]++;
+      }
+    }
+  }
+  CHECK_EQ(200, counts[0]);
+  CHECK_EQ(100, counts[1]);
+  CHECK_EQ(2, counts[2]);
+  CHECK_EQ(200, scheduler.count(0));
+  CHECK_EQ(50, scheduler.averageTime(0));
+}
+
+static void testSkipsPassedDeadlinesWithoutDrift() {
+  Scheduler scheduler;
+  scheduler.setPeriod(0, 10, 0);
+  CHECK(scheduler.isDue(0, 0));
+  scheduler.sampled(0, 0, 0);
+  // A slow sample of another sensor delayed this one for 35 ms.
+  CHECK(scheduler.isDue(0, 35));
+  scheduler.sampled(0, 35, 0);
+  CHECK(!scheduler.isDue(0, 39));
+  CHECK(scheduler.isDue(0, 40));
+  CHECK_EQ(5, scheduler.sleepTime(35, 100));
+}
+
+static void testStoppedSensorIsNotSampled() {
+  Scheduler scheduler;
+  scheduler.setPeriod(0, 0, 0);
+  scheduler.setPeriod(1, 2, 0);
+  CHECK(!scheduler.isDue(0, 1000));
+  CHECK_EQ(MM_SAMPLE_PERIOD_MIN, scheduler.period(1));
+  CHECK_EQ(0, scheduler.sleepTime(0, 100)); // sensor 1 is due now
+  scheduler.sampled(1, 0, 0);
+  CHECK_EQ(MM_SAMPLE_PERIOD_MIN, scheduler.sleepTime(0, 100));
+  scheduler.setPeriod(1, 0, 0);
+  CHECK_EQ(100, scheduler.sleepTime(0, 100));
+}
+
+static void testAverageTimeFollowsRecentSamples() {
+  Scheduler scheduler;
+  scheduler.setPeriod(0, 10, 0);
+  scheduler.sampled(0, 0, 800);
+  CHECK_EQ(800, scheduler.averageTime(0));
+  for (int i = 0; i < 40; i++) {
+    scheduler.sampled(0, 10 * (i + 1), 100);
+  }
+  CHECK(scheduler.averageTime(0) < 110);
+  scheduler.sampled(0, 500, 1000000); // capped
+  CHECK(scheduler.averageTime(0) < 0x2000 + 110);
+}
+
+static void benchmarkSamplingLoad() {
+  // Sample cost per second with one 19 ms cadence for all, and with the default periods.
+  const uint16_t costUs[6] = {30, 120, 250, 60, 400, 600}; // digital, light, temperature, sound, accel, compass
+  const uint16_t periods[6] = {10, 20, 1000, 20, 20, 20};
+  MbitMoreSampleScheduler<6> scheduler;
+  for (size_t i = 0; i < 6; i++) {
+    scheduler.setPeriod(i, periods[i], 0);
+  }
+  unsigned long scheduledUs = 0;
+  for (unsigned long now = 0; now < 1000; now++) {
+    for (size_t i = 0; i < 6; i++) {
+      if (scheduler.isDue(i, now)) {
+        scheduler.sampled(i, now, costUs[i]);
+        scheduledUs += costUs[i];
+      }
+    }
+  }
+  unsigned long blindUs = 0;
+  for (unsigned long now = 0; now < 1000; now += 19) {
+    for (size_t i = 0; i < 6; i++) {
+      blindUs += costUs[i];
+    }
+  }
+  CHECK(scheduledUs < blindUs);
+  std::printf("  modelled sampling time per second: every 19 ms %lu us, scheduled %lu us\n", blindUs, scheduledUs);
+}
+
+int main() {
+  RUN_TEST(testEachSensorHasItsOwnPeriod);
+  RUN_TEST(testSkipsPassedDeadlinesWithoutDrift);
+  RUN_TEST(testStoppedSensorIsNotSampled);
+  RUN_TEST(testAverageTimeFollowsRecentSamples);
+  RUN_TEST(benchmarkSamplingLoad);
+  return hostTestResult();
+}
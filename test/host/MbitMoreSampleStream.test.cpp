@@ -0,0 +1,136 @@
+#include "HostTest.h"
+
+#include "MbitMoreSampleStream.h"
+
+typedef MbitMoreSampleStream<8> Stream;
+
+static int read16(const uint8_t *data) { return (int16_t)(data[0] | (data[1] << 8)); }
+
+static void testPacksSamplesWithTime() {
+  Stream stream;
+  stream.push(70000, 100, -200, 1024);
+  stream.push(70003, -1, 0, 32767);
+  uint8_t packet[20];
+  CHECK_EQ(2, Stream::capacity(sizeof(packet)));
+  CHECK_EQ(MM_STREAM_HEADER_SIZE + 2 * MM_STREAM_SAMPLE_SIZE, stream.pack(packet, sizeof(packet)));
+  CHECK_EQ(0, packet[0]);                     // sequence
+  CHECK_EQ(2, packet[1]);                     // count
+  CHECK_EQ(0, read16(&packet[2]));            // overflows
+  CHECK_EQ(70000 & 0xFFFF, (uint16_t)read16(&packet[4]));
+  CHECK_EQ(0, packet[6]);                     // first sample is at the time in the header
+  CHECK_EQ(100, read16(&packet[7]));
+  CHECK_EQ(-200, read16(&packet[9]));
+  CHECK_EQ(1024, read16(&packet[11]));
+  CHECK_EQ(3, packet[13]);                    // 3 ms after the first
+  CHECK_EQ(-1, read16(&packet[14]));
+  CHECK_EQ(32767, read16(&packet[18]));
+}
+
+static void testKeepsSamplesUntilSent() {
+  Stream stream;
+  for (uint32_t t = 0; t < 5; t++) {
+    stream.push(t * 10, (int16_t)t, 0, 0);
+  }
+  uint8_t packet[20];
+  stream.pack(packet, sizeof(packet));
+  CHECK_EQ(5, stream.size()); // the link was busy
+  CHECK_EQ(0, read16(&packet[7]));
+  stream.pack(packet, sizeof(packet));
+  stream.sent();
+  CHECK_EQ(3, stream.size());
+  CHECK_EQ(20, stream.oldestTime());
+  stream.pack(packet, sizeof(packet));
+  CHECK_EQ(1, packet[0]);
+  CHECK_EQ(2, read16(&packet[7]));
+  stream.sent();
+  CHECK_EQ(MM_STREAM_HEADER_SIZE + MM_STREAM_SAMPLE_SIZE, stream.pack(packet, sizeof(packet))); // the last one
+  CHECK_EQ(1, packet[1]);
+  stream.sent();
+  CHECK_EQ(0, stream.pack(packet, sizeof(packet)));
+}
+
+static void testCountsOverflows() {
+  Stream stream;
+  for (uint32_t t = 0; t < 11; t++) {
+    stream.push(t, 0, 0, 0);
+  }
+  CHECK_EQ(8, stream.size());
+  CHECK_EQ(8, stream.captured);
+  CHECK_EQ(3, stream.overflows);
+  uint8_t packet[MM_STREAM_HEADER_SIZE + 8 * MM_STREAM_SAMPLE_SIZE];
+  stream.pack(packet, sizeof(packet));
+  CHECK_EQ(8, packet[1]);
+  CHECK_EQ(3, read16(&packet[2]));
+  stream.sent();
+  stream.reset();
+  CHECK_EQ(0, stream.overflows);
+  CHECK_EQ(0, stream.size());
+}
+
+static void testWrapsAround() {
+  Stream stream;
+  uint8_t packet[MM_STREAM_HEADER_SIZE + 3 * MM_STREAM_SAMPLE_SIZE];
+  int16_t next = 0;
+  int16_t expected = 0;
+  for (int round = 0; round < 10; round++) {
+    for (int i = 0; i < 3; i++) {
+      stream.push(round * 30 + i * 10, next++, 0, 0);
+    }
+    stream.pack(packet, sizeof(packet));
+    for (int i = 0; i < 3; i++) {
+      CHECK_EQ(expected++, read16(&packet[MM_STREAM_HEADER_SIZE + i * MM_STREAM_SAMPLE_SIZE + 1]));
+    }
+    stream.sent();
+  }
+  CHECK_EQ(0, stream.overflows);
+}
+
+static void testTooSmallPacketCarriesNothing() {
+  Stream stream;
+  stream.push(0, 0, 0, 0);
+  uint8_t packet[MM_STREAM_HEADER_SIZE + MM_STREAM_SAMPLE_SIZE - 1];
+  CHECK_EQ(0, Stream::capacity(sizeof(packet)));
+  CHECK_EQ(0, stream.pack(packet, sizeof(packet)));
+  stream.sent();
+  CHECK_EQ(1, stream.size());
+}
+
+/**
+ * @brief Stream 400 Hz for a second to a link which takes a packet every 7.5 ms connection interval
+ * and is busy for 100 ms in the middle.
+ */
+static void benchmarkBusyLink() {
+  MbitMoreSampleStream<128> stream;
+  uint8_t packet[244];
+  uint32_t packets = 0;
+  const size_t sizes[] = {20, 48, 244};
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    stream.reset();
+    packets = 0;
+    for (uint32_t us = 0; us < 1000000; us += 500) {
+      if (us % 2500 == 0) {
+        stream.push(us / 1000, 0, 0, 0);
+      }
+      bool busy = (us >= 400000 && us < 500000);
+      if (!busy && us % 7500 == 0 && stream.pack(packet, sizes[s]) > 0) {
+        stream.sent();
+        packets++;
+      }
+    }
+    std::printf("  packet %3u bytes: %u samples captured, %u overflowed, %u packets\n",
+                (unsigned)sizes[s], (unsigned)stream.captured, (unsigned)stream.overflows, (unsigned)packets);
+    if (sizes[s] >= 48) {
+      CHECK_EQ(0, stream.overflows);
+    }
+  }
+}
+
+int main() {
+  RUN_TEST(testPacksSamplesWithTime);
+  RUN_TEST(testKeepsSamplesUntilSent);
+  RUN_TEST(testCountsOverflows);
+  RUN_TEST(testWrapsAround);
+  RUN_TEST(testTooSmallPacketCarriesNothing);
+  RUN_TEST(benchmarkBusyLink);
+  return hostTestResult();
+}
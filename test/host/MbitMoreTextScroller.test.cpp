@@ -0,0 +1,124 @@
+#include "HostTest.h"
+
+#include "MbitMoreTextScroller.h"
+
+// Glyphs of the test font: 'I' is the middle column, '-' is the middle row, others have no glyph.
+static const uint8_t glyphI[MM_DISPLAY_SIZE] = {0x04, 0x04, 0x04, 0x04, 0x04};
+static const uint8_t glyphBar[MM_DISPLAY_SIZE] = {0x00, 0x00, 0x1F, 0x00, 0x00};
+static int glyphCalls = 0;
+
+static const uint8_t *testGlyph(char c) {
+  glyphCalls++;
+  if (c == 'I')
+    return glyphI;
+  if (c == '-')
+    return glyphBar;
+  return NULL;
+}
+
+typedef MbitMoreTextScroller<4> Scroller;
+
+/**
+ * @brief Columns which are lit in the frame, as bits from the left column.
+ */
+static uint8_t litColumns(const uint8_t *pixels) {
+  uint8_t lit = 0;
+  for (size_t i = 0; i < MM_DISPLAY_PIXELS; i++) {
+    if (pixels[i])
+      lit |= (uint8_t)(1 << (i % MM_DISPLAY_SIZE));
+  }
+  return lit;
+}
+
+static void testGlyphColumns() {
+  uint8_t columns[MM_GLYPH_WIDTH];
+  mbitMoreGlyphColumns(glyphBar, columns);
+  for (size_t x = 0; x < MM_GLYPH_WIDTH; x++) {
+    CHECK_EQ(0x04, columns[x]);
+  }
+  mbitMoreGlyphColumns(glyphI, columns);
+  CHECK_EQ(0, columns[1]);
+  CHECK_EQ(0x1F, columns[2]);
+  mbitMoreGlyphColumns(NULL, columns);
+  CHECK_EQ(0, columns[2]);
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  mbitMoreGlyphPixels(glyphI, pixels);
+  CHECK_EQ(0x04, litColumns(pixels));
+}
+
+static void testScrollsInAndOut() {
+  Scroller scroller(testGlyph);
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  scroller.start(100, 0);
+  CHECK_EQ(1, scroller.append("I", 5));
+  // The middle column of 'I' enters from the right edge at the third step.
+  const uint8_t expected[] = {0x00, 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00, 0x00, 0x00};
+  size_t steps = 0;
+  for (uint32_t now = 0; now < 2000; now += 10) {
+    if (scroller.update(now, pixels)) {
+      CHECK_EQ(expected[steps], litColumns(pixels));
+      CHECK_EQ(now, steps * 100);
+      steps++;
+    }
+  }
+  CHECK_EQ(sizeof(expected), steps); // 4 blank, 6 columns of the glyph and its space
+  CHECK(!scroller.isPlaying());
+}
+
+static void testAppendsWithoutRestart() {
+  Scroller scroller(testGlyph);
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  scroller.start(1, 0);
+  scroller.append("I", 1);
+  uint32_t now = 0;
+  for (int i = 0; i < 7; i++) {
+    scroller.update(now++, pixels);
+  }
+  CHECK_EQ(0x01, litColumns(pixels));
+  glyphCalls = 0;
+  CHECK_EQ(2, scroller.append("I-\0I", 4));
+  CHECK_EQ(2, glyphCalls);
+  scroller.update(now++, pixels);
+  CHECK_EQ(0x00, litColumns(pixels)); // the scroll continues from the place
+  glyphCalls = 0;
+  size_t steps = 1;
+  while (scroller.update(now++, pixels)) {
+    steps++;
+  }
+  CHECK_EQ(0, glyphCalls); // the glyphs are not looked up again while scrolling
+  CHECK_EQ(MM_TEXT_LEAD + 3 * MM_GLYPH_STRIDE, 7 + steps);
+}
+
+static void testStreamsLongerThanBuffer() {
+  Scroller scroller(testGlyph);
+  uint8_t pixels[MM_DISPLAY_PIXELS];
+  scroller.start(1, 0);
+  const char *text = "I-I-I-I-I-I-I-I-I-I-";
+  size_t length = strlen(text);
+  size_t sent = scroller.append(text, length);
+  CHECK_EQ(4, sent); // the buffer is full
+  uint32_t now = 0;
+  uint32_t bars = 0;
+  bool wasBar = false;
+  while (scroller.isPlaying()) {
+    if (sent < length) {
+      sent += scroller.append(&text[sent], length - sent);
+    }
+    scroller.update(now++, pixels);
+    bool bar = litColumns(pixels) == 0x1F;
+    if (bar && !wasBar)
+      bars++;
+    wasBar = bar;
+  }
+  CHECK_EQ(length, sent);
+  CHECK_EQ(10, bars);
+  CHECK_EQ(0, scroller.size());
+}
+
+int main() {
+  RUN_TEST(testGlyphColumns);
+  RUN_TEST(testScrollsInAndOut);
+  RUN_TEST(testAppendsWithoutRestart);
+  RUN_TEST(testStreamsLongerThanBuffer);
+  return hostTestResult();
+}
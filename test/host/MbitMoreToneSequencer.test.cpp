@@ -0,0 +1,104 @@
+#include "HostTest.h"
+
+#include "MbitMoreToneSequencer.h"
+
+typedef MbitMoreToneSequencer<4> Sequencer;
+
+static size_t packNote(uint8_t *data, uint16_t period, uint8_t volume, uint16_t duration) {
+  data[0] = period & 0xFF;
+  data[1] = (period >> 8) & 0xFF;
+  data[2] = volume;
+  data[3] = duration & 0xFF;
+  data[4] = (duration >> 8) & 0xFF;
+  return MM_TONE_NOTE_SIZE;
+}
+
+static void testQueuesSeveralNotesInOneWrite() {
+  Sequencer sequencer;
+  uint8_t data[19];
+  size_t length = 0;
+  length += packNote(&data[length], 2273, 128, 250);
+  length += packNote(&data[length], 0, 0, 125);
+  length += packNote(&data[length], 1136, 255, 500);
+  CHECK_EQ(3, sequencer.push(data, length + 2)); // a partial note is ignored
+  CHECK_EQ(3, sequencer.size());
+  CHECK_EQ(1, sequencer.push(data, length)); // the queue is full
+  CHECK_EQ(4, sequencer.size());
+  uint8_t report[MM_TONE_REPORT_SIZE];
+  sequencer.report(report);
+  CHECK_EQ(4, report[0]);
+  CHECK_EQ(0, report[1]);
+  CHECK_EQ(0, report[2] | (report[3] << 8));
+}
+
+static void testPlaysOnTheTimeline() {
+  Sequencer sequencer;
+  uint8_t data[10];
+  size_t length = packNote(data, 2273, 128, 250);
+  length += packNote(&data[length], 1136, 64, 100);
+  sequencer.push(data, length);
+  MbitMoreTone tone;
+  CHECK(sequencer.update(1000000, &tone));
+  CHECK_EQ(2273, tone.period);
+  CHECK_EQ(128, tone.volume);
+  CHECK_EQ(250000, sequencer.waitTime(1000000));
+  CHECK(!sequencer.update(1249999, &tone));
+  CHECK(sequencer.update(1250700, &tone)); // woke up late
+  CHECK_EQ(1136, tone.period);
+  CHECK_EQ(99300, sequencer.waitTime(1250700)); // the next note keeps the rhythm
+  CHECK(sequencer.update(1350000, &tone));
+  CHECK_EQ(0, tone.volume); // silenced when the queue ran out
+  CHECK(!sequencer.isActive());
+  CHECK(!sequencer.update(2000000, &tone));
+  CHECK_EQ(2, sequencer.played);
+  sequencer.push(data, MM_TONE_NOTE_SIZE);
+  CHECK(sequencer.update(3000000, &tone)); // starts at the time after a pause
+  CHECK_EQ(250000, sequencer.waitTime(3000000));
+  sequencer.clear();
+  CHECK(!sequencer.isActive());
+}
+
+/**
+ * @brief Play a melody which the host keeps topped up from the reports,
+ * and measure the start times of the notes when the player wakes up late by up to a scheduler tick.
+ */
+static void testMelodyKeepsRhythm() {
+  MbitMoreToneSequencer<16> sequencer;
+  uint8_t data[15];
+  uint64_t now = 0;
+  uint64_t ideal = 0;
+  uint64_t worst = 0;
+  uint32_t seed = 5;
+  int notes = 0;
+  int sent = 0;
+  MbitMoreTone tone;
+  while (notes < 1000) {
+    uint8_t report[MM_TONE_REPORT_SIZE];
+    sequencer.report(report);
+    if (report[0] < 4 && sent < 1000) {
+      size_t length = 0;
+      for (int i = 0; i < 3 && sent < 1000; i++, sent++) {
+        length += packNote(&data[length], 1000 + sent, 128, (uint16_t)(100 + (sent % 3) * 50));
+      }
+      sequencer.push(data, length);
+    }
+    if (sequencer.update(now, &tone) && tone.volume > 0) {
+      uint64_t late = now - ideal;
+      worst = (late > worst) ? late : worst;
+      ideal += (uint64_t)tone.duration * 1000;
+      notes++;
+    }
+    seed = seed * 1103515245 + 12345;
+    uint64_t wait = sequencer.waitTime(now);
+    now += (wait > 0 ? wait : 1000) + (seed >> 8) % 6000; // late by up to 6 ms
+  }
+  std::printf("  1000 notes woken up to 6 ms late: worst start %.2f ms from the ideal timeline\n", worst / 1000.0);
+  CHECK(worst < 6000);
+}
+
+int main() {
+  RUN_TEST(testQueuesSeveralNotesInOneWrite);
+  RUN_TEST(testPlaysOnTheTimeline);
+  RUN_TEST(testMelodyKeepsRhythm);
+  return hostTestResult();
+}
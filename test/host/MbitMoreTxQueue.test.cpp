@@ -0,0 +1,118 @@
+#include "HostTest.h"
+
+#include "MbitMoreTxQueue.h"
+
+typedef MbitMoreTxQueue<3, 2> Queue;
+
+static void push(Queue &queue, MbitMoreTxPriority priority, uint16_t ch, uint8_t value) {
+  MbitMoreTxFrame *slot = queue.acquire(priority, ch);
+  if (slot == NULL)
+    return;
+  slot->bytes[5] = value;
+  queue.commit(priority, slot, finishResponse(MbitMoreSerialFraming::FRAMING_SFD, slot->bytes, RES_NOTIFY, ch, 1));
+}
+
+static uint8_t frontValue(const Queue &queue) {
+  return queue.front().bytes[5];
+}
+
+static void testHighPriorityGoesFirst() {
+  Queue queue;
+  push(queue, TX_LOW, 0x0101, 1);
+  push(queue, TX_LOW, 0x0102, 2);
+  push(queue, TX_HIGH, 0x0110, 3);
+  push(queue, TX_HIGH, 0x0111, 4);
+  CHECK_EQ(TX_HIGH, queue.frontPriority());
+  CHECK_EQ(3, frontValue(queue));
+  queue.pop();
+  CHECK_EQ(4, frontValue(queue));
+  queue.pop();
+  CHECK_EQ(TX_LOW, queue.frontPriority());
+  CHECK_EQ(1, frontValue(queue));
+  queue.pop();
+  CHECK_EQ(2, frontValue(queue));
+  queue.pop();
+  CHECK(queue.empty());
+}
+
+static void testLowPriorityIsReplacedByNewerOne() {
+  Queue queue;
+  push(queue, TX_LOW, 0x0101, 1);
+  push(queue, TX_LOW, 0x0102, 2);
+  push(queue, TX_LOW, 0x0101, 3);
+  CHECK_EQ(2, queue.depth(TX_LOW));
+  CHECK_EQ(1, queue.replaced);
+  CHECK_EQ(0, queue.dropped[TX_LOW]);
+  // The replaced frame keeps its place in the order.
+  CHECK_EQ(0x0101, queue.front().ch);
+  CHECK_EQ(3, frontValue(queue));
+  const MbitMoreTxFrame &frame = queue.front();
+  CHECK_EQ(chksum8(frame.bytes, frame.length - 1), frame.bytes[frame.length - 1]);
+}
+
+static void testBuildsFrameInAcquiredSlot() {
+  Queue queue;
+  push(queue, TX_LOW, 0x0101, 1);
+  push(queue, TX_LOW, 0x0102, 2);
+  MbitMoreTxFrame *slot = queue.acquire(TX_LOW, 0x0102);
+  CHECK(slot != NULL);
+  slot->bytes[5] = 3;
+  queue.commit(TX_LOW, slot, finishResponse(MbitMoreSerialFraming::FRAMING_SFD, slot->bytes, RES_NOTIFY, 0x0102, 1));
+  CHECK_EQ(2, queue.depth(TX_LOW));
+  CHECK_EQ(1, queue.replaced);
+  slot = queue.acquire(TX_HIGH, 0x0110);
+  slot->bytes[5] = 4;
+  queue.commit(TX_HIGH, slot, finishResponse(MbitMoreSerialFraming::FRAMING_SFD, slot->bytes, RES_NOTIFY, 0x0110, 1));
+  CHECK_EQ(1, queue.depth(TX_HIGH));
+  CHECK_EQ(4, frontValue(queue));
+  queue.pop();
+  queue.pop();
+  CHECK_EQ(3, frontValue(queue));
+  CHECK_EQ(chksum8(queue.front().bytes, 6), queue.front().bytes[6]);
+}
+
+static void testDropsWhenSlotsAreFull() {
+  Queue queue;
+  for (int i = 0; i < 5; i++) {
+    push(queue, TX_HIGH, 0x0110, i);
+  }
+  push(queue, TX_LOW, 0x0101, 0);
+  CHECK(!queue.full(TX_LOW)); // each lane is full at its own number of slots
+  push(queue, TX_LOW, 0x0102, 0);
+  CHECK(queue.full(TX_HIGH));
+  CHECK(queue.full(TX_LOW));
+  push(queue, TX_LOW, 0x0120, 0);
+  CHECK_EQ(3, queue.depth(TX_HIGH));
+  CHECK_EQ(2, queue.dropped[TX_HIGH]);
+  CHECK_EQ(1, queue.dropped[TX_LOW]);
+  CHECK_EQ(3, queue.maxDepth[TX_HIGH]);
+  CHECK_EQ(2, queue.maxDepth[TX_LOW]);
+  // Events are kept in the order of arrival.
+  CHECK_EQ(0, frontValue(queue));
+  queue.pop();
+  CHECK(!queue.full(TX_HIGH));
+  CHECK_EQ(1, frontValue(queue));
+}
+
+static void testWrapsAround() {
+  Queue queue;
+  for (int i = 0; i < 10; i++) {
+    push(queue, TX_HIGH, 0x0110, i);
+    push(queue, TX_HIGH, 0x0111, i + 100);
+    CHECK_EQ(i, frontValue(queue));
+    queue.pop();
+    CHECK_EQ(i + 100, frontValue(queue));
+    queue.pop();
+  }
+  CHECK(queue.empty());
+  CHECK_EQ(0, queue.dropped[TX_HIGH]);
+}
+
+int main() {
+  RUN_TEST(testHighPriorityGoesFirst);
+  RUN_TEST(testLowPriorityIsReplacedByNewerOne);
+  RUN_TEST(testBuildsFrameInAcquiredSlot);
+  RUN_TEST(testDropsWhenSlotsAreFull);
+  RUN_TEST(testWrapsAround);
+  return hostTestResult();
+}